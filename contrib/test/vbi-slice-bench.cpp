@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Raw VBI slicer benchmark
+ */
+
+/* This utility measures the throughput of the software raw VBI slicer in
+   utils/common/raw2sliced.cpp. It reads a raw VBI capture (for example
+   made with 'v4l2-ctl -d /dev/vbi0 --stream-mmap --stream-to=vbi.raw')
+   and slices all buffers in that file, optionally spreading the work
+   over several threads.
+
+   Usage: vbi-slice-bench [-5] [-t threads] [-i iterations] [-r rate]
+			  [-s samples_per_line] [-c count] file
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "raw2sliced.h"
+
+struct worker {
+	pthread_t thread;
+	const struct vbi_handle *vh;
+	const unsigned char *raw;
+	unsigned buf_size;
+	unsigned first_buf;
+	unsigned last_buf;
+	unsigned iterations;
+	unsigned lines;
+};
+
+static void *slice_bufs(void *arg)
+{
+	struct worker *w = static_cast<struct worker *>(arg);
+	unsigned lines = w->vh->count[0] + w->vh->count[1];
+	struct v4l2_sliced_vbi_data *data = new v4l2_sliced_vbi_data[lines];
+	unsigned sliced = 0;
+
+	for (unsigned i = 0; i < w->iterations; i++) {
+		for (unsigned b = w->first_buf; b < w->last_buf; b++) {
+			struct v4l2_sliced_vbi_format vbi = {};
+
+			vbi_parse_lines(w->vh, w->raw + b * w->buf_size,
+					0, lines, &vbi, data);
+			for (unsigned l = 0; l < lines; l++)
+				if (data[l].id)
+					sliced++;
+		}
+	}
+	w->lines = sliced;
+	delete [] data;
+	return nullptr;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "Usage: %s [-5] [-t threads] [-i iterations] [-r rate]\n"
+		"\t\t[-s samples_per_line] [-c count] file\n"
+		"  -5  the raw VBI was captured from a 525 line (NTSC) source\n"
+		"  -t  number of slicer threads (default 1)\n"
+		"  -i  number of times the file is sliced (default 10)\n"
+		"  -r  sampling rate in Hz (default 27000000)\n"
+		"  -s  samples per line (default 1440)\n"
+		"  -c  number of lines per field (default 18, or 12 for -5)\n",
+		prog);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	struct v4l2_vbi_format fmt = {};
+	struct vbi_handle vh;
+	v4l2_std_id std = V4L2_STD_PAL;
+	unsigned threads = 1;
+	unsigned iterations = 10;
+	unsigned count = 0;
+	unsigned long long lines = 0;
+	struct timespec start, end;
+	struct worker *workers;
+	unsigned char *raw;
+	unsigned buf_size, bufs;
+	struct stat st;
+	double secs;
+	FILE *f;
+	int opt;
+
+	fmt.sampling_rate = 27000000;
+	fmt.samples_per_line = 1440;
+	fmt.sample_format = V4L2_PIX_FMT_GREY;
+
+	while ((opt = getopt(argc, argv, "5t:i:r:s:c:")) != -1) {
+		switch (opt) {
+		case '5':
+			std = V4L2_STD_NTSC;
+			break;
+		case 't':
+			threads = strtoul(optarg, nullptr, 0);
+			break;
+		case 'i':
+			iterations = strtoul(optarg, nullptr, 0);
+			break;
+		case 'r':
+			fmt.sampling_rate = strtoul(optarg, nullptr, 0);
+			break;
+		case 's':
+			fmt.samples_per_line = strtoul(optarg, nullptr, 0);
+			break;
+		case 'c':
+			count = strtoul(optarg, nullptr, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || !threads || !fmt.samples_per_line)
+		usage(argv[0]);
+
+	/* Use the same VBI line ranges as the vivid driver */
+	if (std & V4L2_STD_525_60) {
+		fmt.start[0] = 10;
+		fmt.start[1] = 273;
+		fmt.count[0] = fmt.count[1] = count ? count : 12;
+	} else {
+		fmt.start[0] = 6;
+		fmt.start[1] = 319;
+		fmt.count[0] = fmt.count[1] = count ? count : 18;
+	}
+
+	if (!vbi_prepare(&vh, &fmt, std)) {
+		fprintf(stderr, "no sliced VBI services are possible for this VBI format\n");
+		return 1;
+	}
+
+	f = fopen(argv[optind], "r");
+	if (!f || fstat(fileno(f), &st)) {
+		perror(argv[optind]);
+		return 1;
+	}
+	buf_size = fmt.samples_per_line * (fmt.count[0] + fmt.count[1]);
+	bufs = st.st_size / buf_size;
+	if (!bufs) {
+		fprintf(stderr, "%s contains no complete VBI buffers\n", argv[optind]);
+		return 1;
+	}
+	raw = static_cast<unsigned char *>(malloc(bufs * buf_size));
+	if (!raw || fread(raw, buf_size, bufs, f) != bufs) {
+		fprintf(stderr, "could not read %s\n", argv[optind]);
+		return 1;
+	}
+	fclose(f);
+
+	if (threads > bufs)
+		threads = bufs;
+	workers = static_cast<struct worker *>(calloc(threads, sizeof(*workers)));
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (unsigned t = 0; t < threads; t++) {
+		struct worker *w = workers + t;
+
+		w->vh = &vh;
+		w->raw = raw;
+		w->buf_size = buf_size;
+		w->first_buf = t * bufs / threads;
+		w->last_buf = (t + 1) * bufs / threads;
+		w->iterations = iterations;
+		if (pthread_create(&w->thread, nullptr, slice_bufs, w)) {
+			perror("pthread_create");
+			return 1;
+		}
+	}
+	for (unsigned t = 0; t < threads; t++) {
+		pthread_join(workers[t].thread, nullptr);
+		lines += workers[t].lines;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	secs = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+	printf("%u buffers x %u iterations, %u thread(s): %.03f s\n",
+	       bufs, iterations, threads, secs);
+	printf("%.0f buffers/s, %.0f raw lines/s, %llu sliced lines\n",
+	       bufs * iterations / secs,
+	       (double)bufs * iterations * (fmt.count[0] + fmt.count[1]) / secs,
+	       lines);
+	free(workers);
+	free(raw);
+	return 0;
+}
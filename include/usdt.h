@@ -0,0 +1,19 @@
+#ifndef _USDT_H
+#define _USDT_H
+
+/*
+ * User-space statically defined tracepoints, usable from bpftrace, perf
+ * or systemtap. The probes are a single nop in the instruction stream and
+ * cost nothing until a tracer attaches. Without <sys/sdt.h>, or when
+ * configured with --disable-usdt, they compile to nothing.
+ *
+ * The arguments must be integers or pointers.
+ */
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+#define USDT(provider, name, ...) STAP_PROBEV(provider, name, ##__VA_ARGS__)
+#else
+#define USDT(provider, name, ...) do { } while (0)
+#endif
+
+#endif
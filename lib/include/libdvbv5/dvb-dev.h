@@ -339,6 +339,93 @@ int dvb_dev_get_fd(struct dvb_open_descriptor *open_dev);
 ssize_t dvb_dev_read(struct dvb_open_descriptor *open_dev,
 		     void *buf, size_t count);
 
+/**
+ * @struct dvb_dev_buffer
+ * @brief A buffer filled with data by the demux, when streaming via mmap
+ * @ingroup dvb_device
+ *
+ * @param data		Points to the mmapped buffer memory
+ * @param bytesused	Number of bytes of data in the buffer
+ * @param index		Index of the buffer, used to queue it back
+ * @param flags		Buffer flags, as defined by enum dmx_buffer_flags
+ * @param count		Sequence number of the buffer, as set by the Kernel
+ */
+struct dvb_dev_buffer {
+	void *data;
+	size_t bytesused;
+	unsigned int index;
+	unsigned int flags;
+	unsigned int count;
+};
+
+/**
+ * @brief Start streaming from a demux or dvr device via mmapped buffers
+ * @ingroup dvb_device
+ *
+ * @param open_dev	Points to the struct dvb_open_descriptor
+ * @param count		Number of buffers to allocate
+ * @param size		Size of each buffer, in bytes. Should be a multiple
+ *			of the TS packet size (188 bytes).
+ *
+ * Allocates the buffers with DMX_REQBUFS, maps them on userspace and queues
+ * all of them with DMX_QBUF. The Kernel then writes the filtered data
+ * directly into those buffers, avoiding the copy done by dvb_dev_read().
+ * The filled buffers are retrieved with dvb_dev_stream_dqbuf() and
+ * should be given back with dvb_dev_stream_qbuf() after being used.
+ *
+ * The Kernel may change the number of buffers. Once streaming is started,
+ * dvb_dev_read() can't be used anymore.
+ *
+ * @return Returns the number of buffers on success, a negative errno code
+ * otherwise. -ENOTTY means that the Kernel doesn't support DVB mmap
+ * (CONFIG_DVB_MMAP) and -ENOTSUP that the device is not a local one. In
+ * both cases, dvb_dev_read() should be used instead.
+ *
+ * @note valid only for DVB_DEVICE_DEMUX or DVB_DEVICE_DVR.
+ */
+int dvb_dev_stream_start(struct dvb_open_descriptor *open_dev,
+			 unsigned int count, unsigned int size);
+
+/**
+ * @brief Dequeue a buffer filled with data by the demux
+ * @ingroup dvb_device
+ *
+ * @param open_dev	Points to the struct dvb_open_descriptor
+ * @param buf		Filled with the data of the dequeued buffer
+ *
+ * Waits for a buffer to be filled, unless the device was opened with
+ * O_NONBLOCK. The buffer memory belongs to the caller until it is queued
+ * back with dvb_dev_stream_qbuf().
+ *
+ * @return Retuns zero on success, a negative errno code otherwise.
+ */
+int dvb_dev_stream_dqbuf(struct dvb_open_descriptor *open_dev,
+			 struct dvb_dev_buffer *buf);
+
+/**
+ * @brief Give a dequeued buffer back to the demux
+ * @ingroup dvb_device
+ *
+ * @param open_dev	Points to the struct dvb_open_descriptor
+ * @param buf		Buffer returned by dvb_dev_stream_dqbuf()
+ *
+ * @return Retuns zero on success, a negative errno code otherwise.
+ */
+int dvb_dev_stream_qbuf(struct dvb_open_descriptor *open_dev,
+			struct dvb_dev_buffer *buf);
+
+/**
+ * @brief Unmap the buffers allocated by dvb_dev_stream_start()
+ * @ingroup dvb_device
+ *
+ * @param open_dev	Points to the struct dvb_open_descriptor
+ *
+ * The Kernel only stops streaming and frees the buffers when the device
+ * is closed, so this is called by dvb_dev_close(). Calling it explicitly
+ * is only needed to release the mappings earlier.
+ */
+void dvb_dev_stream_stop(struct dvb_open_descriptor *open_dev);
+
 /**
  * @brief Stops the demux filter for a given file descriptor
  * @ingroup dvb_device
@@ -26,6 +26,7 @@
 #include <locale.h>
 #include <unistd.h>
 #include <string.h>
+#include <sys/mman.h>
 
 #include <config.h>
 
@@ -519,6 +520,7 @@ static int dvb_local_close(struct dvb_open_descriptor *open_dev)
 		if (dev->dvb_type == DVB_DEVICE_DEMUX)
 			dvb_dev_dmx_stop(open_dev);
 
+		dvb_dev_stream_stop(open_dev);
 		close(open_dev->fd);
 	}
 
@@ -642,6 +644,134 @@ static ssize_t dvb_local_read(struct dvb_open_descriptor *open_dev,
 	return ret;
 }
 
+static void dvb_local_stream_stop(struct dvb_open_descriptor *open_dev)
+{
+	unsigned int i;
+
+	for (i = 0; i < open_dev->n_bufs; i++) {
+		if (open_dev->bufs[i].start)
+			munmap(open_dev->bufs[i].start, open_dev->bufs[i].length);
+	}
+	free(open_dev->bufs);
+	open_dev->bufs = NULL;
+	open_dev->n_bufs = 0;
+}
+
+static int dvb_local_stream_start(struct dvb_open_descriptor *open_dev,
+				  unsigned int count, unsigned int size)
+{
+	struct dvb_dev_list *dev = open_dev->dev;
+	struct dvb_device_priv *dvb = open_dev->dvb;
+	struct dvb_v5_fe_parms_priv *parms = (void *)dvb->d.fe_parms;
+	struct dmx_requestbuffers req = { .count = count, .size = size };
+	int ret, fd = open_dev->fd;
+	unsigned int i;
+
+	if (dev->dvb_type != DVB_DEVICE_DEMUX && dev->dvb_type != DVB_DEVICE_DVR)
+		return -EINVAL;
+
+	if (open_dev->n_bufs)
+		return -EBUSY;
+
+	if (xioctl(fd, DMX_REQBUFS, &req) == -1) {
+		ret = -errno;
+		/* Not an error: the Kernel was built without CONFIG_DVB_MMAP */
+		if (ret != -ENOTTY && ret != -EINVAL)
+			dvb_perror(_("DMX_REQBUFS failed"));
+		return ret;
+	}
+	if (!req.count)
+		return -ENOMEM;
+
+	open_dev->bufs = calloc(req.count, sizeof(*open_dev->bufs));
+	if (!open_dev->bufs)
+		return -ENOMEM;
+	open_dev->n_bufs = req.count;
+
+	for (i = 0; i < req.count; i++) {
+		struct dmx_buffer buf = { .index = i };
+
+		if (xioctl(fd, DMX_QUERYBUF, &buf) == -1) {
+			ret = -errno;
+			dvb_perror(_("DMX_QUERYBUF failed"));
+			goto err;
+		}
+		open_dev->bufs[i].start = mmap(NULL, buf.length,
+					       PROT_READ | PROT_WRITE,
+					       MAP_SHARED, fd, buf.offset);
+		if (open_dev->bufs[i].start == MAP_FAILED) {
+			ret = -errno;
+			open_dev->bufs[i].start = NULL;
+			dvb_perror(_("mmap failed"));
+			goto err;
+		}
+		open_dev->bufs[i].length = buf.length;
+	}
+
+	/* Queueing the first buffer also starts streaming */
+	for (i = 0; i < req.count; i++) {
+		struct dmx_buffer buf = { .index = i };
+
+		if (xioctl(fd, DMX_QBUF, &buf) == -1) {
+			ret = -errno;
+			dvb_perror(_("DMX_QBUF failed"));
+			goto err;
+		}
+	}
+
+	return req.count;
+
+err:
+	dvb_local_stream_stop(open_dev);
+	return ret;
+}
+
+static int dvb_local_stream_dqbuf(struct dvb_open_descriptor *open_dev,
+				  struct dvb_dev_buffer *buf)
+{
+	struct dvb_device_priv *dvb = open_dev->dvb;
+	struct dvb_v5_fe_parms_priv *parms = (void *)dvb->d.fe_parms;
+	struct dmx_buffer b = { 0 };
+	int fd = open_dev->fd;
+
+	if (!open_dev->n_bufs)
+		return -EINVAL;
+
+	if (TEMP_FAILURE_RETRY(ioctl(fd, DMX_DQBUF, &b)) == -1) {
+		if (errno != EAGAIN)
+			dvb_perror(_("DMX_DQBUF failed"));
+		return -errno;
+	}
+	if (b.index >= open_dev->n_bufs)
+		return -EINVAL;
+
+	buf->data = open_dev->bufs[b.index].start;
+	buf->bytesused = b.bytesused;
+	buf->index = b.index;
+	buf->flags = b.flags;
+	buf->count = b.count;
+
+	return 0;
+}
+
+static int dvb_local_stream_qbuf(struct dvb_open_descriptor *open_dev,
+				 struct dvb_dev_buffer *buf)
+{
+	struct dvb_device_priv *dvb = open_dev->dvb;
+	struct dvb_v5_fe_parms_priv *parms = (void *)dvb->d.fe_parms;
+	struct dmx_buffer b = { .index = buf->index };
+
+	if (buf->index >= open_dev->n_bufs)
+		return -EINVAL;
+
+	if (xioctl(open_dev->fd, DMX_QBUF, &b) == -1) {
+		dvb_perror(_("DMX_QBUF failed"));
+		return -errno;
+	}
+
+	return 0;
+}
+
 static int dvb_local_dmx_set_pesfilter(struct dvb_open_descriptor *open_dev,
 			      int pid, dmx_pes_type_t type,
 			      dmx_output_t output, int bufsize)
@@ -856,6 +986,10 @@ void dvb_dev_local_init(struct dvb_device_priv *dvb)
 	ops->dmx_stop = dvb_local_dmx_stop;
 	ops->set_bufsize = dvb_local_set_bufsize;
 	ops->read = dvb_local_read;
+	ops->stream_start = dvb_local_stream_start;
+	ops->stream_dqbuf = dvb_local_stream_dqbuf;
+	ops->stream_qbuf = dvb_local_stream_qbuf;
+	ops->stream_stop = dvb_local_stream_stop;
 	ops->dmx_set_pesfilter = dvb_local_dmx_set_pesfilter;
 	ops->dmx_set_section_filter = dvb_local_dmx_set_section_filter;
 	ops->dmx_get_pmt_pid = dvb_local_dmx_get_pmt_pid;
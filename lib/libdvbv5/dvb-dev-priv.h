@@ -24,11 +24,20 @@
 
 struct dvb_device_priv;
 
+struct dvb_dev_mmap_buf {
+	void *start;
+	size_t length;
+};
+
 struct dvb_open_descriptor {
 	int fd;
 	struct dvb_dev_list *dev;
 	struct dvb_device_priv *dvb;
 	struct dvb_open_descriptor *next;
+
+	/* Buffers mmapped by dvb_dev_stream_start() */
+	struct dvb_dev_mmap_buf *bufs;
+	unsigned int n_bufs;
 };
 
 struct dvb_dev_ops {
@@ -49,6 +58,13 @@ struct dvb_dev_ops {
 			   int buffersize);
 	ssize_t (*read)(struct dvb_open_descriptor *open_dev,
 			void *buf, size_t count);
+	int (*stream_start)(struct dvb_open_descriptor *open_dev,
+			    unsigned int count, unsigned int size);
+	int (*stream_dqbuf)(struct dvb_open_descriptor *open_dev,
+			    struct dvb_dev_buffer *buf);
+	int (*stream_qbuf)(struct dvb_open_descriptor *open_dev,
+			   struct dvb_dev_buffer *buf);
+	void (*stream_stop)(struct dvb_open_descriptor *open_dev);
 	int (*dmx_set_pesfilter)(struct dvb_open_descriptor *open_dev,
 				 int pid, dmx_pes_type_t type,
 				 dmx_output_t output, int bufsize);
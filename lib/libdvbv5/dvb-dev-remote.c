@@ -42,6 +42,7 @@
 
 #include "dvb-fe-priv.h"
 #include "dvb-dev-priv.h"
+#include "usdt.h"
 
 #ifdef ENABLE_NLS
 # include "gettext.h"
@@ -677,6 +678,8 @@ static void *receive_data(void *privdata)
 			args += ret;
 			args_size -= ret;
 
+			USDT(libdvbv5, remote_msg, seq, cmd, retval, size);
+
 			/* Check for messages that aren't command responses */
 			if (seq)
 				break;
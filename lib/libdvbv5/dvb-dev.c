@@ -16,6 +16,7 @@
  * Or, point your browser to http://www.gnu.org/licenses/old-licenses/gpl-2.0.html
  */
 
+#include <errno.h>
 #include <libudev.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -27,6 +28,7 @@
 
 #include "dvb-fe-priv.h"
 #include "dvb-dev-priv.h"
+#include "usdt.h"
 
 #ifdef ENABLE_NLS
 # include "gettext.h"
@@ -277,11 +279,61 @@ ssize_t dvb_dev_read(struct dvb_open_descriptor *open_dev,
 {
 	struct dvb_device_priv *dvb = open_dev->dvb;
 	struct dvb_dev_ops *ops = &dvb->ops;
+	ssize_t ret;
 
 	if (!ops->read)
 		return -1;
 
-	return ops->read(open_dev, buf, count);
+	USDT(libdvbv5, dev_read_entry, open_dev->fd, count);
+	ret = ops->read(open_dev, buf, count);
+	USDT(libdvbv5, dev_read_exit, open_dev->fd, ret);
+
+	return ret;
+}
+
+int dvb_dev_stream_start(struct dvb_open_descriptor *open_dev,
+			 unsigned int count, unsigned int size)
+{
+	struct dvb_device_priv *dvb = open_dev->dvb;
+	struct dvb_dev_ops *ops = &dvb->ops;
+
+	if (!ops->stream_start)
+		return -ENOTSUP;
+
+	return ops->stream_start(open_dev, count, size);
+}
+
+int dvb_dev_stream_dqbuf(struct dvb_open_descriptor *open_dev,
+			 struct dvb_dev_buffer *buf)
+{
+	struct dvb_device_priv *dvb = open_dev->dvb;
+	struct dvb_dev_ops *ops = &dvb->ops;
+
+	if (!ops->stream_dqbuf)
+		return -ENOTSUP;
+
+	return ops->stream_dqbuf(open_dev, buf);
+}
+
+int dvb_dev_stream_qbuf(struct dvb_open_descriptor *open_dev,
+			struct dvb_dev_buffer *buf)
+{
+	struct dvb_device_priv *dvb = open_dev->dvb;
+	struct dvb_dev_ops *ops = &dvb->ops;
+
+	if (!ops->stream_qbuf)
+		return -ENOTSUP;
+
+	return ops->stream_qbuf(open_dev, buf);
+}
+
+void dvb_dev_stream_stop(struct dvb_open_descriptor *open_dev)
+{
+	struct dvb_device_priv *dvb = open_dev->dvb;
+	struct dvb_dev_ops *ops = &dvb->ops;
+
+	if (ops->stream_stop)
+		ops->stream_stop(open_dev);
 }
 
 int dvb_dev_dmx_set_pesfilter(struct dvb_open_descriptor *open_dev,
@@ -20,6 +20,8 @@
 #ifndef __DVB_FE_PRIV_H
 #define __DVB_FE_PRIV_H
 
+#include <time.h>
+
 #include <libdvbv5/dvb-fe.h>
 #include <libdvbv5/countries.h>
 
@@ -54,6 +56,30 @@ struct dvb_v5_stats {
 
 };
 
+/*
+ * Last state sent to the Satellite Equipment Control (SEC) bus. Used to
+ * avoid re-sending DiSEqC, tone and voltage commands that wouldn't change
+ * anything, and to only wait for the settle time that didn't already pass.
+ */
+struct dvb_sec_state {
+	unsigned			voltage_valid:1;
+	unsigned			tone_valid:1;
+	unsigned			input_valid:1;
+
+	fe_sec_voltage_t		voltage;
+	fe_sec_tone_mode_t		tone;
+
+	/* Input selected by the last DiSEqC command sequence */
+	const struct dvb_sat_lnb	*lnb;
+	int				sat_number;
+	int				high_band;
+	int				pol_v;
+	uint16_t			scr_t;
+
+	/* When the last SEC command was sent */
+	struct timespec			last_cmd;
+};
+
 struct dvb_device_priv;
 
 struct dvb_v5_fe_parms_priv {
@@ -75,6 +101,7 @@ struct dvb_v5_fe_parms_priv {
 	/* Satellite specific stuff */
 	int				high_band;
 	unsigned			freq_offset;
+	struct dvb_sec_state		sec;
 
 	dvb_logfunc_priv		logfunc_priv;
 	void				*logpriv;
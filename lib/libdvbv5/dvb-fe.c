@@ -434,6 +434,7 @@ void __dvb_fe_close(struct dvb_v5_fe_parms_priv *parms)
 
 	close(parms->fd);
 	parms->fd = -1;
+	memset(&parms->sec, 0, sizeof(parms->sec));
 }
 
 void dvb_fe_close(struct dvb_v5_fe_parms *p)
@@ -1849,6 +1850,11 @@ int dvb_fe_snprintf_stat(struct dvb_v5_fe_parms *p, uint32_t cmd,
  * version.
  */
 
+static void dvb_fe_sec_sent(struct dvb_v5_fe_parms_priv *parms)
+{
+	clock_gettime(CLOCK_MONOTONIC, &parms->sec.last_cmd);
+}
+
 int dvb_fe_sec_voltage(struct dvb_v5_fe_parms *p, int on, int v18)
 {
 	struct dvb_v5_fe_parms_priv *parms = (void *)p;
@@ -1865,7 +1871,10 @@ int dvb_fe_sec_voltage(struct dvb_v5_fe_parms *p, int on, int v18)
 			dvb_log(_("SEC: set voltage to %sV"), v18 ? "18" : "13");
 	}
 	rc = xioctl(parms->fd, FE_SET_VOLTAGE, v);
+	dvb_fe_sec_sent(parms);
 	if (rc == -1) {
+		parms->sec.voltage_valid = 0;
+		parms->sec.input_valid = 0;
 		if (errno == ENOTSUP) {
 			dvb_logerr("FE_SET_VOLTAGE: driver doesn't support it!");
 		} else {
@@ -1873,6 +1882,12 @@ int dvb_fe_sec_voltage(struct dvb_v5_fe_parms *p, int on, int v18)
 		}
 		return -errno;
 	}
+	parms->sec.voltage = v;
+	parms->sec.voltage_valid = 1;
+
+	/* Without power, the switches may lose their state */
+	if (v == SEC_VOLTAGE_OFF)
+		parms->sec.input_valid = 0;
 	return rc;
 }
 
@@ -1883,10 +1898,14 @@ int dvb_fe_sec_tone(struct dvb_v5_fe_parms *p, fe_sec_tone_mode_t tone)
 	if (parms->p.verbose)
 		dvb_log( _("DiSEqC TONE: %s"), fe_tone_name[tone] );
 	rc = xioctl(parms->fd, FE_SET_TONE, tone);
+	dvb_fe_sec_sent(parms);
 	if (rc == -1) {
+		parms->sec.tone_valid = 0;
 		dvb_perror("FE_SET_TONE");
 		return -errno;
 	}
+	parms->sec.tone = tone;
+	parms->sec.tone_valid = 1;
 	return rc;
 }
 
@@ -1917,6 +1936,8 @@ int dvb_fe_diseqc_burst(struct dvb_v5_fe_parms *p, int mini_b)
 	if (parms->p.verbose)
 		dvb_log( _("DiSEqC BURST: %s"), mini_b ? "SEC_MINI_B" : "SEC_MINI_A" );
 	rc = xioctl(parms->fd, FE_DISEQC_SEND_BURST, mini);
+	dvb_fe_sec_sent(parms);
+	parms->sec.input_valid = 0;
 	if (rc == -1) {
 		dvb_perror("FE_DISEQC_SEND_BURST");
 		return -errno;
@@ -1948,6 +1969,8 @@ int dvb_fe_diseqc_cmd(struct dvb_v5_fe_parms *p, const unsigned len,
 	}
 
 	rc = xioctl(parms->fd, FE_DISEQC_SEND_MASTER_CMD, &msg);
+	dvb_fe_sec_sent(parms);
+	parms->sec.input_valid = 0;
 	if (rc == -1) {
 		dvb_perror("FE_DISEQC_SEND_MASTER_CMD");
 		return -errno;
@@ -510,6 +510,52 @@ static int dvbsat_scr_odu_channel_change(struct dvb_v5_fe_parms_priv *parms,
 	return dvb_fe_diseqc_cmd(&parms->p, cmd->len, cmd->msg);
 }
 
+/*
+ * Wait until at least ms milliseconds have passed since the last command
+ * sent to the SEC bus. If enough time already passed, don't wait at all.
+ */
+static void dvbsat_settle(struct dvb_v5_fe_parms_priv *parms, unsigned ms)
+{
+	struct timespec now;
+	long long elapsed_us;
+
+	if (!parms->sec.last_cmd.tv_sec && !parms->sec.last_cmd.tv_nsec) {
+		usleep(ms * 1000);
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	elapsed_us = (now.tv_sec - parms->sec.last_cmd.tv_sec) * 1000000LL +
+		     (now.tv_nsec - parms->sec.last_cmd.tv_nsec) / 1000;
+	if (elapsed_us >= 0 && elapsed_us < ms * 1000LL)
+		usleep(ms * 1000LL - elapsed_us);
+}
+
+static int dvbsat_set_voltage(struct dvb_v5_fe_parms_priv *parms, int vol_high)
+{
+	fe_sec_voltage_t v = vol_high ? SEC_VOLTAGE_18 : SEC_VOLTAGE_13;
+
+	if (parms->sec.voltage_valid && parms->sec.voltage == v)
+		return 0;
+
+	return dvb_fe_sec_voltage(&parms->p, 1, vol_high);
+}
+
+/*
+ * The settle time is also needed when the tone doesn't change, e.g. after
+ * a tone burst, so only the FE_SET_TONE ioctl is skipped then.
+ */
+static int dvbsat_set_tone(struct dvb_v5_fe_parms_priv *parms,
+			   fe_sec_tone_mode_t tone, unsigned settle_ms)
+{
+	dvbsat_settle(parms, settle_ms);
+
+	if (parms->sec.tone_valid && parms->sec.tone == tone)
+		return 0;
+
+	return dvb_fe_sec_tone(&parms->p, tone);
+}
+
 static int dvbsat_diseqc_set_input(struct dvb_v5_fe_parms_priv *parms,
 				   uint16_t t)
 {
@@ -520,6 +566,7 @@ static int dvbsat_diseqc_set_input(struct dvb_v5_fe_parms_priv *parms,
 	int sat_number = parms->p.sat_number;
 	int vol_high = 0;
 	int tone_on = 0;
+	int same_input;
 	struct diseqc_cmd cmd;
 	const struct dvb_sat_lnb_priv *lnb = (void *)parms->p.lnb;
 
@@ -549,43 +596,83 @@ static int dvbsat_diseqc_set_input(struct dvb_v5_fe_parms_priv *parms,
 		}
 	}
 
-	rc = dvb_fe_sec_voltage(&parms->p, 1, vol_high);
-	if (rc)
-		return rc;
+	same_input = parms->sec.input_valid &&
+		     parms->sec.lnb == parms->p.lnb &&
+		     parms->sec.sat_number == sat_number &&
+		     parms->sec.high_band == high_band &&
+		     parms->sec.pol_v == pol_v;
 
-	rc = dvb_fe_sec_tone(&parms->p, SEC_TONE_OFF);
+	rc = dvbsat_set_voltage(parms, vol_high);
 	if (rc)
 		return rc;
 
-	if (sat_number >= 0) {
-		/* DiSEqC is enabled. Send DiSEqC commands */
-		usleep(15 * 1000);
+	if (sat_number < 0)
+		return dvbsat_set_tone(parms, tone_on ? SEC_TONE_ON : SEC_TONE_OFF, 0);
 
-		if (!t)
-			rc = dvbsat_diseqc_write_to_port_group(parms, &cmd, high_band,
-								pol_v, sat_number);
-		else
-			rc = dvbsat_scr_odu_channel_change(parms, &cmd, high_band,
-								pol_v, sat_number, t);
+	if (same_input && parms->sec.scr_t == t) {
+		/* Switches are already at the right position */
+		if (parms->p.verbose > 1)
+			dvb_log(_("DiSEqC: input didn't change"));
+		return dvbsat_set_tone(parms, tone_on ? SEC_TONE_ON : SEC_TONE_OFF, 15);
+	}
 
+	if (same_input) {
+		/*
+		 * SCR/Unicable retune on the same input: voltage, tone and
+		 * tone burst stay as they are, only the ODU channel change
+		 * command has to be sent.
+		 */
+		dvbsat_settle(parms, 15);
+		rc = dvbsat_scr_odu_channel_change(parms, &cmd, high_band,
+						   pol_v, sat_number, t);
 		if (rc) {
 			dvb_logerr(_("sending diseq failed"));
 			return rc;
 		}
-		usleep((15 + parms->p.diseqc_wait) * 1000);
+		dvbsat_settle(parms, 15 + parms->p.diseqc_wait);
+		goto done;
+	}
 
-		/* miniDiSEqC/Toneburst commands are defined only for up to 2 sattelites */
-		if (parms->p.sat_number < 2) {
-			rc = dvb_fe_diseqc_burst(&parms->p, parms->p.sat_number);
-			if (rc)
-				return rc;
-		}
-		usleep(15 * 1000);
+	rc = dvbsat_set_tone(parms, SEC_TONE_OFF, 0);
+	if (rc)
+		return rc;
+
+	/* DiSEqC is enabled. Send DiSEqC commands */
+	dvbsat_settle(parms, 15);
+
+	if (!t)
+		rc = dvbsat_diseqc_write_to_port_group(parms, &cmd, high_band,
+							pol_v, sat_number);
+	else
+		rc = dvbsat_scr_odu_channel_change(parms, &cmd, high_band,
+							pol_v, sat_number, t);
+
+	if (rc) {
+		dvb_logerr(_("sending diseq failed"));
+		return rc;
 	}
+	dvbsat_settle(parms, 15 + parms->p.diseqc_wait);
 
-	rc = dvb_fe_sec_tone(&parms->p, tone_on ? SEC_TONE_ON : SEC_TONE_OFF);
+	/* miniDiSEqC/Toneburst commands are defined only for up to 2 sattelites */
+	if (parms->p.sat_number < 2) {
+		rc = dvb_fe_diseqc_burst(&parms->p, parms->p.sat_number);
+		if (rc)
+			return rc;
+	}
 
-	return rc;
+	rc = dvbsat_set_tone(parms, tone_on ? SEC_TONE_ON : SEC_TONE_OFF, 15);
+	if (rc)
+		return rc;
+
+done:
+	parms->sec.input_valid = 1;
+	parms->sec.lnb = parms->p.lnb;
+	parms->sec.sat_number = sat_number;
+	parms->sec.high_band = high_band;
+	parms->sec.pol_v = pol_v;
+	parms->sec.scr_t = t;
+
+	return 0;
 }
 
 int dvb_sat_real_freq(struct dvb_v5_fe_parms *p, int freq)
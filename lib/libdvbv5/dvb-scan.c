@@ -62,6 +62,7 @@
 #include <libdvbv5/desc_sat.h>
 
 #include <config.h>
+#include "usdt.h"
 
 #ifdef ENABLE_NLS
 # include "gettext.h"
@@ -381,6 +382,7 @@ int dvb_read_sections(struct dvb_v5_fe_parms *__p, int dmx_fd,
 			break;
 		}
 
+		USDT(libdvbv5, section, buf[0], sect->pid, buf_length);
 		ret = dvb_parse_section(parms, sect, buf, buf_length);
 	} while (!ret);
 	free(buf);
@@ -795,56 +797,229 @@ struct dvb_entry *dvb_scan_add_entry(struct dvb_v5_fe_parms *__p,
 					pol, NO_STREAM_ID_FILTER);
 }
 
+static int dvb_entry_matches(struct dvb_entry *entry,
+			     uint32_t freq, int shift,
+			     enum dvb_sat_polarization pol, uint32_t stream_id)
+{
+	int i;
+
+	for (i = 0; i < entry->n_props; i++) {
+		uint32_t data = entry->props[i].u.data;
+
+		if (entry->props[i].cmd == DTV_FREQUENCY) {
+			if (freq < data - shift || freq > data + shift)
+				return 0;
+		}
+		if (pol != POLARIZATION_OFF
+		    && entry->props[i].cmd == DTV_POLARIZATION) {
+			if (data != pol)
+				return 0;
+		}
+		/* NO_STREAM_ID_FILTER: stream_id is not used.
+		 * 0: unspecified/auto. libdvbv5 default value.
+		 */
+		if (stream_id != NO_STREAM_ID_FILTER && stream_id != 0
+		    && entry->props[i].cmd == DTV_STREAM_ID) {
+			if (data != stream_id)
+				return 0;
+		}
+	}
+
+	return entry->n_props > 0;
+}
+
 int dvb_new_entry_is_needed(struct dvb_entry *entry,
 			    struct dvb_entry *last_entry,
 			    uint32_t freq, int shift,
 			    enum dvb_sat_polarization pol, uint32_t stream_id)
 {
 	for (; entry != last_entry; entry = entry->next) {
-		int i;
+		if (dvb_entry_matches(entry, freq, shift, pol, stream_id))
+			return 0;
+	}
 
-		for (i = 0; i < entry->n_props; i++) {
-			uint32_t data = entry->props[i].u.data;
+	return 1;
+}
 
-			if (entry->props[i].cmd == DTV_FREQUENCY) {
-				if (freq < data - shift || freq > data + shift)
-					break;
-			}
-			if (pol != POLARIZATION_OFF
-			    && entry->props[i].cmd == DTV_POLARIZATION) {
-				if (data != pol)
-					break;
-			}
-			/* NO_STREAM_ID_FILTER: stream_id is not used.
-			 * 0: unspecified/auto. libdvbv5 default value.
-			 */
-			if (stream_id != NO_STREAM_ID_FILTER && stream_id != 0
-			    && entry->props[i].cmd == DTV_STREAM_ID) {
-				if (data != stream_id)
-					break;
-			}
+/*
+ * Index of the entries of a transponder list, sorted by frequency.
+ *
+ * Every NIT-announced transponder needs to be checked against the whole
+ * list, which is quadratic for satellites, where the NIT lists thousands
+ * of transponders. So, while handling a NIT, the entries are indexed by
+ * their frequency, and only the ones within the frequency shift are
+ * checked for the polarization and the stream ID. Entries without a
+ * frequency match any frequency, so they're always checked.
+ */
+struct dvb_entry_index_item {
+	uint32_t freq;
+	struct dvb_entry *entry;
+};
+
+struct dvb_entry_index {
+	struct dvb_entry_index_item *items;
+	unsigned n_items, size;
+
+	struct dvb_entry **nofreq;
+	unsigned n_nofreq;
+
+	/* Used to append the new entries, and to number them */
+	struct dvb_entry *last;
+	int n_after_entry;
+};
+
+static int dvb_entry_index_add(struct dvb_entry_index *idx,
+			       struct dvb_entry *entry)
+{
+	unsigned lo = 0, hi = idx->n_items, mid;
+	struct dvb_entry **nofreq;
+	void *p;
+	int i;
+
+	for (i = 0; i < entry->n_props; i++) {
+		if (entry->props[i].cmd == DTV_FREQUENCY)
+			break;
+	}
+
+	if (i == entry->n_props) {
+		/* Entries without properties never match */
+		if (!entry->n_props) {
+			idx->last = entry;
+			return 0;
+		}
+
+		nofreq = realloc(idx->nofreq,
+				 (idx->n_nofreq + 1) * sizeof(*idx->nofreq));
+		if (!nofreq)
+			return -ENOMEM;
+		idx->nofreq = nofreq;
+		idx->nofreq[idx->n_nofreq++] = entry;
+		idx->last = entry;
+		return 0;
+	}
+
+	if (idx->n_items == idx->size) {
+		idx->size = idx->size ? idx->size * 2 : 64;
+		p = realloc(idx->items, idx->size * sizeof(*idx->items));
+		if (!p)
+			return -ENOMEM;
+		idx->items = p;
+	}
+
+	/* Insert after the entries with the same frequency */
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (idx->items[mid].freq <= entry->props[i].u.data)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	memmove(&idx->items[lo + 1], &idx->items[lo],
+		(idx->n_items - lo) * sizeof(*idx->items));
+	idx->items[lo].freq = entry->props[i].u.data;
+	idx->items[lo].entry = entry;
+	idx->n_items++;
+	idx->last = entry;
+
+	return 0;
+}
+
+static void dvb_entry_index_free(struct dvb_entry_index *idx)
+{
+	free(idx->items);
+	free(idx->nofreq);
+	free(idx);
+}
+
+/*
+ * Returns NULL if the list can't be indexed. Then, the callers should
+ * walk the list, as before.
+ */
+static struct dvb_entry_index *dvb_entry_index_alloc(struct dvb_entry *first_entry,
+						     struct dvb_entry *entry)
+{
+	struct dvb_entry_index *idx;
+	struct dvb_entry *cur;
+	int found = 0;
+
+	idx = calloc(1, sizeof(*idx));
+	if (!idx)
+		return NULL;
+
+	for (cur = first_entry; cur; cur = cur->next) {
+		if (cur == entry)
+			found = 1;
+		else if (found)
+			idx->n_after_entry++;
+
+		if (dvb_entry_index_add(idx, cur) < 0) {
+			dvb_entry_index_free(idx);
+			return NULL;
 		}
-		if (i == entry->n_props && entry->n_props > 0)
+	}
+
+	/* New entries are appended after the current one */
+	if (!found) {
+		dvb_entry_index_free(idx);
+		return NULL;
+	}
+
+	return idx;
+}
+
+static int dvb_entry_index_is_needed(struct dvb_entry_index *idx,
+				     uint32_t freq, int shift,
+				     enum dvb_sat_polarization pol,
+				     uint32_t stream_id)
+{
+	int64_t low = (int64_t)freq - shift;
+	unsigned lo = 0, hi = idx->n_items, mid, i;
+
+	for (i = 0; i < idx->n_nofreq; i++) {
+		if (dvb_entry_matches(idx->nofreq[i], freq, shift, pol,
+				      stream_id))
+			return 0;
+	}
+
+	/* Seek for the first entry at freq - shift or above */
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (idx->items[mid].freq < low)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (i = lo; i < idx->n_items; i++) {
+		if (idx->items[i].freq > (int64_t)freq + shift)
+			break;
+		if (dvb_entry_matches(idx->items[i].entry, freq, shift, pol,
+				      stream_id))
 			return 0;
 	}
 
 	return 1;
 }
 
-struct dvb_entry *dvb_scan_add_entry_ex(struct dvb_v5_fe_parms *__p,
-					struct dvb_entry *first_entry,
-					struct dvb_entry *entry,
-					uint32_t freq, uint32_t shift,
-					enum dvb_sat_polarization pol,
-					uint32_t stream_id)
+static struct dvb_entry *__dvb_scan_add_entry(struct dvb_v5_fe_parms_priv *parms,
+					      struct dvb_entry_index *idx,
+					      struct dvb_entry *first_entry,
+					      struct dvb_entry *entry,
+					      uint32_t freq, uint32_t shift,
+					      enum dvb_sat_polarization pol,
+					      uint32_t stream_id)
 {
-	struct dvb_v5_fe_parms_priv *parms = (void *)__p;
 	struct dvb_entry *new_entry;
 	int i, n = 2;
 
-	if (!dvb_new_entry_is_needed(first_entry, NULL, freq, shift, pol,
-				     stream_id))
+	if (idx) {
+		if (!dvb_entry_index_is_needed(idx, freq, shift, pol,
+					       stream_id))
+			return NULL;
+	} else if (!dvb_new_entry_is_needed(first_entry, NULL, freq, shift,
+					    pol, stream_id)) {
 		return NULL;
+	}
 
 	/* Clone the current entry into a new entry */
 	new_entry = calloc(sizeof(*new_entry), 1);
@@ -874,9 +1049,21 @@ struct dvb_entry *dvb_scan_add_entry_ex(struct dvb_v5_fe_parms *__p,
 		if (new_entry->props[i].cmd == DTV_FREQUENCY) {
 			new_entry->props[i].u.data = freq;
 			/* Navigate to the end of the entry list */
-			while (entry->next) {
-				entry = entry->next;
-				n++;
+			if (idx) {
+				entry = idx->last;
+				n += idx->n_after_entry;
+				if (dvb_entry_index_add(idx, new_entry) < 0) {
+					dvb_perror(_("not enough memory for a new scanning frequency/TS"));
+					free(new_entry->lnb);
+					free(new_entry);
+					return NULL;
+				}
+				idx->n_after_entry++;
+			} else {
+				while (entry->next) {
+					entry = entry->next;
+					n++;
+				}
 			}
 			dvb_log(_("New transponder/channel found: #%d: %d"),
 			        n, freq);
@@ -893,16 +1080,38 @@ struct dvb_entry *dvb_scan_add_entry_ex(struct dvb_v5_fe_parms *__p,
 	return NULL;
 }
 
+struct dvb_entry *dvb_scan_add_entry_ex(struct dvb_v5_fe_parms *__p,
+					struct dvb_entry *first_entry,
+					struct dvb_entry *entry,
+					uint32_t freq, uint32_t shift,
+					enum dvb_sat_polarization pol,
+					uint32_t stream_id)
+{
+	struct dvb_v5_fe_parms_priv *parms = (void *)__p;
+
+	return __dvb_scan_add_entry(parms, NULL, first_entry, entry, freq,
+				    shift, pol, stream_id);
+}
+
 struct update_transponders {
 	struct dvb_v5_fe_parms *parms;
 	struct dvb_v5_descriptors *dvb_scan_handler;
 	struct dvb_entry *first_entry;
 	struct dvb_entry *entry;
+	struct dvb_entry_index *idx;
 	uint32_t update;
 	enum dvb_sat_polarization pol;
 	uint32_t shift;
 };
 
+static struct dvb_entry *add_nit_entry(struct update_transponders *tr,
+				       uint32_t freq, uint32_t stream_id)
+{
+	return __dvb_scan_add_entry((void *)tr->parms, tr->idx,
+				    tr->first_entry, tr->entry, freq,
+				    tr->shift, tr->pol, stream_id);
+}
+
 static void add_update_nit_dvbc(struct dvb_table_nit *nit,
 				struct dvb_table_nit_transport *tran,
 				struct dvb_desc *desc,
@@ -920,8 +1129,8 @@ static void add_update_nit_dvbc(struct dvb_table_nit *nit,
 			return;
 		new = tr->entry;
 	} else {
-		new = dvb_scan_add_entry(tr->parms, tr->first_entry, tr->entry,
-					 d->frequency, tr->shift, tr->pol);
+		new = add_nit_entry(tr, d->frequency,
+				    NO_STREAM_ID_FILTER);
 		if (!new)
 			return;
 	}
@@ -954,8 +1163,8 @@ static void add_update_nit_isdbt(struct dvb_table_nit *nit,
 	}
 
 	for (i = 0; i < d->num_freqs; i++) {
-		new = dvb_scan_add_entry(tr->parms, tr->first_entry, tr->entry,
-					 d->frequency[i], tr->shift, tr->pol);
+		new = add_nit_entry(tr, d->frequency[i],
+				    NO_STREAM_ID_FILTER);
 		if (!new)
 			return;
 	}
@@ -1029,10 +1238,8 @@ static void add_update_nit_dvbt2(struct dvb_table_nit *nit,
 		return;
 
 	for (i = 0; i < t2->frequency_loop_length; i++) {
-		new = dvb_scan_add_entry_ex(tr->parms,
-					    tr->first_entry, tr->entry,
-					    t2->centre_frequency[i] * 10,
-					    tr->shift, tr->pol, t2->plp_id);
+		new = add_nit_entry(tr, t2->centre_frequency[i] * 10,
+				    t2->plp_id);
 		if (!new)
 			continue;
 
@@ -1061,8 +1268,8 @@ static void add_update_nit_dvbt(struct dvb_table_nit *nit,
 	if (tr->update)
 		return;
 
-	new = dvb_scan_add_entry(tr->parms, tr->first_entry, tr->entry,
-				d->centre_frequency * 10, tr->shift, tr->pol);
+	new = add_nit_entry(tr, d->centre_frequency * 10,
+			    NO_STREAM_ID_FILTER);
 	if (!new)
 		return;
 
@@ -1100,8 +1307,8 @@ static void add_update_nit_dvbs(struct dvb_table_nit *nit,
 			return;
 		new = tr->entry;
 	} else {
-		new = dvb_scan_add_entry(tr->parms, tr->first_entry, tr->entry,
-					 d->frequency, tr->shift, tr->pol);
+		new = add_nit_entry(tr, d->frequency,
+				    NO_STREAM_ID_FILTER);
 		if (!new)
 			return;
 	}
@@ -1143,8 +1350,7 @@ static void add_update_nit_isdbs(struct dvb_table_nit *nit,
 		return;
 
 	ts_id = tran->transport_id;
-	new = dvb_scan_add_entry_ex(tr->parms, tr->first_entry, tr->entry,
-				    d->frequency, tr->shift, tr->pol, ts_id);
+	new = add_nit_entry(tr, d->frequency, ts_id);
 	if (!new)
 		return;
 
@@ -1182,6 +1388,10 @@ static void __dvb_add_update_transponders(struct dvb_v5_fe_parms_priv *parms,
 
 	tr.shift = dvb_estimate_freq_shift(&parms->p);
 
+	/* Only needed when adding new transponders */
+	if (!update)
+		tr.idx = dvb_entry_index_alloc(first_entry, entry);
+
 	switch (parms->p.current_sys) {
 	case SYS_DVBC_ANNEX_A:
 	case SYS_DVBC_ANNEX_C:
@@ -1189,7 +1399,7 @@ static void __dvb_add_update_transponders(struct dvb_v5_fe_parms_priv *parms,
 				&parms->p, dvb_scan_handler->nit,
 				cable_delivery_system_descriptor,
 				NULL, add_update_nit_dvbc, &tr);
-		return;
+		break;
 	case SYS_ISDBT:
 		dvb_table_nit_descriptor_handler(
 				&parms->p, dvb_scan_handler->nit,
@@ -1199,7 +1409,7 @@ static void __dvb_add_update_transponders(struct dvb_v5_fe_parms_priv *parms,
 				dvb_scan_handler->nit,
 				ISDBT_delivery_system_descriptor,
 				NULL, add_update_nit_isdbt, &tr);
-		return;
+		break;
 	case SYS_DVBT:
 	case SYS_DVBT2:
 	case SYS_DTMB:	/* FIXME: are DTMB nit tables equal to DVB-T? */
@@ -1212,26 +1422,29 @@ static void __dvb_add_update_transponders(struct dvb_v5_fe_parms_priv *parms,
 				&parms->p, dvb_scan_handler->nit,
 				terrestrial_delivery_system_descriptor,
 				NULL, add_update_nit_dvbt, &tr);
-		return;
+		break;
 	case SYS_DVBS:
 	case SYS_DVBS2:
 		dvb_table_nit_descriptor_handler(
 				&parms->p, dvb_scan_handler->nit,
 				satellite_delivery_system_descriptor,
 				NULL, add_update_nit_dvbs, &tr);
-		return;
+		break;
 	case SYS_ISDBS:
 		/* see the FIXME: in add_update_nit_isdbs() */
 		dvb_table_nit_descriptor_handler(
 				&parms->p, dvb_scan_handler->nit,
 				satellite_delivery_system_descriptor,
 				NULL, add_update_nit_isdbs, &tr);
-		return;
+		break;
 
 	default:
 		dvb_log(_("Transponders detection not implemented for this standard yet."));
-		return;
+		break;
 	}
+
+	if (tr.idx)
+		dvb_entry_index_free(tr.idx);
 }
 
 void dvb_add_scaned_transponders(struct dvb_v5_fe_parms *__p,
@@ -0,0 +1 @@
+../../utils/common/codec-fwht.c
\ No newline at end of file
@@ -0,0 +1 @@
+../../utils/common/codec-v4l2-fwht.c
\ No newline at end of file
@@ -0,0 +1,222 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * Buffer queue helpers for libv4l2 plugins that emulate a device on top of
+ * a regular file.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "emu-queue.h"
+
+void emu_queue_init(struct emu_queue *q, uint32_t type, uint32_t ts_flags)
+{
+	memset(q, 0, sizeof(*q));
+	q->type = type;
+	q->ts_flags = ts_flags;
+}
+
+void emu_queue_free(struct emu_file *file, struct emu_queue *q)
+{
+	if (!q->mem)
+		return;
+	munmap(q->mem, q->mem_size);
+	/* Give the space back if nothing was allocated after it */
+	if (q->mem_offset + (off_t)q->mem_size == file->size &&
+	    !ftruncate(file->fd, q->mem_offset))
+		file->size = q->mem_offset;
+	q->mem = NULL;
+	q->mem_size = 0;
+	q->num_bufs = 0;
+	q->queued_cnt = q->done_cnt = 0;
+}
+
+int emu_queue_reqbufs(struct emu_file *file, struct emu_queue *q,
+		      struct v4l2_requestbuffers *req, unsigned int buf_size)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+	size_t aligned_size;
+	off_t offset;
+	void *mem;
+	unsigned int i;
+
+	if (req->type != q->type || req->memory != V4L2_MEMORY_MMAP) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (q->streaming) {
+		errno = EBUSY;
+		return -1;
+	}
+	emu_queue_free(file, q);
+	req->capabilities = V4L2_BUF_CAP_SUPPORTS_MMAP;
+	if (req->count == 0)
+		return 0;
+	if (req->count > VIDEO_MAX_FRAME)
+		req->count = VIDEO_MAX_FRAME;
+
+	aligned_size = (buf_size + page_size - 1) & ~(page_size - 1);
+	offset = (file->size + page_size - 1) & ~(page_size - 1);
+	/* m.offset is only 32 bits wide */
+	if (offset + (off_t)(aligned_size * req->count) > UINT32_MAX) {
+		errno = ENOMEM;
+		return -1;
+	}
+	if (ftruncate(file->fd, offset + aligned_size * req->count))
+		return -1;
+	mem = mmap(NULL, aligned_size * req->count, PROT_READ | PROT_WRITE,
+		   MAP_SHARED, file->fd, offset);
+	if (mem == MAP_FAILED)
+		return -1;
+
+	file->size = offset + aligned_size * req->count;
+	q->mem = mem;
+	q->mem_offset = offset;
+	q->mem_size = aligned_size * req->count;
+	q->num_bufs = req->count;
+	q->buf_size = buf_size;
+	for (i = 0; i < q->num_bufs; i++) {
+		struct emu_buf *buf = &q->bufs[i];
+
+		memset(buf, 0, sizeof(*buf));
+		buf->state = EMU_BUF_DEQUEUED;
+		buf->mem = q->mem + i * aligned_size;
+		buf->vb.index = i;
+		buf->vb.type = q->type;
+		buf->vb.memory = V4L2_MEMORY_MMAP;
+		buf->vb.field = V4L2_FIELD_NONE;
+		buf->vb.flags = q->ts_flags;
+		buf->vb.m.offset = offset + i * aligned_size;
+		buf->vb.length = buf_size;
+	}
+	return 0;
+}
+
+static struct emu_buf *emu_queue_buf(struct emu_queue *q,
+				     const struct v4l2_buffer *b)
+{
+	if (b->type != q->type || b->memory != V4L2_MEMORY_MMAP ||
+	    b->index >= q->num_bufs) {
+		errno = EINVAL;
+		return NULL;
+	}
+	return &q->bufs[b->index];
+}
+
+static void emu_queue_fill(const struct emu_buf *buf, struct v4l2_buffer *b)
+{
+	*b = buf->vb;
+	if (buf->state == EMU_BUF_QUEUED)
+		b->flags |= V4L2_BUF_FLAG_QUEUED;
+	else if (buf->state == EMU_BUF_DONE)
+		b->flags |= V4L2_BUF_FLAG_DONE;
+}
+
+int emu_queue_querybuf(struct emu_queue *q, struct v4l2_buffer *b)
+{
+	struct emu_buf *buf = emu_queue_buf(q, b);
+
+	if (!buf)
+		return -1;
+	emu_queue_fill(buf, b);
+	return 0;
+}
+
+int emu_queue_qbuf(struct emu_queue *q, struct v4l2_buffer *b)
+{
+	struct emu_buf *buf = emu_queue_buf(q, b);
+
+	if (!buf)
+		return -1;
+	if (buf->state != EMU_BUF_DEQUEUED) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (V4L2_TYPE_IS_OUTPUT(q->type)) {
+		if (b->bytesused > buf->vb.length) {
+			errno = EINVAL;
+			return -1;
+		}
+		buf->vb.bytesused = b->bytesused ? b->bytesused : buf->vb.length;
+		buf->vb.field = b->field;
+		buf->vb.timestamp = b->timestamp;
+		buf->vb.timecode = b->timecode;
+		buf->vb.flags = q->ts_flags |
+			(b->flags & V4L2_BUF_FLAG_TIMECODE);
+	} else {
+		buf->vb.bytesused = 0;
+		buf->vb.flags = q->ts_flags;
+	}
+	buf->state = EMU_BUF_QUEUED;
+	q->queued[(q->queued_first + q->queued_cnt++) % VIDEO_MAX_FRAME] = b->index;
+	emu_queue_fill(buf, b);
+	return 0;
+}
+
+int emu_queue_dqbuf(struct emu_queue *q, struct v4l2_buffer *b)
+{
+	struct emu_buf *buf;
+
+	if (b->type != q->type || b->memory != V4L2_MEMORY_MMAP) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (!q->done_cnt) {
+		/* never waits: blocking fds are handled by the callers */
+		errno = q->last ? EPIPE : EAGAIN;
+		return -1;
+	}
+	buf = &q->bufs[q->done[q->done_first]];
+	q->done_first = (q->done_first + 1) % VIDEO_MAX_FRAME;
+	q->done_cnt--;
+	buf->state = EMU_BUF_DEQUEUED;
+	if (buf->vb.flags & V4L2_BUF_FLAG_LAST)
+		q->last = true;
+	emu_queue_fill(buf, b);
+	return 0;
+}
+
+int emu_queue_streamon(struct emu_queue *q)
+{
+	if (!q->num_bufs) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (!q->streaming) {
+		q->streaming = true;
+		q->sequence = 0;
+		q->last = false;
+	}
+	return 0;
+}
+
+int emu_queue_streamoff(struct emu_queue *q)
+{
+	unsigned int i;
+
+	for (i = 0; i < q->num_bufs; i++)
+		q->bufs[i].state = EMU_BUF_DEQUEUED;
+	q->queued_first = q->queued_cnt = 0;
+	q->done_first = q->done_cnt = 0;
+	q->streaming = false;
+	q->last = false;
+	return 0;
+}
+
+struct emu_buf *emu_queue_peek(struct emu_queue *q)
+{
+	if (!q->streaming || !q->queued_cnt)
+		return NULL;
+	return &q->bufs[q->queued[q->queued_first]];
+}
+
+void emu_queue_done(struct emu_queue *q, struct emu_buf *buf)
+{
+	q->queued_first = (q->queued_first + 1) % VIDEO_MAX_FRAME;
+	q->queued_cnt--;
+	buf->state = EMU_BUF_DONE;
+	buf->vb.sequence = q->sequence++;
+	q->done[(q->done_first + q->done_cnt++) % VIDEO_MAX_FRAME] = buf->vb.index;
+}
@@ -0,0 +1,80 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Buffer queue helpers for libv4l2 plugins that emulate a device on top of
+ * a regular file.
+ */
+
+#ifndef _EMU_QUEUE_H
+#define _EMU_QUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <linux/videodev2.h>
+
+/*
+ * The memory of all buffers lives in the regular file that stands in for
+ * the device node. The m.offset reported by VIDIOC_QUERYBUF is the page
+ * aligned position of the buffer in that file, so the mmap() that libv4l2
+ * passes through to the file descriptor maps exactly the memory the plugin
+ * fills in.
+ */
+struct emu_file {
+	int fd;
+	off_t size;
+};
+
+enum emu_buf_state {
+	EMU_BUF_DEQUEUED,
+	EMU_BUF_QUEUED,
+	EMU_BUF_DONE,
+};
+
+struct emu_buf {
+	enum emu_buf_state state;
+	uint8_t *mem;
+	struct v4l2_buffer vb;
+};
+
+struct emu_queue {
+	uint32_t type;
+	uint32_t ts_flags;
+	unsigned int num_bufs;
+	unsigned int buf_size;
+	bool streaming;
+	bool last;
+	uint32_t sequence;
+	off_t mem_offset;
+	size_t mem_size;
+	uint8_t *mem;
+
+	/* FIFOs of buffer indices, in the order the buffers were queued/done */
+	unsigned int queued[VIDEO_MAX_FRAME];
+	unsigned int queued_first, queued_cnt;
+	unsigned int done[VIDEO_MAX_FRAME];
+	unsigned int done_first, done_cnt;
+
+	struct emu_buf bufs[VIDEO_MAX_FRAME];
+};
+
+/*
+ * All functions below follow the ioctl() convention: they return 0 on
+ * success and -1 with errno set on failure.
+ */
+/* ts_flags is the V4L2_BUF_FLAG_TIMESTAMP_* type of the queue */
+void emu_queue_init(struct emu_queue *q, uint32_t type, uint32_t ts_flags);
+int emu_queue_reqbufs(struct emu_file *file, struct emu_queue *q,
+		      struct v4l2_requestbuffers *req, unsigned int buf_size);
+int emu_queue_querybuf(struct emu_queue *q, struct v4l2_buffer *b);
+int emu_queue_qbuf(struct emu_queue *q, struct v4l2_buffer *b);
+int emu_queue_dqbuf(struct emu_queue *q, struct v4l2_buffer *b);
+int emu_queue_streamon(struct emu_queue *q);
+int emu_queue_streamoff(struct emu_queue *q);
+void emu_queue_free(struct emu_file *file, struct emu_queue *q);
+
+/* Oldest queued buffer, or NULL if nothing is queued or not streaming */
+struct emu_buf *emu_queue_peek(struct emu_queue *q);
+/* Move the oldest queued buffer to the done list */
+void emu_queue_done(struct emu_queue *q, struct emu_buf *buf);
+
+#endif
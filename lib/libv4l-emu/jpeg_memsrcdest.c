@@ -0,0 +1 @@
+../libv4lconvert/jpeg_memsrcdest.c
\ No newline at end of file
@@ -0,0 +1 @@
+../libv4lconvert/jpeg_memsrcdest.h
\ No newline at end of file
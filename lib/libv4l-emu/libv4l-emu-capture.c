@@ -0,0 +1,780 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * libv4l2 plugin emulating a camera
+ *
+ * This allows exercising libv4l2 and libv4lconvert end-to-end (read()
+ * emulation, mmap streaming, format conversion) without any hardware,
+ * e.g. to benchmark conversions in CI. Since it links the GPL test pattern
+ * generator it is only built with --enable-v4l-emu. The plugin only claims
+ * empty regular files, and only if LIBV4L_EMU=capture is set. Further
+ * settings:
+ *
+ *	LIBV4L_EMU_FORMATS	comma separated list of fourccs the camera
+ *				offers (default: YUYV,MJPG)
+ *	LIBV4L_EMU_FPS		frame rate, 0 delivers frames as fast as they
+ *				are dequeued (default: 30)
+ *	LIBV4L_EMU_FRAMES	number of distinct frames, > 1 gives a moving
+ *				test pattern (default: 1)
+ *
+ * Any single buffer format known to the test pattern generator can be
+ * used, plus MJPG/JPEG (if built with libjpeg) and the S501, S505, S508,
+ * CITV, KONI and M420 vendor formats understood by libv4lconvert.
+ *
+ * e.g.:
+ *
+ *	touch /tmp/cam
+ *	LIBV4L_EMU=capture LIBV4L_EMU_FORMATS=S501 LIBV4L_EMU_FPS=0 \
+ *		v4l2-ctl -w -d /tmp/cam -v pixelformat=RGB3 \
+ *		--stream-mmap --stream-count 1000
+ *
+ * The frames are rendered once when streaming starts and then copied into
+ * the buffers, so that the generator does not skew the measurements.
+ * The buffers are backed by the file itself (see emu-queue.h).
+ *
+ * Note: unlike the rest of libv4l this plugin is GPL, since it uses the
+ * test pattern generator.
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <linux/version.h>
+#include <linux/videodev2.h>
+
+#ifdef HAVE_JPEG
+#include "jpeg_memsrcdest.h"
+#endif
+
+#include "libv4l-plugin.h"
+#include "emu-queue.h"
+#include "v4l2-tpg.h"
+
+#if HAVE_VISIBILITY
+#define PLUGIN_PUBLIC __attribute__ ((visibility("default")))
+#else
+#define PLUGIN_PUBLIC
+#endif
+
+#define MAX_FORMATS	16
+#define MAX_FRAMES	64
+#define MAX_FPS		1000
+#define JPEG_QUALITY	85
+
+static const struct {
+	unsigned int width, height;
+} frame_sizes[] = {
+	{ 320, 240 },
+	{ 640, 480 },
+	{ 1280, 720 },
+	{ 1920, 1080 },
+};
+
+#define MAX_WIDTH	1920
+
+struct capture_plugin {
+	pthread_mutex_t lock;
+	struct emu_file file;
+	struct emu_queue q;
+	struct v4l2_pix_format fmt;
+	uint32_t formats[MAX_FORMATS];
+	unsigned int num_formats;
+	unsigned int fps;
+
+	/* pre-rendered frames */
+	uint8_t *frames[MAX_FRAMES];
+	unsigned int frame_size[MAX_FRAMES];
+	unsigned int num_frames;
+	unsigned int cur_frame;
+
+	/* when the next frame is due, if fps != 0 */
+	struct timespec next_frame;
+};
+
+static bool is_jpeg(uint32_t fourcc)
+{
+	return fourcc == V4L2_PIX_FMT_MJPEG || fourcc == V4L2_PIX_FMT_JPEG;
+}
+
+/* Vendor formats: YUV 4:2:0 reordered, see libv4lconvert/spca501.c */
+static bool is_vendor_yuv420(uint32_t fourcc)
+{
+	switch (fourcc) {
+	case V4L2_PIX_FMT_SPCA501:
+	case V4L2_PIX_FMT_SPCA505:
+	case V4L2_PIX_FMT_SPCA508:
+	case V4L2_PIX_FMT_CIT_YYVYUY:
+	case V4L2_PIX_FMT_KONICA420:
+	case V4L2_PIX_FMT_M420:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* The format the test pattern generator has to render */
+static uint32_t tpg_fourcc(uint32_t fourcc)
+{
+	if (is_jpeg(fourcc))
+		return V4L2_PIX_FMT_RGB24;
+	if (is_vendor_yuv420(fourcc))
+		return V4L2_PIX_FMT_YUV420;
+	return fourcc;
+}
+
+static bool format_is_supported(uint32_t fourcc)
+{
+	struct tpg_data tpg;
+	bool ret;
+
+#ifndef HAVE_JPEG
+	if (is_jpeg(fourcc))
+		return false;
+#endif
+	tpg_init(&tpg, 640, 480);
+	ret = tpg_s_fourcc(&tpg, tpg_fourcc(fourcc)) && tpg_g_buffers(&tpg) == 1;
+	tpg_free(&tpg);
+	return ret;
+}
+
+static void fill_fmt(struct capture_plugin *p, struct v4l2_pix_format *pix)
+{
+	unsigned int best = 0, best_diff = ~0U;
+	unsigned int i;
+
+	for (i = 0; i < p->num_formats; i++)
+		if (p->formats[i] == pix->pixelformat)
+			break;
+	if (i == p->num_formats)
+		pix->pixelformat = p->formats[0];
+
+	for (i = 0; i < sizeof(frame_sizes) / sizeof(frame_sizes[0]); i++) {
+		unsigned int diff = abs((int)frame_sizes[i].width - (int)pix->width) +
+				    abs((int)frame_sizes[i].height - (int)pix->height);
+
+		if (diff < best_diff) {
+			best_diff = diff;
+			best = i;
+		}
+	}
+	pix->width = frame_sizes[best].width;
+	pix->height = frame_sizes[best].height;
+	pix->field = V4L2_FIELD_NONE;
+	pix->colorspace = V4L2_COLORSPACE_SRGB;
+	pix->xfer_func = V4L2_XFER_FUNC_DEFAULT;
+	pix->ycbcr_enc = V4L2_YCBCR_ENC_DEFAULT;
+	pix->quantization = V4L2_QUANTIZATION_DEFAULT;
+	pix->priv = V4L2_PIX_FMT_PRIV_MAGIC;
+	pix->flags = 0;
+
+	if (is_jpeg(pix->pixelformat)) {
+		pix->bytesperline = 0;
+		/* generous, a color bar frame compresses very well */
+		pix->sizeimage = pix->width * pix->height * 2;
+		pix->colorspace = V4L2_COLORSPACE_JPEG;
+	} else if (is_vendor_yuv420(pix->pixelformat)) {
+		pix->bytesperline = pix->width;
+		pix->sizeimage = pix->width * pix->height * 3 / 2;
+	} else {
+		struct tpg_data tpg;
+		unsigned int plane;
+
+		tpg_init(&tpg, pix->width, pix->height);
+		tpg_s_fourcc(&tpg, pix->pixelformat);
+		pix->bytesperline = pix->width * tpg_g_twopixelsize(&tpg, 0) / 2;
+		tpg_s_bytesperline(&tpg, 0, pix->bytesperline);
+		pix->sizeimage = 0;
+		for (plane = 0; plane < tpg_g_planes(&tpg); plane++)
+			pix->sizeimage += tpg_calc_plane_size(&tpg, plane);
+		tpg_free(&tpg);
+	}
+}
+
+static void pack_vendor_yuv420(uint32_t fourcc, const uint8_t *src,
+			       uint8_t *dst, unsigned int w, unsigned int h)
+{
+	const uint8_t *y = src;
+	const uint8_t *u = src + w * h;
+	const uint8_t *v = u + w * h / 4;
+	unsigned int x, l;
+
+	/* These are the exact inverse of the libv4lconvert unpackers */
+	switch (fourcc) {
+	case V4L2_PIX_FMT_KONICA420:
+		for (l = 0; l < w * h / 256; l++) {
+			memcpy(dst, y, 256);
+			memcpy(dst + 256, u, 64);
+			memcpy(dst + 320, v, 64);
+			dst += 384;
+			y += 256;
+			u += 64;
+			v += 64;
+		}
+		return;
+	case V4L2_PIX_FMT_CIT_YYVYUY:
+		for (l = 0; l < h; l += 2) {
+			memcpy(dst, y, w);
+			dst += w;
+			y += w;
+			for (x = 0; x < w; x += 2) {
+				*dst++ = *v++;
+				*dst++ = *y++;
+				*dst++ = *u++;
+				*dst++ = *y++;
+			}
+		}
+		return;
+	case V4L2_PIX_FMT_M420:
+		for (l = 0; l < h; l += 2) {
+			memcpy(dst, y, 2 * w);
+			dst += 2 * w;
+			y += 2 * w;
+			for (x = 0; x < w; x += 2) {
+				*dst++ = *u++;
+				*dst++ = *v++;
+			}
+		}
+		return;
+	}
+
+	/* The SPCA50x formats store signed samples, one line at a time */
+	for (l = 0; l < h; l += 2) {
+		const uint8_t *lines[4];
+		unsigned int i;
+
+		switch (fourcc) {
+		case V4L2_PIX_FMT_SPCA501:	/* Y U Y V */
+			lines[0] = y; lines[1] = u; lines[2] = y + w; lines[3] = v;
+			break;
+		case V4L2_PIX_FMT_SPCA505:	/* Y Y U V */
+			lines[0] = y; lines[1] = y + w; lines[2] = u; lines[3] = v;
+			break;
+		default:			/* Y U V Y */
+			lines[0] = y; lines[1] = u; lines[2] = v; lines[3] = y + w;
+			break;
+		}
+		for (i = 0; i < 4; i++) {
+			unsigned int len = (lines[i] == u || lines[i] == v) ? w / 2 : w;
+
+			for (x = 0; x < len; x++)
+				*dst++ = lines[i][x] ^ 0x80;
+		}
+		y += 2 * w;
+		u += w / 2;
+		v += w / 2;
+	}
+}
+
+#ifdef HAVE_JPEG
+static unsigned int compress_jpeg(const uint8_t *rgb, uint8_t *dst,
+				  unsigned int dst_size, unsigned int w,
+				  unsigned int h)
+{
+	struct jpeg_compress_struct cinfo;
+	struct jpeg_error_mgr jerr;
+	unsigned char *out = NULL;
+	unsigned long out_size = 0;
+	unsigned int l;
+
+	cinfo.err = jpeg_std_error(&jerr);
+	jpeg_create_compress(&cinfo);
+	jpeg_mem_dest(&cinfo, &out, &out_size);
+	cinfo.image_width = w;
+	cinfo.image_height = h;
+	cinfo.input_components = 3;
+	cinfo.in_color_space = JCS_RGB;
+	jpeg_set_defaults(&cinfo);
+	jpeg_set_quality(&cinfo, JPEG_QUALITY, TRUE);
+	jpeg_start_compress(&cinfo, TRUE);
+	for (l = 0; l < h; l++) {
+		JSAMPROW row = (JSAMPROW)(rgb + l * w * 3);
+
+		jpeg_write_scanlines(&cinfo, &row, 1);
+	}
+	jpeg_finish_compress(&cinfo);
+	jpeg_destroy_compress(&cinfo);
+
+	if (out_size > dst_size)
+		out_size = 0;
+	else
+		memcpy(dst, out, out_size);
+	free(out);
+	return out_size;
+}
+#endif
+
+static void free_frames(struct capture_plugin *p)
+{
+	unsigned int i;
+
+	for (i = 0; i < p->num_frames; i++)
+		free(p->frames[i]);
+	p->num_frames = 0;
+}
+
+static int render_frames(struct capture_plugin *p, unsigned int count)
+{
+	const struct v4l2_pix_format *pix = &p->fmt;
+	uint32_t fourcc = tpg_fourcc(pix->pixelformat);
+	struct tpg_data tpg;
+	uint8_t *tmp = NULL;
+	unsigned int i;
+	int ret = 0;
+
+	tpg_init(&tpg, pix->width, pix->height);
+	if (tpg_alloc(&tpg, MAX_WIDTH)) {
+		tpg_free(&tpg);
+		errno = ENOMEM;
+		return -1;
+	}
+	tpg_s_fourcc(&tpg, fourcc);
+	tpg_reset_source(&tpg, pix->width, pix->height, V4L2_FIELD_NONE);
+	tpg_s_field(&tpg, V4L2_FIELD_NONE, false);
+	tpg_s_colorspace(&tpg, V4L2_COLORSPACE_SRGB);
+	tpg_s_bytesperline(&tpg, 0, fourcc == pix->pixelformat ?
+			   pix->bytesperline :
+			   pix->width * tpg_g_twopixelsize(&tpg, 0) / 2);
+	tpg_s_pattern(&tpg, TPG_PAT_75_COLORBAR);
+	if (count > 1)
+		tpg_s_mv_hor_mode(&tpg, TPG_MOVE_POS);
+
+	if (fourcc != pix->pixelformat) {
+		tmp = malloc(pix->width * pix->height * 3);
+		if (!tmp)
+			ret = -1;
+	}
+
+	for (i = 0; !ret && i < count; i++) {
+		uint8_t *frame = malloc(pix->sizeimage);
+
+		if (!frame) {
+			ret = -1;
+			break;
+		}
+		p->frames[i] = frame;
+		p->num_frames++;
+		p->frame_size[i] = pix->sizeimage;
+		tpg_fillbuffer(&tpg, 0, 0, tmp ? tmp : frame);
+		tpg_update_mv_count(&tpg, false);
+		if (is_vendor_yuv420(pix->pixelformat))
+			pack_vendor_yuv420(pix->pixelformat, tmp, frame,
+					   pix->width, pix->height);
+#ifdef HAVE_JPEG
+		else if (is_jpeg(pix->pixelformat))
+			p->frame_size[i] = compress_jpeg(tmp, frame,
+							 pix->sizeimage,
+							 pix->width,
+							 pix->height);
+#endif
+	}
+	free(tmp);
+	tpg_free(&tpg);
+	if (ret) {
+		free_frames(p);
+		errno = ENOMEM;
+	}
+	return ret;
+}
+
+static void timespec_add_ns(struct timespec *ts, long ns)
+{
+	ts->tv_nsec += ns;
+	while (ts->tv_nsec >= 1000000000L) {
+		ts->tv_nsec -= 1000000000L;
+		ts->tv_sec++;
+	}
+}
+
+static bool timespec_before(const struct timespec *a, const struct timespec *b)
+{
+	return a->tv_sec < b->tv_sec ||
+	       (a->tv_sec == b->tv_sec && a->tv_nsec < b->tv_nsec);
+}
+
+/*
+ * Deliver the next frame into the oldest queued buffer, waiting until it
+ * is due. Called with the lock held, which is dropped while sleeping.
+ */
+static int dqbuf(struct capture_plugin *p, int fd, struct v4l2_buffer *b)
+{
+	struct emu_buf *buf;
+	struct timespec now;
+
+	if (b->type != p->q.type) {
+		errno = EINVAL;
+		return -1;
+	}
+	while (!p->q.done_cnt) {
+		buf = emu_queue_peek(&p->q);
+		if (!buf) {
+			errno = p->q.streaming ? EAGAIN : EINVAL;
+			return -1;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if (p->fps && timespec_before(&now, &p->next_frame)) {
+			struct timespec due = p->next_frame;
+
+			if (fcntl(fd, F_GETFL) & O_NONBLOCK) {
+				errno = EAGAIN;
+				return -1;
+			}
+			pthread_mutex_unlock(&p->lock);
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+			pthread_mutex_lock(&p->lock);
+			continue;
+		}
+
+		memcpy(buf->mem, p->frames[p->cur_frame],
+		       p->frame_size[p->cur_frame]);
+		buf->vb.bytesused = p->frame_size[p->cur_frame];
+		buf->vb.field = V4L2_FIELD_NONE;
+		buf->vb.timestamp.tv_sec = now.tv_sec;
+		buf->vb.timestamp.tv_usec = now.tv_nsec / 1000;
+		if (!buf->vb.bytesused)
+			buf->vb.flags |= V4L2_BUF_FLAG_ERROR;
+		p->cur_frame = (p->cur_frame + 1) % p->num_frames;
+		if (p->fps) {
+			timespec_add_ns(&p->next_frame, 1000000000L / p->fps);
+			/* the application fell behind: drop frames */
+			if (timespec_before(&p->next_frame, &now)) {
+				p->next_frame = now;
+				timespec_add_ns(&p->next_frame,
+						1000000000L / p->fps);
+			}
+		}
+		emu_queue_done(&p->q, buf);
+	}
+	return emu_queue_dqbuf(&p->q, b);
+}
+
+static int streamon(struct capture_plugin *p)
+{
+	const char *s = getenv("LIBV4L_EMU_FRAMES");
+	unsigned int count = s ? strtoul(s, NULL, 0) : 1;
+
+	if (p->q.streaming)
+		return 0;
+	if (count < 1)
+		count = 1;
+	if (count > MAX_FRAMES)
+		count = MAX_FRAMES;
+	if (emu_queue_streamon(&p->q))
+		return -1;
+	free_frames(p);
+	if (render_frames(p, count)) {
+		emu_queue_streamoff(&p->q);
+		return -1;
+	}
+	p->cur_frame = 0;
+	clock_gettime(CLOCK_MONOTONIC, &p->next_frame);
+	return 0;
+}
+
+static int enum_fmt(struct capture_plugin *p, struct v4l2_fmtdesc *f)
+{
+	uint32_t index = f->index;
+	uint32_t fourcc;
+
+	if (f->type != V4L2_BUF_TYPE_VIDEO_CAPTURE || index >= p->num_formats) {
+		errno = EINVAL;
+		return -1;
+	}
+	fourcc = p->formats[index];
+	memset(f, 0, sizeof(*f));
+	f->index = index;
+	f->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	f->pixelformat = fourcc;
+	if (is_jpeg(fourcc))
+		f->flags = V4L2_FMT_FLAG_COMPRESSED;
+	snprintf((char *)f->description, sizeof(f->description), "%c%c%c%c",
+		 fourcc & 0xff, (fourcc >> 8) & 0xff,
+		 (fourcc >> 16) & 0xff, (fourcc >> 24) & 0xff);
+	return 0;
+}
+
+static int enum_framesizes(struct capture_plugin *p,
+			   struct v4l2_frmsizeenum *fsize)
+{
+	struct v4l2_pix_format pix = { .pixelformat = fsize->pixel_format };
+
+	fill_fmt(p, &pix);
+	if (pix.pixelformat != fsize->pixel_format ||
+	    fsize->index >= sizeof(frame_sizes) / sizeof(frame_sizes[0])) {
+		errno = EINVAL;
+		return -1;
+	}
+	fsize->type = V4L2_FRMSIZE_TYPE_DISCRETE;
+	fsize->discrete.width = frame_sizes[fsize->index].width;
+	fsize->discrete.height = frame_sizes[fsize->index].height;
+	return 0;
+}
+
+static int enum_frameintervals(struct capture_plugin *p,
+			       struct v4l2_frmivalenum *fival)
+{
+	struct v4l2_pix_format pix = {
+		.pixelformat = fival->pixel_format,
+		.width = fival->width,
+		.height = fival->height,
+	};
+
+	fill_fmt(p, &pix);
+	if (fival->index || pix.pixelformat != fival->pixel_format ||
+	    pix.width != fival->width || pix.height != fival->height) {
+		errno = EINVAL;
+		return -1;
+	}
+	fival->type = V4L2_FRMIVAL_TYPE_CONTINUOUS;
+	fival->stepwise.min.numerator = 1;
+	fival->stepwise.min.denominator = MAX_FPS;
+	fival->stepwise.max.numerator = 1;
+	fival->stepwise.max.denominator = 1;
+	fival->stepwise.step.numerator = 1;
+	fival->stepwise.step.denominator = 1;
+	return 0;
+}
+
+static int parm(struct capture_plugin *p, unsigned long int cmd,
+		struct v4l2_streamparm *parm)
+{
+	struct v4l2_fract *tpf = &parm->parm.capture.timeperframe;
+
+	if (parm->type != V4L2_BUF_TYPE_VIDEO_CAPTURE) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (cmd == VIDIOC_S_PARM && tpf->numerator && tpf->denominator) {
+		p->fps = tpf->denominator / tpf->numerator;
+		if (p->fps < 1)
+			p->fps = 1;
+		if (p->fps > MAX_FPS)
+			p->fps = MAX_FPS;
+	}
+	memset(&parm->parm, 0, sizeof(parm->parm));
+	parm->parm.capture.capability = V4L2_CAP_TIMEPERFRAME;
+	/* unthrottled is reported as the maximum frame rate */
+	tpf->numerator = 1;
+	tpf->denominator = p->fps ? p->fps : MAX_FPS;
+	return 0;
+}
+
+static int input_ioctl(unsigned long int cmd, void *arg)
+{
+	struct v4l2_input *inp = arg;
+	unsigned int *i = arg;
+
+	switch (cmd) {
+	case VIDIOC_ENUMINPUT:
+		if (inp->index) {
+			errno = EINVAL;
+			return -1;
+		}
+		memset(inp, 0, sizeof(*inp));
+		strcpy((char *)inp->name, "Camera");
+		inp->type = V4L2_INPUT_TYPE_CAMERA;
+		return 0;
+	case VIDIOC_G_INPUT:
+		*i = 0;
+		return 0;
+	default:
+		if (*i) {
+			errno = EINVAL;
+			return -1;
+		}
+		return 0;
+	}
+}
+
+static int querycap(struct v4l2_capability *cap)
+{
+	memset(cap, 0, sizeof(*cap));
+	strcpy((char *)cap->driver, "libv4l-emu");
+	strcpy((char *)cap->card, "Camera (emulated)");
+	strcpy((char *)cap->bus_info, "platform:libv4l-emu");
+	cap->version = LINUX_VERSION_CODE;
+	cap->device_caps = V4L2_CAP_VIDEO_CAPTURE | V4L2_CAP_STREAMING |
+			   V4L2_CAP_EXT_PIX_FORMAT;
+	cap->capabilities = cap->device_caps | V4L2_CAP_DEVICE_CAPS;
+	return 0;
+}
+
+static int do_ioctl(struct capture_plugin *p, int fd, unsigned long int cmd,
+		    void *arg)
+{
+	struct v4l2_format *f = arg;
+
+	switch (cmd) {
+	case VIDIOC_QUERYCAP:
+		return querycap(arg);
+	case VIDIOC_ENUMINPUT:
+	case VIDIOC_G_INPUT:
+	case VIDIOC_S_INPUT:
+		return input_ioctl(cmd, arg);
+	case VIDIOC_ENUM_FMT:
+		return enum_fmt(p, arg);
+	case VIDIOC_ENUM_FRAMESIZES:
+		return enum_framesizes(p, arg);
+	case VIDIOC_ENUM_FRAMEINTERVALS:
+		return enum_frameintervals(p, arg);
+	case VIDIOC_G_PARM:
+	case VIDIOC_S_PARM:
+		return parm(p, cmd, arg);
+	case VIDIOC_G_FMT:
+	case VIDIOC_TRY_FMT:
+	case VIDIOC_S_FMT:
+		if (f->type != V4L2_BUF_TYPE_VIDEO_CAPTURE) {
+			errno = EINVAL;
+			return -1;
+		}
+		if (cmd == VIDIOC_G_FMT) {
+			f->fmt.pix = p->fmt;
+			return 0;
+		}
+		fill_fmt(p, &f->fmt.pix);
+		if (cmd == VIDIOC_TRY_FMT)
+			return 0;
+		if (p->q.num_bufs) {
+			errno = EBUSY;
+			return -1;
+		}
+		p->fmt = f->fmt.pix;
+		return 0;
+	case VIDIOC_REQBUFS:
+		return emu_queue_reqbufs(&p->file, &p->q, arg, p->fmt.sizeimage);
+	case VIDIOC_QUERYBUF:
+		return emu_queue_querybuf(&p->q, arg);
+	case VIDIOC_QBUF:
+		return emu_queue_qbuf(&p->q, arg);
+	case VIDIOC_DQBUF:
+		return dqbuf(p, fd, arg);
+	case VIDIOC_STREAMON:
+	case VIDIOC_STREAMOFF:
+		if (*(int *)arg != V4L2_BUF_TYPE_VIDEO_CAPTURE) {
+			errno = EINVAL;
+			return -1;
+		}
+		if (cmd == VIDIOC_STREAMON)
+			return streamon(p);
+		return emu_queue_streamoff(&p->q);
+	}
+	errno = ENOTTY;
+	return -1;
+}
+
+static void *plugin_init(int fd)
+{
+	const char *mode = getenv("LIBV4L_EMU");
+	const char *s = getenv("LIBV4L_EMU_FORMATS");
+	struct capture_plugin *p;
+	struct stat st;
+
+	/*
+	 * Only emulate on top of regular files, never on real devices. The
+	 * file becomes the backing store of the buffers, so it must be empty:
+	 * never touch the contents of a file the caller cares about.
+	 */
+	if (!mode || strcmp(mode, "capture") ||
+	    fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_size)
+		return NULL;
+
+	p = calloc(1, sizeof(*p));
+	if (!p) {
+		perror("Couldn't allocate memory for plugin");
+		return NULL;
+	}
+
+	if (!s)
+		s = "YUYV,MJPG";
+	while (*s && p->num_formats < MAX_FORMATS) {
+		char fcc[4] = { ' ', ' ', ' ', ' ' };
+		unsigned int i;
+		uint32_t fourcc;
+
+		for (i = 0; *s && *s != ','; s++)
+			if (i < 4)
+				fcc[i++] = *s;
+		if (*s == ',')
+			s++;
+		fourcc = v4l2_fourcc(fcc[0], fcc[1], fcc[2], fcc[3]);
+		if (format_is_supported(fourcc))
+			p->formats[p->num_formats++] = fourcc;
+		else
+			fprintf(stderr, "libv4l-emu: unsupported format '%.4s'\n",
+				fcc);
+	}
+	if (!p->num_formats) {
+		free(p);
+		return NULL;
+	}
+
+	s = getenv("LIBV4L_EMU_FPS");
+	p->fps = s ? strtoul(s, NULL, 0) : 30;
+	if (p->fps > MAX_FPS)
+		p->fps = MAX_FPS;
+
+	pthread_mutex_init(&p->lock, NULL);
+	p->file.fd = fd;
+	emu_queue_init(&p->q, V4L2_BUF_TYPE_VIDEO_CAPTURE,
+		       V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC |
+		       V4L2_BUF_FLAG_TSTAMP_SRC_EOF);
+	p->fmt.width = 640;
+	p->fmt.height = 480;
+	p->fmt.pixelformat = p->formats[0];
+	fill_fmt(p, &p->fmt);
+
+	return p;
+}
+
+static void plugin_close(void *dev_ops_priv)
+{
+	struct capture_plugin *p = dev_ops_priv;
+
+	if (p == NULL)
+		return;
+
+	emu_queue_free(&p->file, &p->q);
+	free_frames(p);
+	pthread_mutex_destroy(&p->lock);
+	free(p);
+}
+
+static int plugin_ioctl(void *dev_ops_priv, int fd, unsigned long int cmd,
+			void *arg)
+{
+	struct capture_plugin *p = dev_ops_priv;
+	int ret;
+
+	pthread_mutex_lock(&p->lock);
+	ret = do_ioctl(p, fd, cmd, arg);
+	pthread_mutex_unlock(&p->lock);
+	return ret;
+}
+
+/* No read() support, libv4l2 emulates it using the streaming I/O */
+static ssize_t plugin_read(void *dev_ops_priv, int fd, void *buf, size_t len)
+{
+	errno = EINVAL;
+	return -1;
+}
+
+static ssize_t plugin_write(void *dev_ops_priv, int fd, const void *buf,
+			    size_t len)
+{
+	errno = EINVAL;
+	return -1;
+}
+
+PLUGIN_PUBLIC const struct libv4l_dev_ops libv4l2_plugin = {
+	.init = &plugin_init,
+	.close = &plugin_close,
+	.ioctl = &plugin_ioctl,
+	.read = &plugin_read,
+	.write = &plugin_write,
+};
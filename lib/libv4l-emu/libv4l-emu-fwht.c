@@ -0,0 +1,696 @@
+// SPDX-License-Identifier: LGPL-2.1-or-later
+/*
+ * libv4l2 plugin emulating a stateful FWHT memory-to-memory codec
+ *
+ * This allows exercising the codec paths of applications (e.g. the
+ * stateful m2m streaming code of v4l2-ctl) on systems where the vicodec
+ * driver is not available. It is only built with --enable-v4l-emu. The
+ * plugin only claims empty regular files, and only if the LIBV4L_EMU
+ * environment variable selects it:
+ *
+ *	LIBV4L_EMU=fwht-enc	raw frames in, FWHT compressed frames out
+ *	LIBV4L_EMU=fwht-dec	FWHT compressed frames in, raw frames out
+ *
+ * e.g.:
+ *
+ *	touch /tmp/enc
+ *	LIBV4L_EMU=fwht-enc v4l2-ctl -w -d /tmp/enc --stream-mmap \
+ *		--stream-out-mmap --stream-to out.fwht
+ *
+ * The buffers are backed by the file itself (see emu-queue.h), the codec
+ * runs synchronously whenever both an output and a capture buffer are
+ * queued. Only single-planar MMAP streaming is supported.
+ */
+
+#include <config.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <linux/version.h>
+#include <linux/videodev2.h>
+
+#include "libv4l-plugin.h"
+#include "emu-queue.h"
+#include "v4l-stream.h"
+
+#if HAVE_VISIBILITY
+#define PLUGIN_PUBLIC __attribute__ ((visibility("default")))
+#else
+#define PLUGIN_PUBLIC
+#endif
+
+#define MIN_WIDTH	64
+#define MAX_WIDTH	4096
+#define MIN_HEIGHT	64
+#define MAX_HEIGHT	2160
+#define QP		20
+
+struct fwht_plugin {
+	pthread_mutex_t lock;
+	/* signalled after every ioctl, for blocking VIDIOC_DQBUF */
+	pthread_cond_t cond;
+	struct emu_file file;
+	bool is_enc;
+	struct emu_queue out_q;
+	struct emu_queue cap_q;
+	struct v4l2_pix_format out_fmt;
+	struct v4l2_pix_format cap_fmt;
+	struct codec_ctx *ctx;
+	/* decoder only: the compressed frame being gathered */
+	uint8_t *comp_frame;
+	unsigned int comp_fill;
+	unsigned int comp_max_size;
+	unsigned int out_pos;
+	struct timeval frame_ts;
+	bool stopping;
+	bool eos_subscribed;
+	bool eos_pending;
+};
+
+static struct v4l2_pix_format *raw_fmt(struct fwht_plugin *p)
+{
+	return p->is_enc ? &p->out_fmt : &p->cap_fmt;
+}
+
+static struct v4l2_pix_format *get_fmt(struct fwht_plugin *p, uint32_t type)
+{
+	if (type == V4L2_BUF_TYPE_VIDEO_OUTPUT)
+		return &p->out_fmt;
+	if (type == V4L2_BUF_TYPE_VIDEO_CAPTURE)
+		return &p->cap_fmt;
+	return NULL;
+}
+
+static struct emu_queue *get_queue(struct fwht_plugin *p, uint32_t type)
+{
+	if (type == V4L2_BUF_TYPE_VIDEO_OUTPUT)
+		return &p->out_q;
+	if (type == V4L2_BUF_TYPE_VIDEO_CAPTURE)
+		return &p->cap_q;
+	return NULL;
+}
+
+static bool is_compressed(struct fwht_plugin *p, uint32_t type)
+{
+	return p->is_enc == (type == V4L2_BUF_TYPE_VIDEO_CAPTURE);
+}
+
+/* Same worst case as fwht_alloc() uses for its comp_max_size */
+static unsigned int comp_sizeimage(const struct v4l2_fwht_pixfmt_info *info,
+				   unsigned int width, unsigned int height)
+{
+	unsigned int size = width * height;
+	unsigned int chroma_div = info->width_div * info->height_div;
+
+	if (info->components_num == 4)
+		size = 2 * size + 2 * (size / chroma_div);
+	else if (info->components_num == 3)
+		size = size + 2 * (size / chroma_div);
+	return size + sizeof(struct fwht_cframe_hdr);
+}
+
+static void free_ctx(struct fwht_plugin *p)
+{
+	if (p->ctx)
+		fwht_free(p->ctx);
+	free(p->comp_frame);
+	p->ctx = NULL;
+	p->comp_frame = NULL;
+	p->comp_fill = 0;
+	p->out_pos = 0;
+}
+
+static void fill_fmt(struct v4l2_pix_format *pix, bool compressed,
+		     const struct v4l2_fwht_pixfmt_info *info)
+{
+	pix->width = (pix->width + 7) & ~7;
+	pix->height = (pix->height + 7) & ~7;
+	if (pix->width < MIN_WIDTH)
+		pix->width = MIN_WIDTH;
+	if (pix->width > MAX_WIDTH)
+		pix->width = MAX_WIDTH;
+	if (pix->height < MIN_HEIGHT)
+		pix->height = MIN_HEIGHT;
+	if (pix->height > MAX_HEIGHT)
+		pix->height = MAX_HEIGHT;
+	pix->field = V4L2_FIELD_NONE;
+	pix->priv = V4L2_PIX_FMT_PRIV_MAGIC;
+	pix->flags = 0;
+	if (compressed) {
+		pix->pixelformat = V4L2_PIX_FMT_FWHT;
+		pix->bytesperline = 0;
+		pix->sizeimage = comp_sizeimage(info, pix->width, pix->height);
+	} else {
+		pix->pixelformat = info->id;
+		pix->bytesperline = pix->width * info->bytesperline_mult;
+		pix->sizeimage = pix->width * pix->height *
+			info->sizeimage_mult / info->sizeimage_div;
+	}
+	if (pix->colorspace == V4L2_COLORSPACE_DEFAULT)
+		pix->colorspace = V4L2_COLORSPACE_REC709;
+}
+
+static int try_fmt(struct fwht_plugin *p, struct v4l2_format *f)
+{
+	const struct v4l2_fwht_pixfmt_info *info;
+	struct v4l2_pix_format *pix = &f->fmt.pix;
+
+	if (!get_fmt(p, f->type)) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (is_compressed(p, f->type)) {
+		info = v4l2_fwht_find_pixfmt(raw_fmt(p)->pixelformat);
+	} else {
+		info = v4l2_fwht_find_pixfmt(pix->pixelformat);
+		if (!info)
+			info = v4l2_fwht_get_pixfmt(0);
+	}
+	fill_fmt(pix, is_compressed(p, f->type), info);
+	return 0;
+}
+
+static int s_fmt(struct fwht_plugin *p, struct v4l2_format *f)
+{
+	uint32_t other_type = V4L2_TYPE_IS_OUTPUT(f->type) ?
+		V4L2_BUF_TYPE_VIDEO_CAPTURE : V4L2_BUF_TYPE_VIDEO_OUTPUT;
+	struct v4l2_pix_format *other = get_fmt(p, other_type);
+
+	if (try_fmt(p, f))
+		return -1;
+	if (get_queue(p, f->type)->num_bufs) {
+		errno = EBUSY;
+		return -1;
+	}
+	*get_fmt(p, f->type) = f->fmt.pix;
+
+	/*
+	 * The resolution and colorimetry of both sides are always the same,
+	 * so propagate them to the other side, unless that is busy.
+	 */
+	if (!get_queue(p, other_type)->num_bufs) {
+		other->width = f->fmt.pix.width;
+		other->height = f->fmt.pix.height;
+		other->colorspace = f->fmt.pix.colorspace;
+		other->xfer_func = f->fmt.pix.xfer_func;
+		other->ycbcr_enc = f->fmt.pix.ycbcr_enc;
+		other->quantization = f->fmt.pix.quantization;
+		fill_fmt(other, is_compressed(p, other_type),
+			 v4l2_fwht_find_pixfmt(raw_fmt(p)->pixelformat));
+	}
+
+	free_ctx(p);
+	return 0;
+}
+
+static int enum_fmt(struct fwht_plugin *p, struct v4l2_fmtdesc *f)
+{
+	const struct v4l2_fwht_pixfmt_info *info;
+	uint32_t index = f->index;
+	uint32_t type = f->type;
+
+	if (!get_fmt(p, type)) {
+		errno = EINVAL;
+		return -1;
+	}
+	memset(f, 0, sizeof(*f));
+	f->index = index;
+	f->type = type;
+	if (is_compressed(p, type)) {
+		if (index) {
+			errno = EINVAL;
+			return -1;
+		}
+		f->pixelformat = V4L2_PIX_FMT_FWHT;
+		f->flags = V4L2_FMT_FLAG_COMPRESSED;
+		strcpy((char *)f->description, "FWHT");
+		return 0;
+	}
+	info = v4l2_fwht_get_pixfmt(index);
+	if (!info) {
+		errno = EINVAL;
+		return -1;
+	}
+	f->pixelformat = info->id;
+	snprintf((char *)f->description, sizeof(f->description), "%c%c%c%c",
+		 info->id & 0xff, (info->id >> 8) & 0xff,
+		 (info->id >> 16) & 0xff, (info->id >> 24) & 0xff);
+	return 0;
+}
+
+static int enum_framesizes(struct v4l2_frmsizeenum *fsize)
+{
+	if (fsize->index ||
+	    (fsize->pixel_format != V4L2_PIX_FMT_FWHT &&
+	     !v4l2_fwht_find_pixfmt(fsize->pixel_format))) {
+		errno = EINVAL;
+		return -1;
+	}
+	fsize->type = V4L2_FRMSIZE_TYPE_STEPWISE;
+	fsize->stepwise.min_width = MIN_WIDTH;
+	fsize->stepwise.max_width = MAX_WIDTH;
+	fsize->stepwise.step_width = 8;
+	fsize->stepwise.min_height = MIN_HEIGHT;
+	fsize->stepwise.max_height = MAX_HEIGHT;
+	fsize->stepwise.step_height = 8;
+	return 0;
+}
+
+static bool frame_complete(struct fwht_plugin *p)
+{
+	const struct fwht_cframe_hdr *hdr = (void *)p->comp_frame;
+
+	return p->comp_fill >= sizeof(*hdr) &&
+	       p->comp_fill == sizeof(*hdr) + ntohl(hdr->size);
+}
+
+/*
+ * Like vicodec the decoder accepts the compressed stream in chunks of any
+ * size, so gather the next frame from the output buffers. Output buffers
+ * are returned as soon as all their data is consumed.
+ */
+static bool gather_frame(struct fwht_plugin *p)
+{
+	const unsigned int hdr_size = sizeof(struct fwht_cframe_hdr);
+	const struct fwht_cframe_hdr *hdr = (void *)p->comp_frame;
+	struct emu_buf *out;
+
+	while (!frame_complete(p) && (out = emu_queue_peek(&p->out_q))) {
+		unsigned int need = p->comp_fill < hdr_size ?
+			hdr_size : hdr_size + ntohl(hdr->size);
+		unsigned int n = out->vb.bytesused - p->out_pos;
+
+		if (n > need - p->comp_fill)
+			n = need - p->comp_fill;
+		memcpy(p->comp_frame + p->comp_fill, out->mem + p->out_pos, n);
+		p->comp_fill += n;
+		p->out_pos += n;
+		p->frame_ts = out->vb.timestamp;
+
+		/* not a valid header, skip a byte to resync */
+		if (p->comp_fill == hdr_size && need == hdr_size &&
+		    (hdr->magic1 != FWHT_MAGIC1 || hdr->magic2 != FWHT_MAGIC2 ||
+		     hdr_size + ntohl(hdr->size) > p->comp_max_size))
+			memmove(p->comp_frame, p->comp_frame + 1, --p->comp_fill);
+
+		if (p->out_pos == out->vb.bytesused) {
+			p->out_pos = 0;
+			emu_queue_done(&p->out_q, out);
+		}
+	}
+	return frame_complete(p);
+}
+
+/*
+ * Once all pending output data is processed after a STOP command,
+ * flag the last capture buffer. If the last produced buffer was already
+ * dequeued, an empty capture buffer carries the flag instead.
+ */
+static void try_stop(struct fwht_plugin *p)
+{
+	struct emu_queue *q = &p->cap_q;
+	struct emu_buf *buf;
+
+	if (!p->stopping || emu_queue_peek(&p->out_q) || frame_complete(p))
+		return;
+	/* a trailing partial frame can never be decoded */
+	p->comp_fill = 0;
+	if (q->done_cnt) {
+		buf = &q->bufs[q->done[(q->done_first + q->done_cnt - 1) %
+				       VIDEO_MAX_FRAME]];
+	} else {
+		buf = emu_queue_peek(q);
+		if (!buf)
+			return;
+		buf->vb.bytesused = 0;
+		emu_queue_done(q, buf);
+	}
+	buf->vb.flags |= V4L2_BUF_FLAG_LAST;
+	p->stopping = false;
+	p->eos_pending = p->eos_subscribed;
+}
+
+static bool alloc_ctx(struct fwht_plugin *p)
+{
+	const struct v4l2_pix_format *raw = raw_fmt(p);
+
+	p->ctx = fwht_alloc(raw->pixelformat, raw->width, raw->height,
+			    raw->width, raw->height, raw->field,
+			    raw->colorspace, raw->xfer_func, raw->ycbcr_enc,
+			    raw->quantization);
+	if (!p->ctx)
+		return false;
+	p->ctx->state.i_frame_qp = QP;
+	p->ctx->state.p_frame_qp = QP;
+	if (p->is_enc)
+		return true;
+	p->comp_max_size = p->ctx->comp_max_size;
+	p->comp_frame = malloc(p->comp_max_size);
+	if (!p->comp_frame) {
+		free_ctx(p);
+		return false;
+	}
+	return true;
+}
+
+static void run_jobs(struct fwht_plugin *p)
+{
+	const struct v4l2_pix_format *raw = raw_fmt(p);
+	struct emu_buf *out, *cap;
+
+	while ((cap = emu_queue_peek(&p->cap_q))) {
+		bool ok;
+
+		if (!p->ctx && !alloc_ctx(p))
+			return;
+
+		if (p->is_enc) {
+			out = emu_queue_peek(&p->out_q);
+			if (!out)
+				break;
+			ok = out->vb.bytesused >= raw->sizeimage;
+			if (ok)
+				cap->vb.bytesused =
+					v4l2_fwht_encode(&p->ctx->state,
+							 out->mem, cap->mem);
+			else
+				out->vb.flags |= V4L2_BUF_FLAG_ERROR;
+			cap->vb.timestamp = out->vb.timestamp;
+			cap->vb.timecode = out->vb.timecode;
+			cap->vb.flags |= out->vb.flags & V4L2_BUF_FLAG_TIMECODE;
+			emu_queue_done(&p->out_q, out);
+		} else {
+			if (!gather_frame(p))
+				break;
+			ok = fwht_decompress(p->ctx, p->comp_frame, p->comp_fill,
+					     cap->mem, cap->vb.length);
+			cap->vb.bytesused = raw->sizeimage;
+			cap->vb.timestamp = p->frame_ts;
+			p->comp_fill = 0;
+		}
+		if (!ok) {
+			cap->vb.flags |= V4L2_BUF_FLAG_ERROR;
+			cap->vb.bytesused = 0;
+		}
+		cap->vb.field = V4L2_FIELD_NONE;
+		emu_queue_done(&p->cap_q, cap);
+	}
+	try_stop(p);
+}
+
+static int codec_cmd(struct fwht_plugin *p, uint32_t *cmd, bool try_only)
+{
+	bool is_stop = *cmd == (p->is_enc ? V4L2_ENC_CMD_STOP : V4L2_DEC_CMD_STOP);
+	bool is_start = *cmd == (p->is_enc ? V4L2_ENC_CMD_START : V4L2_DEC_CMD_START);
+
+	if (!is_stop && !is_start) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (try_only)
+		return 0;
+	if (is_stop) {
+		p->stopping = true;
+		try_stop(p);
+	} else {
+		p->stopping = false;
+		p->cap_q.last = false;
+	}
+	return 0;
+}
+
+/*
+ * All processing is done synchronously when buffers are queued. On a
+ * blocking fd wait for another thread to queue what is still missing, as
+ * long as a buffer is queued on this queue: otherwise nothing can ever
+ * complete, so fail right away.
+ */
+static int dqbuf(struct fwht_plugin *p, int fd, struct emu_queue *q,
+		 struct v4l2_buffer *b)
+{
+	if (!(fcntl(fd, F_GETFL) & O_NONBLOCK))
+		while (!q->done_cnt && emu_queue_peek(q))
+			pthread_cond_wait(&p->cond, &p->lock);
+	return emu_queue_dqbuf(q, b);
+}
+
+static int buf_ioctl(struct fwht_plugin *p, int fd, unsigned long cmd,
+		     struct v4l2_buffer *b)
+{
+	struct emu_queue *q = get_queue(p, b->type);
+	int ret;
+
+	if (!q) {
+		errno = EINVAL;
+		return -1;
+	}
+	switch (cmd) {
+	case VIDIOC_QUERYBUF:
+		return emu_queue_querybuf(q, b);
+	case VIDIOC_QBUF:
+		ret = emu_queue_qbuf(q, b);
+		if (!ret)
+			run_jobs(p);
+		return ret;
+	default:
+		return dqbuf(p, fd, q, b);
+	}
+}
+
+static int stream_ioctl(struct fwht_plugin *p, unsigned long cmd,
+			const int *type)
+{
+	struct emu_queue *q = get_queue(p, *type);
+
+	if (!q) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (cmd == VIDIOC_STREAMOFF) {
+		emu_queue_streamoff(q);
+		if (q == &p->out_q) {
+			p->stopping = false;
+			/* the next stream starts with an I frame */
+			free_ctx(p);
+		}
+		return 0;
+	}
+	if (emu_queue_streamon(q))
+		return -1;
+	run_jobs(p);
+	return 0;
+}
+
+static int event_ioctl(struct fwht_plugin *p, unsigned long cmd, void *arg)
+{
+	struct v4l2_event_subscription *sub = arg;
+	struct v4l2_event *ev = arg;
+
+	switch (cmd) {
+	case VIDIOC_SUBSCRIBE_EVENT:
+	case VIDIOC_UNSUBSCRIBE_EVENT:
+		/*
+		 * Source change events are not supported: the emulated
+		 * decoder cannot signal exceptions through poll(), so
+		 * applications have to set up the capture format themselves.
+		 */
+		if (sub->type != V4L2_EVENT_EOS &&
+		    sub->type != V4L2_EVENT_ALL) {
+			errno = EINVAL;
+			return -1;
+		}
+		p->eos_subscribed = cmd == VIDIOC_SUBSCRIBE_EVENT;
+		if (!p->eos_subscribed)
+			p->eos_pending = false;
+		return 0;
+	default:
+		if (!p->eos_pending) {
+			errno = ENOENT;
+			return -1;
+		}
+		memset(ev, 0, sizeof(*ev));
+		ev->type = V4L2_EVENT_EOS;
+		clock_gettime(CLOCK_MONOTONIC, &ev->timestamp);
+		p->eos_pending = false;
+		return 0;
+	}
+}
+
+static void *plugin_init(int fd)
+{
+	const char *mode = getenv("LIBV4L_EMU");
+	struct fwht_plugin *p;
+	struct v4l2_format fmt = {};
+	struct stat st;
+
+	/*
+	 * Only emulate on top of regular files, never on real devices. The
+	 * file becomes the backing store of the buffers, so it must be empty:
+	 * never touch the contents of a file the caller cares about.
+	 */
+	if (!mode || fstat(fd, &st) || !S_ISREG(st.st_mode) || st.st_size)
+		return NULL;
+	if (strcmp(mode, "fwht-enc") && strcmp(mode, "fwht-dec"))
+		return NULL;
+
+	p = calloc(1, sizeof(*p));
+	if (!p) {
+		perror("Couldn't allocate memory for plugin");
+		return NULL;
+	}
+	pthread_mutex_init(&p->lock, NULL);
+	pthread_cond_init(&p->cond, NULL);
+	p->file.fd = fd;
+	p->is_enc = !strcmp(mode, "fwht-enc");
+	emu_queue_init(&p->out_q, V4L2_BUF_TYPE_VIDEO_OUTPUT,
+		       V4L2_BUF_FLAG_TIMESTAMP_COPY);
+	emu_queue_init(&p->cap_q, V4L2_BUF_TYPE_VIDEO_CAPTURE,
+		       V4L2_BUF_FLAG_TIMESTAMP_COPY);
+
+	fmt.type = p->is_enc ? V4L2_BUF_TYPE_VIDEO_OUTPUT :
+			       V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	fmt.fmt.pix.width = 1280;
+	fmt.fmt.pix.height = 720;
+	fmt.fmt.pix.pixelformat = V4L2_PIX_FMT_YUV420;
+	s_fmt(p, &fmt);
+
+	return p;
+}
+
+static void plugin_close(void *dev_ops_priv)
+{
+	struct fwht_plugin *p = dev_ops_priv;
+
+	if (p == NULL)
+		return;
+
+	emu_queue_free(&p->file, &p->cap_q);
+	emu_queue_free(&p->file, &p->out_q);
+	/* The file was empty when claimed: leave it so it can be reused */
+	if (p->file.size && ftruncate(p->file.fd, 0))
+		perror("Couldn't truncate emulation file");
+	free_ctx(p);
+	pthread_cond_destroy(&p->cond);
+	pthread_mutex_destroy(&p->lock);
+	free(p);
+}
+
+static int querycap(struct fwht_plugin *p, struct v4l2_capability *cap)
+{
+	memset(cap, 0, sizeof(*cap));
+	strcpy((char *)cap->driver, "libv4l-emu");
+	snprintf((char *)cap->card, sizeof(cap->card), "FWHT %s (emulated)",
+		 p->is_enc ? "encoder" : "decoder");
+	strcpy((char *)cap->bus_info, "platform:libv4l-emu");
+	cap->version = LINUX_VERSION_CODE;
+	cap->device_caps = V4L2_CAP_VIDEO_M2M | V4L2_CAP_STREAMING |
+			   V4L2_CAP_EXT_PIX_FORMAT;
+	cap->capabilities = cap->device_caps | V4L2_CAP_DEVICE_CAPS;
+	return 0;
+}
+
+static int do_ioctl(struct fwht_plugin *p, int fd, unsigned long int cmd,
+		    void *arg)
+{
+	switch (cmd) {
+	case VIDIOC_QUERYCAP:
+		return querycap(p, arg);
+	case VIDIOC_ENUM_FMT:
+		return enum_fmt(p, arg);
+	case VIDIOC_ENUM_FRAMESIZES:
+		return enum_framesizes(arg);
+	case VIDIOC_G_FMT: {
+		struct v4l2_format *f = arg;
+		struct v4l2_pix_format *pix = get_fmt(p, f->type);
+
+		if (!pix) {
+			errno = EINVAL;
+			return -1;
+		}
+		f->fmt.pix = *pix;
+		return 0;
+	}
+	case VIDIOC_TRY_FMT:
+		return try_fmt(p, arg);
+	case VIDIOC_S_FMT:
+		return s_fmt(p, arg);
+	case VIDIOC_REQBUFS: {
+		struct v4l2_requestbuffers *req = arg;
+		struct emu_queue *q = get_queue(p, req->type);
+
+		if (!q) {
+			errno = EINVAL;
+			return -1;
+		}
+		return emu_queue_reqbufs(&p->file, q, req,
+					 get_fmt(p, req->type)->sizeimage);
+	}
+	case VIDIOC_QUERYBUF:
+	case VIDIOC_QBUF:
+	case VIDIOC_DQBUF:
+		return buf_ioctl(p, fd, cmd, arg);
+	case VIDIOC_STREAMON:
+	case VIDIOC_STREAMOFF:
+		return stream_ioctl(p, cmd, arg);
+	case VIDIOC_ENCODER_CMD:
+	case VIDIOC_TRY_ENCODER_CMD:
+		if (!p->is_enc)
+			break;
+		return codec_cmd(p, &((struct v4l2_encoder_cmd *)arg)->cmd,
+				 cmd == VIDIOC_TRY_ENCODER_CMD);
+	case VIDIOC_DECODER_CMD:
+	case VIDIOC_TRY_DECODER_CMD:
+		if (p->is_enc)
+			break;
+		return codec_cmd(p, &((struct v4l2_decoder_cmd *)arg)->cmd,
+				 cmd == VIDIOC_TRY_DECODER_CMD);
+	case VIDIOC_SUBSCRIBE_EVENT:
+	case VIDIOC_UNSUBSCRIBE_EVENT:
+	case VIDIOC_DQEVENT:
+		return event_ioctl(p, cmd, arg);
+	}
+	errno = ENOTTY;
+	return -1;
+}
+
+static int plugin_ioctl(void *dev_ops_priv, int fd, unsigned long int cmd,
+			void *arg)
+{
+	struct fwht_plugin *p = dev_ops_priv;
+	int ret;
+
+	pthread_mutex_lock(&p->lock);
+	ret = do_ioctl(p, fd, cmd, arg);
+	pthread_cond_broadcast(&p->cond);
+	pthread_mutex_unlock(&p->lock);
+	return ret;
+}
+
+/* The file only holds buffer memory, there is no read/write I/O */
+static ssize_t plugin_read(void *dev_ops_priv, int fd, void *buf, size_t len)
+{
+	errno = EINVAL;
+	return -1;
+}
+
+static ssize_t plugin_write(void *dev_ops_priv, int fd, const void *buf,
+			    size_t len)
+{
+	errno = EINVAL;
+	return -1;
+}
+
+PLUGIN_PUBLIC const struct libv4l_dev_ops libv4l2_plugin = {
+	.init = &plugin_init,
+	.close = &plugin_close,
+	.ioctl = &plugin_ioctl,
+	.read = &plugin_read,
+	.write = &plugin_write,
+};
@@ -0,0 +1 @@
+../../utils/common/v4l-stream.c
\ No newline at end of file
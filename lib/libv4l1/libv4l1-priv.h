@@ -72,6 +72,10 @@ struct v4l1_dev_info {
 	unsigned int min_width, min_height, max_width, max_height;
 	unsigned int width, height;
 	unsigned char *v4l1_frame_pointer;
+	/* libv4l2 buffers mapped over v4l1_frame_pointer, see v4l1_map_frames */
+	unsigned int v4l1_frames_mapped;
+	unsigned int v4l1_frames_queued; /* bitmask */
+	unsigned int v4l1_frames_done;   /* bitmask, dequeued before VIDIOCSYNC */
 };
 
 /* From log.c */
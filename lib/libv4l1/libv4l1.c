@@ -71,6 +71,8 @@
 #define V4L1_SUPPORTS_ENUMSTD   0x02
 #define V4L1_PIX_FMT_TOUCHED    0x04
 #define V4L1_PIX_SIZE_TOUCHED   0x08
+#define V4L1_NO_ZERO_COPY       0x10
+#define V4L1_STREAMING          0x20
 
 static pthread_mutex_t v4l1_open_mutex = PTHREAD_MUTEX_INITIALIZER;
 static struct v4l1_dev_info devices[V4L1_MAX_DEVICES] = {
@@ -159,6 +161,162 @@ static int count_inputs(int fd)
 	return i;
 }
 
+/* Give the frames mapped by v4l1_map_frames back to libv4l2, and put
+   anonymous memory in their place */
+static void v4l1_unmap_frames(int index)
+{
+	enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	struct v4l2_requestbuffers req = {
+		.count = 0,
+		.type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+		.memory = V4L2_MEMORY_MMAP,
+	};
+	void *p;
+
+	if (devices[index].flags & V4L1_STREAMING)
+		v4l2_ioctl(devices[index].fd, VIDIOC_STREAMOFF, &type);
+
+	if (devices[index].v4l1_frames_mapped) {
+		p = (void *)SYS_MMAP(devices[index].v4l1_frame_pointer,
+				V4L1_NO_FRAMES * V4L1_FRAME_BUF_SIZE,
+				PROT_READ | PROT_WRITE,
+				MAP_ANONYMOUS | MAP_PRIVATE | MAP_FIXED, -1, 0);
+		if (p == MAP_FAILED)
+			V4L1_LOG_ERR("restoring v4l1 buffer: %s\n", strerror(errno));
+	}
+
+	v4l2_ioctl(devices[index].fd, VIDIOC_REQBUFS, &req);
+
+	devices[index].flags &= ~V4L1_STREAMING;
+	devices[index].v4l1_frames_mapped = 0;
+	devices[index].v4l1_frames_queued = 0;
+	devices[index].v4l1_frames_done = 0;
+}
+
+/* Query the libv4l2 buffer for a frame. Returns 0 if it is the driver's
+   own buffer: libv4l2 hands out the driver's buffer offsets when it is not
+   converting, which is what we check. */
+static int v4l1_query_frame(int index, int frame, struct v4l2_buffer *buf)
+{
+	struct v4l2_buffer kbuf = {
+		.index = frame,
+		.type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+		.memory = V4L2_MEMORY_MMAP,
+	};
+
+	*buf = kbuf;
+	if (v4l2_ioctl(devices[index].fd, VIDIOC_QUERYBUF, buf) ||
+	    SYS_IOCTL(devices[index].fd, VIDIOC_QUERYBUF, &kbuf) ||
+	    buf->m.offset != kbuf.m.offset)
+		return -1;
+	return 0;
+}
+
+/* When libv4l2 does not need to convert the frames, map its (the driver's)
+   buffers straight over the v4l1 frame buffer, so that the frames are
+   captured into the memory the application reads them from, instead of
+   being copied there on VIDIOCSYNC. */
+static int v4l1_map_frames(int index)
+{
+	int fd = devices[index].fd;
+	struct v4l2_requestbuffers req = {
+		.count = V4L1_NO_FRAMES,
+		.type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+		.memory = V4L2_MEMORY_MMAP,
+	};
+	unsigned int i;
+	void *p;
+
+	if (v4l2_ioctl(fd, VIDIOC_REQBUFS, &req) || req.count < V4L1_NO_FRAMES)
+		goto fail;
+
+	for (i = 0; i < V4L1_NO_FRAMES; i++) {
+		struct v4l2_buffer buf;
+
+		if (v4l1_query_frame(index, i, &buf) ||
+		    buf.length > V4L1_FRAME_BUF_SIZE)
+			goto fail;
+
+		p = (void *)SYS_MMAP(devices[index].v4l1_frame_pointer +
+				i * V4L1_FRAME_BUF_SIZE, buf.length,
+				PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+				fd, buf.m.offset);
+		if (p == MAP_FAILED)
+			goto fail;
+		devices[index].v4l1_frames_mapped = i + 1;
+	}
+
+	V4L1_LOG("mapped %d driver buffers in the v4l1 buffer\n", V4L1_NO_FRAMES);
+	return 0;
+
+fail:
+	V4L1_LOG("using copies for the v4l1 buffer\n");
+	v4l1_unmap_frames(index);
+	devices[index].flags |= V4L1_NO_ZERO_COPY;
+	return -1;
+}
+
+static int v4l1_queue_frame(int index, int frame)
+{
+	struct v4l2_buffer buf = {
+		.index = frame,
+		.type = V4L2_BUF_TYPE_VIDEO_CAPTURE,
+		.memory = V4L2_MEMORY_MMAP,
+	};
+	enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	int result;
+
+	if (devices[index].v4l1_frames_queued & (1 << frame))
+		return 0;
+
+	devices[index].v4l1_frames_done &= ~(1 << frame);
+	result = v4l2_ioctl(devices[index].fd, VIDIOC_QBUF, &buf);
+	if (result)
+		return result;
+	devices[index].v4l1_frames_queued |= 1 << frame;
+
+	if (!(devices[index].flags & V4L1_STREAMING)) {
+		result = v4l2_ioctl(devices[index].fd, VIDIOC_STREAMON, &type);
+		if (result)
+			return result;
+		devices[index].flags |= V4L1_STREAMING;
+	}
+
+	return 0;
+}
+
+/* Dequeue buffers until the frame has been captured */
+static int v4l1_sync_frame(int index, int frame)
+{
+	struct v4l2_buffer buf;
+	int result;
+
+	if (devices[index].v4l1_frames_done & (1 << frame)) {
+		devices[index].v4l1_frames_done &= ~(1 << frame);
+		return 0;
+	}
+
+	/* Like the copying emulation, allow a VIDIOCSYNC without VIDIOCMCAPTURE */
+	result = v4l1_queue_frame(index, frame);
+	if (result)
+		return result;
+
+	do {
+		memset(&buf, 0, sizeof(buf));
+		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		buf.memory = V4L2_MEMORY_MMAP;
+		result = v4l2_ioctl(devices[index].fd, VIDIOC_DQBUF, &buf);
+		if (result)
+			return result;
+
+		devices[index].v4l1_frames_queued &= ~(1 << buf.index);
+		if ((int)buf.index != frame)
+			devices[index].v4l1_frames_done |= 1 << buf.index;
+	} while ((int)buf.index != frame);
+
+	return 0;
+}
+
 static int v4l1_set_format(int index, unsigned int width,
 		unsigned int height, int v4l1_pal, int width_height_may_differ)
 {
@@ -223,6 +381,12 @@ static int v4l1_set_format(int index, unsigned int width,
 		return 0;
 	}
 
+	/* The mapped frames have the old format, and they keep the driver
+	   from changing it */
+	if (devices[index].v4l1_frames_mapped)
+		v4l1_unmap_frames(index);
+	devices[index].flags &= ~V4L1_NO_ZERO_COPY;
+
 	result = v4l2_ioctl(devices[index].fd, VIDIOC_S_FMT, &fmt2);
 	if (result) {
 		int saved_err = errno;
@@ -769,12 +933,37 @@ int v4l1_ioctl(int fd, unsigned long int request, ...)
 
 	case VIDIOCMCAPTURE: {
 		struct video_mmap *map = arg;
+		struct v4l2_buffer buf;
 
 		devices[index].flags |= V4L1_PIX_FMT_TOUCHED |
 			V4L1_PIX_SIZE_TOUCHED;
 
 		result = v4l1_set_format(index, map->width, map->height,
 				map->format, 0);
+		if (result || devices[index].v4l1_frame_pointer == MAP_FAILED)
+			break;
+
+		if (map->frame >= V4L1_NO_FRAMES) {
+			errno = EINVAL;
+			result = -1;
+			break;
+		}
+
+		/* libv4l2 may have started converting since the frames were
+		   mapped, e.g. because a software control was enabled */
+		if (devices[index].v4l1_frames_mapped &&
+				v4l1_query_frame(index, map->frame, &buf)) {
+			V4L1_LOG("libv4l2 converts now, using copies for the v4l1 buffer\n");
+			v4l1_unmap_frames(index);
+			devices[index].flags |= V4L1_NO_ZERO_COPY;
+		}
+
+		if (!devices[index].v4l1_frames_mapped &&
+				!(devices[index].flags & V4L1_NO_ZERO_COPY))
+			v4l1_map_frames(index);
+
+		if (devices[index].v4l1_frames_mapped)
+			result = v4l1_queue_frame(index, map->frame);
 		break;
 	}
 
@@ -788,6 +977,11 @@ int v4l1_ioctl(int fd, unsigned long int request, ...)
 			break;
 		}
 
+		if (devices[index].v4l1_frames_mapped) {
+			result = v4l1_sync_frame(index, *frame_index);
+			break;
+		}
+
 		result = v4l2_read(devices[index].fd,
 				devices[index].v4l1_frame_pointer +
 				*frame_index * V4L1_FRAME_BUF_SIZE,
@@ -1195,16 +1389,12 @@ int v4l1_ioctl(int fd, unsigned long int request, ...)
 ssize_t v4l1_read(int fd, void *buffer, size_t n)
 {
 	int index = v4l1_get_index(fd);
-	ssize_t result;
 
 	if (index == -1)
 		return SYS_READ(fd, buffer, n);
 
-	pthread_mutex_lock(&devices[index].stream_lock);
-	result = v4l2_read(fd, buffer, n);
-	pthread_mutex_unlock(&devices[index].stream_lock);
-
-	return result;
+	/* libv4l2 serializes the read with its own stream lock */
+	return v4l2_read(fd, buffer, n);
 }
 
 
@@ -73,6 +73,7 @@
 #include "libv4l2.h"
 #include "libv4l2-priv.h"
 #include "libv4l-plugin.h"
+#include "usdt.h"
 
 /* Note these flags are stored together with the flags passed to v4l2_fd_open()
    in v4l2_dev_info's flags member, so care should be taken that the do not
@@ -311,7 +312,7 @@ static int v4l2_queue_read_buffer(int index, int buffer_index)
 	return 0;
 }
 
-static int v4l2_dequeue_and_convert(int index, struct v4l2_buffer *buf,
+static int __v4l2_dequeue_and_convert(int index, struct v4l2_buffer *buf,
 		unsigned char *dest, int dest_size)
 {
 	const int max_tries = V4L2_IGNORE_FIRST_FRAME_ERRORS + 1;
@@ -400,6 +401,18 @@ static int v4l2_dequeue_and_convert(int index, struct v4l2_buffer *buf,
 	return result;
 }
 
+static int v4l2_dequeue_and_convert(int index, struct v4l2_buffer *buf,
+		unsigned char *dest, int dest_size)
+{
+	int result;
+
+	USDT(libv4l2, dequeue_convert_entry, devices[index].fd, dest_size);
+	result = __v4l2_dequeue_and_convert(index, buf, dest, dest_size);
+	USDT(libv4l2, dequeue_convert_exit, devices[index].fd, result,
+	     buf->index, buf->bytesused);
+	return result;
+}
+
 static int v4l2_read_and_convert(int index, unsigned char *dest, int dest_size)
 {
 	const int max_tries = V4L2_IGNORE_FIRST_FRAME_ERRORS + 1;
@@ -51,6 +51,8 @@
 #define V4LCONVERT_IS_UVC                0x01
 #define V4LCONVERT_USE_TINYJPEG          0x02
 
+struct v4lconvert_caps;
+
 struct v4lconvert_data {
 	int fd;
 	int flags; /* bitfield */
@@ -70,6 +72,12 @@ struct v4lconvert_data {
 	/* Bitmask of all supported src_formats which can do for a size */
 	int64_t framesize_supported_src_formats[V4LCONVERT_MAX_FRAMESIZES];
 	unsigned int no_framesizes;
+	int framesizes_probed;
+	/* Supported src formats, as supported_src_pixfmts indexes in the
+	   order of VIDIOC_ENUM_FMT; their framesizes are probed on first use */
+	unsigned char src_formats[128];
+	unsigned int no_src_formats;
+	struct v4lconvert_caps *caps;
 	int bandwidth;
 	int fps;
 	int convert1_buf_size;
@@ -22,6 +22,7 @@
 #include <config.h>
 #endif
 #include <errno.h>
+#include <pthread.h>
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -30,6 +31,7 @@
 #include "libv4lconvert.h"
 #include "libv4lconvert-priv.h"
 #include "libv4lsyscall-priv.h"
+#include "usdt.h"
 
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
 #define BIT_MASK(nr) (1UL << ((nr) % BITS_PER_LONG))
@@ -209,6 +211,190 @@ static const int v4lconvert_crop_res[][2] = {
 	{ 176, 144 },
 };
 
+/* The formats and framesizes a device enumerates are the same for every open,
+   so they are kept in a process-wide cache, keyed by the device node, its
+   identity as reported by VIDIOC_QUERYCAP and the current input (framesizes
+   may depend on it). Entries are never freed, there is one per device and
+   input ever opened. */
+struct v4lconvert_caps {
+	dev_t rdev;
+	int input;
+	struct v4l2_capability cap;
+
+	unsigned int no_formats;
+	unsigned long supported_src_formats[128 / BITS_PER_LONG];
+	unsigned char src_formats[128];
+	unsigned int no_src_formats;
+	int always_needs_conversion;
+
+	int framesizes_probed;
+	struct v4l2_frmsizeenum framesizes[V4LCONVERT_MAX_FRAMESIZES];
+	int64_t framesize_supported_src_formats[V4LCONVERT_MAX_FRAMESIZES];
+	unsigned int no_framesizes;
+
+	struct v4lconvert_caps *next;
+};
+
+static pthread_mutex_t v4lconvert_caps_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct v4lconvert_caps *v4lconvert_caps_cache;
+
+static struct v4lconvert_caps *v4lconvert_find_caps(const struct v4lconvert_caps *key)
+{
+	struct v4lconvert_caps *caps;
+
+	for (caps = v4lconvert_caps_cache; caps; caps = caps->next)
+		if (caps->rdev == key->rdev && caps->input == key->input &&
+		    !memcmp(&caps->cap, &key->cap, sizeof(key->cap)))
+			return caps;
+	return NULL;
+}
+
+/* Enumerate the formats of the device, or get them from the cache. Returns
+   whether the device only has formats which need conversion. */
+static int v4lconvert_get_formats(struct v4lconvert_data *data,
+		struct v4l2_capability *cap, int have_cap)
+{
+	struct v4lconvert_caps key = { .input = -1 }, *caps = NULL;
+	struct stat st;
+	int i, j, always_needs_conversion = 1;
+	int cacheable = have_cap && !fstat(data->fd, &st);
+
+	if (cacheable) {
+		key.rdev = st.st_rdev;
+		key.cap = *cap;
+		data->dev_ops->ioctl(data->dev_ops_priv, data->fd,
+				VIDIOC_G_INPUT, &key.input);
+
+		pthread_mutex_lock(&v4lconvert_caps_mutex);
+		caps = v4lconvert_find_caps(&key);
+		if (caps) {
+			data->no_formats = caps->no_formats;
+			memcpy(data->supported_src_formats, caps->supported_src_formats,
+					sizeof(data->supported_src_formats));
+			memcpy(data->src_formats, caps->src_formats,
+					sizeof(data->src_formats));
+			data->no_src_formats = caps->no_src_formats;
+			always_needs_conversion = caps->always_needs_conversion;
+			data->caps = caps;
+		}
+		pthread_mutex_unlock(&v4lconvert_caps_mutex);
+		if (caps)
+			return always_needs_conversion;
+	}
+
+	for (i = 0; ; i++) {
+		struct v4l2_fmtdesc fmt = { .type = V4L2_BUF_TYPE_VIDEO_CAPTURE };
+
+		fmt.index = i;
+
+		if (data->dev_ops->ioctl(data->dev_ops_priv, data->fd,
+				VIDIOC_ENUM_FMT, &fmt))
+			break;
+
+		for (j = 0; j < ARRAY_SIZE(supported_src_pixfmts); j++)
+			if (fmt.pixelformat == supported_src_pixfmts[j].fmt)
+				break;
+
+		if (j < ARRAY_SIZE(supported_src_pixfmts)) {
+			if (!test_bit(j, data->supported_src_formats))
+				data->src_formats[data->no_src_formats++] = j;
+			set_bit(j, data->supported_src_formats);
+			if (!supported_src_pixfmts[j].needs_conversion)
+				always_needs_conversion = 0;
+		} else
+			always_needs_conversion = 0;
+	}
+
+	data->no_formats = i;
+
+	if (!cacheable)
+		return always_needs_conversion;
+
+	caps = calloc(1, sizeof(*caps));
+	if (!caps)
+		return always_needs_conversion;
+
+	*caps = key;
+	caps->no_formats = data->no_formats;
+	memcpy(caps->supported_src_formats, data->supported_src_formats,
+			sizeof(data->supported_src_formats));
+	memcpy(caps->src_formats, data->src_formats, sizeof(data->src_formats));
+	caps->no_src_formats = data->no_src_formats;
+	caps->always_needs_conversion = always_needs_conversion;
+
+	pthread_mutex_lock(&v4lconvert_caps_mutex);
+	/* Someone else may have opened the same device meanwhile */
+	data->caps = v4lconvert_find_caps(&key);
+	if (!data->caps) {
+		caps->next = v4lconvert_caps_cache;
+		v4lconvert_caps_cache = caps;
+		data->caps = caps;
+		caps = NULL;
+	}
+	pthread_mutex_unlock(&v4lconvert_caps_mutex);
+	free(caps);
+
+	return always_needs_conversion;
+}
+
+/* Enumerating the framesizes takes many ioctls, and on UVC cams every one
+   of them causes I/O, so this is only done when they are needed, and once
+   per device. */
+static void v4lconvert_probe_framesizes(struct v4lconvert_data *data)
+{
+	struct v4lconvert_caps *caps = data->caps;
+	unsigned int i;
+	int input = -1, cached = 0;
+
+	if (data->framesizes_probed)
+		return;
+	data->framesizes_probed = 1;
+
+	/* The application may have switched inputs since the open, the cache
+	   entry only holds the framesizes of the input current back then */
+	if (caps) {
+		data->dev_ops->ioctl(data->dev_ops_priv, data->fd,
+				VIDIOC_G_INPUT, &input);
+		if (input != caps->input)
+			caps = NULL;
+	}
+
+	if (caps) {
+		pthread_mutex_lock(&v4lconvert_caps_mutex);
+		if (caps->framesizes_probed) {
+			memcpy(data->framesizes, caps->framesizes,
+					sizeof(data->framesizes));
+			memcpy(data->framesize_supported_src_formats,
+					caps->framesize_supported_src_formats,
+					sizeof(data->framesize_supported_src_formats));
+			data->no_framesizes = caps->no_framesizes;
+			cached = 1;
+		}
+		pthread_mutex_unlock(&v4lconvert_caps_mutex);
+		if (cached)
+			return;
+	}
+
+	for (i = 0; i < data->no_src_formats; i++)
+		v4lconvert_get_framesizes(data,
+				supported_src_pixfmts[data->src_formats[i]].fmt,
+				data->src_formats[i]);
+
+	if (caps) {
+		pthread_mutex_lock(&v4lconvert_caps_mutex);
+		if (!caps->framesizes_probed) {
+			memcpy(caps->framesizes, data->framesizes,
+					sizeof(data->framesizes));
+			memcpy(caps->framesize_supported_src_formats,
+					data->framesize_supported_src_formats,
+					sizeof(data->framesize_supported_src_formats));
+			caps->no_framesizes = data->no_framesizes;
+			caps->framesizes_probed = 1;
+		}
+		pthread_mutex_unlock(&v4lconvert_caps_mutex);
+	}
+}
+
 struct v4lconvert_data *v4lconvert_create(int fd)
 {
 	return v4lconvert_create_with_dev_ops(fd, NULL, &default_dev_ops); 
@@ -217,9 +403,9 @@ struct v4lconvert_data *v4lconvert_create(int fd)
 struct v4lconvert_data *v4lconvert_create_with_dev_ops(int fd, void *dev_ops_priv,
 		const struct libv4l_dev_ops *dev_ops)
 {
-	int i, j;
 	struct v4lconvert_data *data = calloc(1, sizeof(struct v4lconvert_data));
 	struct v4l2_capability cap;
+	int have_cap;
 	/*
 	 * This keeps tracks of device-specific formats for which apps most
 	 * likely don't know. If all a driver can offer are proprietary
@@ -227,7 +413,7 @@ struct v4lconvert_data *v4lconvert_create_with_dev_ops(int fd, void *dev_ops_pri
 	 * add software processing controls without much concern about a
 	 * performance impact.
 	 */
-	int always_needs_conversion = 1;
+	int always_needs_conversion;
 
 	if (!data) {
 		fprintf(stderr, "libv4lconvert: error: out of memory!\n");
@@ -240,34 +426,14 @@ struct v4lconvert_data *v4lconvert_create_with_dev_ops(int fd, void *dev_ops_pri
 	data->decompress_pid = -1;
 	data->fps = 30;
 
-	/* Check supported formats */
-	for (i = 0; ; i++) {
-		struct v4l2_fmtdesc fmt = { .type = V4L2_BUF_TYPE_VIDEO_CAPTURE };
-
-		fmt.index = i;
-
-		if (data->dev_ops->ioctl(data->dev_ops_priv, data->fd,
-				VIDIOC_ENUM_FMT, &fmt))
-			break;
-
-		for (j = 0; j < ARRAY_SIZE(supported_src_pixfmts); j++)
-			if (fmt.pixelformat == supported_src_pixfmts[j].fmt)
-				break;
+	have_cap = data->dev_ops->ioctl(data->dev_ops_priv, data->fd,
+			VIDIOC_QUERYCAP, &cap) == 0;
 
-		if (j < ARRAY_SIZE(supported_src_pixfmts)) {
-			set_bit(j, data->supported_src_formats);
-			v4lconvert_get_framesizes(data, fmt.pixelformat, j);
-			if (!supported_src_pixfmts[j].needs_conversion)
-				always_needs_conversion = 0;
-		} else
-			always_needs_conversion = 0;
-	}
-
-	data->no_formats = i;
+	/* Check supported formats */
+	always_needs_conversion = v4lconvert_get_formats(data, &cap, have_cap);
 
 	/* Check if this cam has any special flags */
-	if (data->dev_ops->ioctl(data->dev_ops_priv, data->fd,
-			VIDIOC_QUERYCAP, &cap) == 0) {
+	if (have_cap) {
 		if (!strcmp((char *)cap.driver, "uvcvideo"))
 			data->flags |= V4LCONVERT_IS_UVC;
 
@@ -516,8 +682,10 @@ static int v4lconvert_do_try_format(struct v4lconvert_data *data,
 	unsigned int desired_pixfmt = dest_fmt->fmt.pix.pixelformat;
 	struct v4l2_format try_fmt, closest_fmt = { .type = 0 };
 
-	if (data->flags & V4LCONVERT_IS_UVC)
+	if (data->flags & V4LCONVERT_IS_UVC) {
+		v4lconvert_probe_framesizes(data);
 		return v4lconvert_do_try_format_uvc(data, dest_fmt, src_fmt);
+	}
 
 	for (i = 0; i < ARRAY_SIZE(supported_src_pixfmts); i++) {
 		/* is this format supported? */
@@ -1728,24 +1896,34 @@ int v4lconvert_convert(struct v4lconvert_data *data,
 	/* Done setting sources / dest and allocating intermediate buffers,
 	   real conversion / processing / ... starts here. */
 	if (convert == 2) {
+		USDT(libv4lconvert, stage_start, "convert",
+		     my_src_fmt.fmt.pix.pixelformat, V4L2_PIX_FMT_RGB24);
 		res = v4lconvert_convert_pixfmt(data, src, src_size,
 				convert1_dest, convert1_dest_size,
 				&my_src_fmt,
 				V4L2_PIX_FMT_RGB24);
+		USDT(libv4lconvert, stage_end, "convert", res);
 		if (res)
 			return res;
 
 		src_size = my_src_fmt.fmt.pix.sizeimage;
 	}
 
-	if (processing)
+	if (processing) {
+		USDT(libv4lconvert, stage_start, "processing",
+		     my_src_fmt.fmt.pix.pixelformat, my_src_fmt.fmt.pix.pixelformat);
 		v4lprocessing_processing(data->processing, convert2_src, &my_src_fmt);
+		USDT(libv4lconvert, stage_end, "processing", 0);
+	}
 
 	if (convert) {
+		USDT(libv4lconvert, stage_start, "convert",
+		     my_src_fmt.fmt.pix.pixelformat, my_dest_fmt.fmt.pix.pixelformat);
 		res = v4lconvert_convert_pixfmt(data, convert2_src, src_size,
 				convert2_dest, convert2_dest_size,
 				&my_src_fmt,
 				my_dest_fmt.fmt.pix.pixelformat);
+		USDT(libv4lconvert, stage_end, "convert", res);
 		if (res)
 			return res;
 
@@ -1754,18 +1932,35 @@ int v4lconvert_convert(struct v4lconvert_data *data,
 		/* We call processing here again in case the source format was not
 		   rgb, but the dest is. v4lprocessing checks it self it only actually
 		   does the processing once per frame. */
-		if (processing)
+		if (processing) {
+			USDT(libv4lconvert, stage_start, "processing",
+			     my_src_fmt.fmt.pix.pixelformat,
+			     my_src_fmt.fmt.pix.pixelformat);
 			v4lprocessing_processing(data->processing, convert2_dest, &my_src_fmt);
+			USDT(libv4lconvert, stage_end, "processing", 0);
+		}
 	}
 
-	if (rotate90)
+	if (rotate90) {
+		USDT(libv4lconvert, stage_start, "rotate90",
+		     my_src_fmt.fmt.pix.pixelformat, my_src_fmt.fmt.pix.pixelformat);
 		v4lconvert_rotate90(rotate90_src, rotate90_dest, &my_src_fmt);
+		USDT(libv4lconvert, stage_end, "rotate90", 0);
+	}
 
-	if (hflip || vflip)
+	if (hflip || vflip) {
+		USDT(libv4lconvert, stage_start, "flip",
+		     my_src_fmt.fmt.pix.pixelformat, my_src_fmt.fmt.pix.pixelformat);
 		v4lconvert_flip(flip_src, flip_dest, &my_src_fmt, hflip, vflip);
+		USDT(libv4lconvert, stage_end, "flip", 0);
+	}
 
-	if (crop)
+	if (crop) {
+		USDT(libv4lconvert, stage_start, "crop",
+		     my_src_fmt.fmt.pix.pixelformat, my_dest_fmt.fmt.pix.pixelformat);
 		v4lconvert_crop(crop_src, dest, &my_src_fmt, &my_dest_fmt);
+		USDT(libv4lconvert, stage_end, "crop", 0);
+	}
 
 	return dest_needed;
 }
@@ -1846,6 +2041,7 @@ int v4lconvert_enum_framesizes(struct v4lconvert_data *data,
 				VIDIOC_ENUM_FRAMESIZES, frmsize);
 	}
 
+	v4lconvert_probe_framesizes(data);
 	if (frmsize->index >= data->no_framesizes) {
 		errno = EINVAL;
 		return -1;
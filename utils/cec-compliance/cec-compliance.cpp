@@ -7,6 +7,7 @@
 
 #include <fcntl.h>
 #include <getopt.h>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <sys/time.h>
 #include <unistd.h>
@@ -85,6 +86,7 @@ enum Option {
 	OptSkipTestVendorSpecificCommands,
 	OptSkipTestStandbyResume,
 
+	OptShowTiming,
 	OptVersion,
 	OptLast = 256
 };
@@ -100,6 +102,7 @@ bool show_colors;
 bool show_warnings = true;
 bool exit_on_fail;
 bool exit_on_warn;
+bool show_timing;
 unsigned warnings;
 unsigned reply_threshold = 1000;
 time_t long_timeout = 60;
@@ -124,6 +127,7 @@ static struct option long_options[] = {
 	{"wall-clock", no_argument, nullptr, OptWallClock},
 	{"interactive", no_argument, nullptr, OptInteractive},
 	{"reply-threshold", required_argument, nullptr, OptReplyThreshold},
+	{"show-timing", no_argument, nullptr, OptShowTiming},
 
 	{"test-adapter", no_argument, nullptr, OptTestAdapter},
 	{"test-fuzzing", no_argument, nullptr, OptTestFuzzing},
@@ -226,6 +230,7 @@ static void usage()
 	       "                     <when> can be set to always, never, or auto (the default)\n"
 	       "  -N, --no-warnings  Turn off warning messages\n"
 	       "  -s, --skip-info    Skip Driver Info output\n"
+	       "  --show-timing      Show how long each remote test took (other tests are not timed)\n"
 	       "  -T, --trace        Trace all called ioctls\n"
 	       "  -v, --verbose      Turn on verbose reporting\n"
 	       "  --version          Show version information\n"
@@ -681,6 +686,40 @@ retry:
 	return true;
 }
 
+/*
+ * Wait until a message or transmit result can be dequeued, or until
+ * timeout ms have passed. Returns false on timeout.
+ */
+bool wait_for_msg(struct node *node, unsigned timeout)
+{
+	struct pollfd pfd = { node->fd, POLLIN, 0 };
+
+	return poll(&pfd, 1, timeout) > 0 && (pfd.revents & POLLIN);
+}
+
+/*
+ * Wait for a CEC_EVENT_STATE_CHANGE event, or until timeout ms have
+ * passed. Other events are discarded. Returns false on timeout.
+ */
+bool wait_for_state_change(struct node *node, unsigned timeout)
+{
+	unsigned ts_start = get_ts_ms();
+	unsigned elapsed;
+
+	while ((elapsed = get_ts_ms() - ts_start) < timeout) {
+		struct pollfd pfd = { node->fd, POLLPRI, 0 };
+		struct cec_event ev;
+
+		if (poll(&pfd, 1, timeout - elapsed) <= 0 ||
+		    !(pfd.revents & POLLPRI))
+			return false;
+		if (!doioctl(node, CEC_DQEVENT, &ev) &&
+		    ev.event == CEC_EVENT_STATE_CHANGE)
+			return true;
+	}
+	return false;
+}
+
 int util_receive(struct node *node, unsigned la, unsigned timeout,
 		 struct cec_msg *msg, __u8 sent_msg, __u8 reply1, __u8 reply2)
 {
@@ -1007,6 +1046,9 @@ int main(int argc, char **argv)
 		case OptVerbose:
 			show_info = true;
 			break;
+		case OptShowTiming:
+			show_timing = true;
+			break;
 		case OptVersion:
 			printf("cec-compliance %s%s\n",
 			       PACKAGE_VERSION, STRING(GIT_COMMIT_CNT));
@@ -1172,15 +1214,16 @@ int main(int argc, char **argv)
 		cec_msg_image_view_on(&msg);
 		fail_on_test(doioctl(&node, CEC_TRANSMIT, &msg));
 		if (msg.tx_status & CEC_TX_STATUS_OK) {
-			time_t cnt = 0;
+			time_t t = time(nullptr);
 
-			while (cnt++ <= long_timeout) {
+			while (time(nullptr) - t <= long_timeout) {
 				fail_on_test(doioctl(&node, CEC_ADAP_G_PHYS_ADDR, &node.phys_addr));
 				if (node.phys_addr != CEC_PHYS_ADDR_INVALID) {
 					doioctl(&node, CEC_ADAP_G_LOG_ADDRS, &laddrs);
 					break;
 				}
-				sleep(1);
+				// A new physical address is reported as a state change
+				wait_for_state_change(&node, 1000);
 			}
 		}
 
@@ -113,6 +113,7 @@ extern bool show_colors;
 extern bool show_warnings;
 extern bool exit_on_fail;
 extern bool exit_on_warn;
+extern bool show_timing;
 extern unsigned warnings;
 extern unsigned reply_threshold;
 extern time_t long_timeout;
@@ -427,6 +428,8 @@ int check_0(const void *p, int len);
 int util_receive(struct node *node, unsigned la, unsigned timeout,
 		 struct cec_msg *msg, __u8 sent_msg,
 		 __u8 reply1, __u8 reply2 = 0);
+bool wait_for_msg(struct node *node, unsigned timeout);
+bool wait_for_state_change(struct node *node, unsigned timeout);
 std::string safename(const char *name);
 
 // CEC adapter tests
@@ -614,8 +614,8 @@ static int testNonBlocking(struct node *node)
 		fail_on_test(msg.tx_error_cnt);
 		seq = msg.sequence;
 
-		sleep(1);
 		while (true) {
+			fail_on_test(!wait_for_msg(node, 1500));
 			memset(&msg, 0xff, sizeof(msg));
 			msg.timeout = 1500;
 			fail_on_test(doioctl(node, CEC_RECEIVE, &msg));
@@ -666,8 +666,8 @@ static int testNonBlocking(struct node *node)
 		fail_on_test(msg.tx_error_cnt);
 		seq = msg.sequence;
 
-		sleep(1);
 		while (true) {
+			fail_on_test(!wait_for_msg(node, 1500));
 			memset(&msg, 0xff, sizeof(msg));
 			msg.timeout = 1500;
 			fail_on_test(doioctl(node, CEC_RECEIVE, &msg));
@@ -725,8 +725,8 @@ static int testNonBlocking(struct node *node)
 		fail_on_test(msg.tx_error_cnt);
 		seq = msg.sequence;
 
-		sleep(1);
 		while (true) {
+			fail_on_test(!wait_for_msg(node, 1500));
 			memset(&msg, 0xff, sizeof(msg));
 			msg.timeout = 1500;
 			fail_on_test(doioctl(node, CEC_RECEIVE, &msg));
@@ -776,8 +776,8 @@ static int testNonBlocking(struct node *node)
 		fail_on_test(msg.tx_error_cnt);
 		seq = msg.sequence;
 
-		sleep(1);
 		while (true) {
+			fail_on_test(!wait_for_msg(node, 1500));
 			memset(&msg, 0xff, sizeof(msg));
 			msg.timeout = 1500;
 			fail_on_test(doioctl(node, CEC_RECEIVE, &msg));
@@ -1318,6 +1318,13 @@ void testAdapter(struct node &node, struct cec_log_addrs &laddrs,
 	}
 	printf("\tCEC_ADAP_G/S_LOG_ADDRS: %s\n", ok(testAdapLogAddrs(&node)));
 	fcntl(node.fd, F_SETFL, fcntl(node.fd, F_GETFL) & ~O_NONBLOCK);
+	/*
+	 * The logical address tests reconfigured the adapter several times in
+	 * a row. Let the remote devices finish reacting to that (e.g. polling
+	 * or querying the new logical addresses) before configuring it once
+	 * more. Their traffic is not reported to us, so there is nothing to
+	 * wait for.
+	 */
 	sleep(1);
 	if (node.caps & CEC_CAP_LOG_ADDRS) {
 		struct cec_log_addrs clear = { };
@@ -809,16 +809,22 @@ static int sac_util_send_user_control_press(struct node *node, unsigned me, unsi
 	   back to the TV in CEC 2.0.
 
 	   It is recommended for devices to not send Report Audio Status back
-	   more often than once every 500ms. We therefore sleep a second before
-	   each User Control Pressed is sent. */
+	   more often than once every 500ms. We therefore make sure that at
+	   least a second has passed since the previous User Control Pressed
+	   before sending the next one, and wait a full second before the
+	   first one. */
+	static unsigned last_press_ts;
+	unsigned since_last_press = last_press_ts ? get_ts_ms() - last_press_ts : 0;
 	bool got_response;
 
-	sleep(1);
+	if (since_last_press < 1000)
+		usleep((1000 - since_last_press) * 1000);
 	mode_set_follower(node);
 	cec_msg_init(&msg, me, la);
 	rc_press.ui_cmd = ui_cmd;
 	cec_msg_user_control_pressed(&msg, &rc_press);
 	fail_on_test(!transmit(node, &msg));
+	last_press_ts = get_ts_ms();
 	cec_msg_init(&msg, me, la);
 	cec_msg_user_control_released(&msg);
 	fail_on_test(!transmit_timeout(node, &msg));
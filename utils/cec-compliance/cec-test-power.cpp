@@ -246,6 +246,21 @@ const vec_remote_subtests one_touch_play_subtests{
 /* The default sleep time between power status requests. */
 #define SLEEP_POLL_POWER_STATUS 2
 
+/*
+ * Wait before polling the power status again. CEC 2.0 devices broadcast
+ * Report Power Status when their power status changes, so stop waiting
+ * as soon as one arrives.
+ */
+static void wait_poll_power_status(struct node *node, unsigned la)
+{
+	struct cec_msg msg;
+
+	mode_set_follower(node);
+	util_receive(node, la, SLEEP_POLL_POWER_STATUS * 1000, &msg,
+		     CEC_MSG_GIVE_DEVICE_POWER_STATUS, CEC_MSG_REPORT_POWER_STATUS);
+	mode_set_initiator(node);
+}
+
 static bool wait_changing_power_status(struct node *node, unsigned me, unsigned la, __u8 &new_status,
 				       unsigned &unresponsive_cnt)
 {
@@ -267,7 +282,7 @@ static bool wait_changing_power_status(struct node *node, unsigned me, unsigned
 			new_status = power_status;
 			return true;
 		}
-		sleep(SLEEP_POLL_POWER_STATUS);
+		wait_poll_power_status(node, la);
 	}
 	new_status = old_status;
 	return false;
@@ -291,7 +306,7 @@ static bool poll_stable_power_status(struct node *node, unsigned me, unsigned la
 			   between power modes. Register that this happens, but continue
 			   the test. */
 			unresponsive_cnt++;
-			sleep(SLEEP_POLL_POWER_STATUS);
+			wait_poll_power_status(node, la);
 			continue;
 		}
 		if (!transient && (power_status == CEC_OP_POWER_STATUS_TO_ON ||
@@ -312,7 +327,7 @@ static bool poll_stable_power_status(struct node *node, unsigned me, unsigned la
 					 power_status2s(power_status), (int)(time(NULL) - t));
 			return true;
 		}
-		sleep(SLEEP_POLL_POWER_STATUS);
+		wait_poll_power_status(node, la);
 	}
 	return false;
 }
@@ -524,6 +539,12 @@ static int standby_resume_wakeup_view_on(struct node *node, unsigned me, unsigne
 
 	unsigned unresponsive_cnt = 0;
 
+	/*
+	 * The previous test just woke up the display. Displays report On
+	 * well before they accept a Standby again, and nothing on the bus
+	 * tells when that is, so there is no event to wait for: give it a
+	 * fixed amount of time.
+	 */
 	sleep(5);
 	fail_on_test(!poll_stable_power_status(node, me, la, CEC_OP_POWER_STATUS_ON, unresponsive_cnt));
 
@@ -538,6 +559,10 @@ static int standby_resume_wakeup_view_on(struct node *node, unsigned me, unsigne
 	if (ret)
 		return ret;
 
+	/*
+	 * Likewise, displays that just reported Standby may still ignore a
+	 * wakeup while they finish powering down.
+	 */
 	sleep(6);
 
 	ret = one_touch_play_view_on(node, me, la, interactive, opcode);
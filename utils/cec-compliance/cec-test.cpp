@@ -738,7 +738,10 @@ static int deck_ctl_deck_ctl(struct node *node, unsigned me, unsigned la, bool i
 		return OK;
 	}
 	fail_on_test(cec_msg_status_is_abort(&msg));
-	/* Wait for Deck to finish Skip Forward. */
+	/*
+	 * Wait for Deck to finish Skip Forward. The deck only reports its status
+	 * when asked, so poll it once a second.
+	 */
 	for (int i = 0; deck_status == CEC_OP_DECK_INFO_SKIP_FWD && i < long_timeout; i++) {
 		sleep(1);
 		fail_on_test(deck_status_get(node, me, la, deck_status));
@@ -1177,6 +1180,7 @@ void testRemote(struct node *node, unsigned me, unsigned la, unsigned test_tags,
 	transmit_timeout(node, &msg);
 
 	int ret = 0;
+	unsigned ts_total = get_ts_ms();
 
 	for (const auto &test : tests) {
 		if ((test.tags & test_tags) != test.tags)
@@ -1185,6 +1189,7 @@ void testRemote(struct node *node, unsigned me, unsigned la, unsigned test_tags,
 		printf("\t%s:\n", test.name);
 		for (const auto &subtest : test.subtests) {
 			const char *name = subtest.name;
+			char timing[32] = "";
 
 			if (subtest.for_cec20 &&
 			    (node->remote[la].cec_version < CEC_OP_CEC_VERSION_2_0 || !node->has_cec20))
@@ -1200,29 +1205,35 @@ void testRemote(struct node *node, unsigned me, unsigned la, unsigned test_tags,
 			node->in_standby = subtest.in_standby;
 			mode_set_initiator(node);
 			unsigned old_warnings = warnings;
+			unsigned ts_start = get_ts_ms();
 			ret = subtest.test_fn(node, me, la, interactive);
+			if (show_timing)
+				sprintf(timing, " [%u ms]", get_ts_ms() - ts_start);
 			bool has_warnings = old_warnings < warnings;
 			if (!(subtest.la_mask & (1 << la)) && !ret)
 				ret = OK_UNEXPECTED;
 
 			if (mapTests[safename(name)] != DONT_CARE) {
 				if (ret != mapTests[safename(name)])
-					printf("\t    %s: %s (Expected '%s', got '%s')\n",
+					printf("\t    %s: %s (Expected '%s', got '%s')%s\n",
 					       name, ok(FAIL),
 					       result_name(mapTests[safename(name)], false),
-					       result_name(ret, false));
+					       result_name(ret, false), timing);
 				else if (has_warnings && mapTestsNoWarnings[safename(name)])
-					printf("\t    %s: %s (Expected no warnings, but got %d)\n",
-					       name, ok(FAIL), warnings - old_warnings);
+					printf("\t    %s: %s (Expected no warnings, but got %d)%s\n",
+					       name, ok(FAIL), warnings - old_warnings, timing);
 				else if (ret == FAIL)
-					printf("\t    %s: %s\n", name, ok(OK_EXPECTED_FAIL));
+					printf("\t    %s: %s%s\n", name, ok(OK_EXPECTED_FAIL), timing);
 				else
-					printf("\t    %s: %s\n", name, ok(ret));
+					printf("\t    %s: %s%s\n", name, ok(ret), timing);
 			} else if (ret != NOTAPPLICABLE)
-				printf("\t    %s: %s\n", name, ok(ret));
+				printf("\t    %s: %s%s\n", name, ok(ret), timing);
 			if (ret == FAIL_CRITICAL)
 				return;
 		}
 		printf("\n");
 	}
+	if (show_timing)
+		printf("Total time for remote LA %d: %.1f s\n\n", la,
+		       (get_ts_ms() - ts_total) / 1000.0);
 }
@@ -16,10 +16,14 @@
 #include <fcntl.h>
 #include <getopt.h>
 #include <pthread.h>
+#include <sys/inotify.h>
 #include <sys/ioctl.h>
 #include <sys/time.h>
+#include <sys/vfs.h>
 #include <unistd.h>
 
+#include <linux/magic.h>
+
 #include <linux/cec-funcs.h>
 #include "cec-htng-funcs.h"
 #include "cec-log.h"
@@ -110,6 +114,9 @@ enum Option {
 	OptIgnore,
 	OptStorePin,
 	OptAnalyzePin,
+	OptStoreRing,
+	OptRingSize,
+	OptAnalyzeRing,
 	OptRcTVProfile1,
 	OptRcTVProfile2,
 	OptRcTVProfile3,
@@ -179,6 +186,9 @@ static struct option long_options[] = {
 	{ "ignore", required_argument, nullptr, OptIgnore },
 	{ "store-pin", required_argument, nullptr, OptStorePin },
 	{ "analyze-pin", required_argument, nullptr, OptAnalyzePin },
+	{ "store-ring", required_argument, nullptr, OptStoreRing },
+	{ "ring-size", required_argument, nullptr, OptRingSize },
+	{ "analyze-ring", required_argument, nullptr, OptAnalyzeRing },
 	{ "no-reply", no_argument, nullptr, OptToggleNoReply },
 	{ "non-blocking", no_argument, nullptr, OptNonBlocking },
 	{ "logical-address", no_argument, nullptr, OptLogicalAddress },
@@ -323,6 +333,12 @@ static void usage()
 	       "                           Use - for stdout.\n"
 	       "  --analyze-pin <from>     Analyze the low-level CEC pin changes from the file <from>.\n"
 	       "                           Use - for stdin.\n"
+	       "  --store-ring <to>        Store the monitored CEC messages and events in binary form\n"
+	       "                           in the ring log <to> instead of showing them. When the ring\n"
+	       "                           is full the oldest messages are overwritten.\n"
+	       "  --ring-size <kb>         Size of the ring log in kB (default 4096).\n"
+	       "  --analyze-ring <from>    Show the CEC messages and events from the ring log <from>.\n"
+	       "                           Pin events are only shown with --monitor-pin.\n"
 	       "  --test-power-cycle [polls=<n>][,sleep=<secs>]\n"
 	       "                           Test power cycle behavior of the display. It polls up to\n"
 	       "                           <n> times (default 15), waiting for a state change. If\n"
@@ -870,13 +886,15 @@ static void wait_for_msgs(const struct node &node, __u32 monitor_time)
 
 #define MONITOR_FL_DROPPED_EVENTS     (1 << 16)
 
-static void monitor(const struct node &node, __u32 monitor_time, const char *store_pin)
+static void monitor(const struct node &node, __u32 monitor_time, const char *store_pin,
+		    const char *store_ring, unsigned ring_size)
 {
 	__u32 monitor = CEC_MODE_MONITOR;
 	fd_set rd_fds;
 	fd_set ex_fds;
 	int fd = node.fd;
 	FILE *fstore = nullptr;
+	struct cec_ring *ring = nullptr;
 	time_t t, start_minute;
 
 	if (options[OptMonitorAll])
@@ -930,6 +948,20 @@ static void monitor(const struct node &node, __u32 monitor_time, const char *sto
 			cec_phys_addr_exp(node.phys_addr));
 	}
 
+	if (store_ring) {
+		ring = cec_ring_create(store_ring,
+				       ring_size * 1024ULL / sizeof(struct cec_ring_rec),
+				       node.phys_addr, node.log_addr_mask);
+		if (ring == nullptr) {
+			fprintf(stderr, "Failed to create %s: %s\n", store_ring,
+				strerror(errno));
+			std::exit(EXIT_FAILURE);
+		}
+		cec_ring_add_clock(ring, start_monotonic, start_timeofday);
+		printf("\nStoring CEC messages and events in %s (%llu entries)\n",
+		       store_ring, ring->hdr->nr_recs);
+	}
+
 	if (fstore != stdout)
 		printf("\n");
 
@@ -953,7 +985,7 @@ static void monitor(const struct node &node, __u32 monitor_time, const char *sto
 		res = select(fd + 1, &rd_fds, nullptr, &ex_fds, &tv);
 		if (res < 0)
 			break;
-		if (store_pin && now - start_minute > 60 &&
+		if ((store_pin || ring) && now - start_minute > 60 &&
 		    (FD_ISSET(fd, &rd_fds) || FD_ISSET(fd, &ex_fds))) {
 			/*
 			 * The drift between the monotonic and wallclock
@@ -963,11 +995,15 @@ static void monitor(const struct node &node, __u32 monitor_time, const char *sto
 			 */
 			clock_gettime(CLOCK_MONOTONIC, &start_monotonic);
 			gettimeofday(&start_timeofday, nullptr);
-			fprintf(fstore, "# start_monotonic %lu.%09lu\n",
-				start_monotonic.tv_sec, start_monotonic.tv_nsec);
-			fprintf(fstore, "# start_timeofday %lu.%06lu\n",
-				start_timeofday.tv_sec, start_timeofday.tv_usec);
-			fflush(fstore);
+			if (ring)
+				cec_ring_add_clock(ring, start_monotonic, start_timeofday);
+			if (store_pin) {
+				fprintf(fstore, "# start_monotonic %lu.%09lu\n",
+					start_monotonic.tv_sec, start_monotonic.tv_nsec);
+				fprintf(fstore, "# start_timeofday %lu.%06lu\n",
+					start_timeofday.tv_sec, start_timeofday.tv_usec);
+				fflush(fstore);
+			}
 			start_minute = now;
 		}
 		if (FD_ISSET(fd, &rd_fds)) {
@@ -978,7 +1014,9 @@ static void monitor(const struct node &node, __u32 monitor_time, const char *sto
 				fprintf(stderr, "Device was disconnected.\n");
 				break;
 			}
-			if (!res && fstore != stdout)
+			if (!res && ring)
+				cec_ring_add_msg(ring, msg);
+			else if (!res && fstore != stdout)
 				show_msg(msg);
 		}
 		if (FD_ISSET(fd, &ex_fds)) {
@@ -986,6 +1024,10 @@ static void monitor(const struct node &node, __u32 monitor_time, const char *sto
 
 			if (doioctl(&node, CEC_DQEVENT, &ev))
 				continue;
+			if (ring) {
+				cec_ring_add_event(ring, ev);
+				continue;
+			}
 			if (ev.event == CEC_EVENT_PIN_CEC_LOW ||
 			    ev.event == CEC_EVENT_PIN_CEC_HIGH ||
 			    ev.event == CEC_EVENT_PIN_HPD_LOW ||
@@ -1008,7 +1050,7 @@ static void monitor(const struct node &node, __u32 monitor_time, const char *sto
 			if (!pin_event || options[OptMonitorPin])
 				log_event(ev, fstore != stdout);
 		}
-		if (!res && eob_ts) {
+		if (!res && eob_ts && !ring) {
 			struct timespec ts;
 			__u64 ts64;
 
@@ -1019,6 +1061,108 @@ static void monitor(const struct node &node, __u32 monitor_time, const char *sto
 	}
 	if (fstore && fstore != stdout)
 		fclose(fstore);
+	if (ring)
+		cec_ring_close(ring);
+}
+
+static void set_ring_clock(const struct cec_ring_clock &clock)
+{
+	start_monotonic.tv_sec = clock.monotonic_ns / 1000000000;
+	start_monotonic.tv_nsec = clock.monotonic_ns % 1000000000;
+	start_timeofday.tv_sec = clock.timeofday_us / 1000000;
+	start_timeofday.tv_usec = clock.timeofday_us % 1000000;
+	valid_until_t = 0;
+}
+
+static void analyze_ring(const char *analyze_ring)
+{
+	struct cec_ring *ring = cec_ring_open(analyze_ring);
+	__u64 head, first, i, skipped = 0;
+	bool have_clock = false;
+
+	if (ring == nullptr) {
+		fprintf(stderr, "Failed to open ring log %s: %s\n", analyze_ring,
+			strerror(errno));
+		std::exit(EXIT_FAILURE);
+	}
+
+	head = __atomic_load_n(&ring->hdr->head, __ATOMIC_ACQUIRE);
+	first = head > ring->hdr->nr_recs ? head - ring->hdr->nr_recs : 0;
+
+	printf("Physical Address:     %x.%x.%x.%x\n",
+	       cec_phys_addr_exp(ring->hdr->phys_addr));
+	printf("Logical Address Mask: 0x%04x\n", ring->hdr->log_addr_mask);
+	if (first)
+		printf("Lost Entries:         %llu\n", first);
+	printf("\n");
+
+	for (i = first; i < head; i++) {
+		struct cec_ring_rec rec;
+
+		if (!cec_ring_read(ring, i, rec)) {
+			skipped++;
+			continue;
+		}
+
+		switch (rec.type) {
+		case CEC_RING_CLOCK:
+			set_ring_clock(rec.clock);
+			have_clock = true;
+			break;
+		case CEC_RING_MSG:
+		case CEC_RING_EVENT:
+			/*
+			 * If the oldest clock entry was overwritten, then use
+			 * the first one that is left for the entries before it.
+			 */
+			if (!have_clock && options[OptWallClock]) {
+				for (__u64 j = i + 1; j < head; j++) {
+					struct cec_ring_rec clk;
+
+					if (cec_ring_read(ring, j, clk) &&
+					    clk.type == CEC_RING_CLOCK) {
+						set_ring_clock(clk.clock);
+						break;
+					}
+				}
+				have_clock = true;
+			}
+			if (rec.type == CEC_RING_MSG) {
+				show_msg(rec.msg);
+			} else {
+				struct cec_event ev = rec.ev;
+				bool pin_event = ev.event == CEC_EVENT_PIN_CEC_LOW ||
+						 ev.event == CEC_EVENT_PIN_CEC_HIGH ||
+						 ev.event == CEC_EVENT_PIN_HPD_LOW ||
+						 ev.event == CEC_EVENT_PIN_HPD_HIGH ||
+						 ev.event == CEC_EVENT_PIN_5V_LOW ||
+						 ev.event == CEC_EVENT_PIN_5V_HIGH;
+
+				/* Same as when monitoring, see monitor() */
+				if (ev.event == CEC_EVENT_PIN_CEC_LOW ||
+				    ev.event == CEC_EVENT_PIN_CEC_HIGH)
+					generate_eob_event(ev.ts, nullptr);
+				if (!pin_event || options[OptMonitorPin])
+					log_event(ev, true);
+			}
+			break;
+		default:
+			fprintf(stderr, "Unknown ring log entry type %u\n", rec.type);
+			break;
+		}
+	}
+
+	if (eob_ts) {
+		struct cec_event ev = {};
+
+		ev.event = CEC_EVENT_PIN_CEC_HIGH;
+		ev.ts = eob_ts;
+		log_event(ev, true);
+	}
+	if (skipped)
+		printf("\nSkipped Entries:      %llu (overwritten while reading, or incomplete)\n",
+		       skipped);
+	cec_ring_close(ring);
 }
 
 static void analyze(const char *analyze_pin)
@@ -1885,57 +2029,181 @@ static unsigned int cec_get_edid_spa_location(const __u8 *edid,
 	return 0;
 }
 
+/*
+ * The last EDID that was read and the physical address found in it, so
+ * an unchanged EDID doesn't have to be parsed again.
+ */
+struct edid_cache {
+	__u8 edid[256];
+	unsigned int size;
+	__u16 phys_addr;
+};
+
+static __u16 edid_cache_update(struct edid_cache *cache, const __u8 *edid,
+			       unsigned int size)
+{
+	if (cache->size && size == cache->size &&
+	    !memcmp(edid, cache->edid, size))
+		return cache->phys_addr;
+
+	memcpy(cache->edid, edid, size);
+	cache->size = size;
+	cache->phys_addr = CEC_PHYS_ADDR_INVALID;
+	if (size == sizeof(cache->edid)) {
+		unsigned int loc = cec_get_edid_spa_location(edid, size);
+
+		if (loc)
+			cache->phys_addr = (edid[loc] << 8) | edid[loc + 1];
+	}
+	return cache->phys_addr;
+}
+
+static unsigned int read_edid(int fd, __u8 *edid, unsigned int size)
+{
+	unsigned int len = 0;
+	ssize_t ret;
+
+	while (len < size) {
+		ret = pread(fd, edid + len, size - len, len);
+		if (ret <= 0)
+			break;
+		len += ret;
+	}
+	return len;
+}
+
 static __u16 parse_phys_addr_from_edid(const char *edid_path)
 {
-	FILE *f = fopen(edid_path, "r");
-	__u16 pa = CEC_PHYS_ADDR_INVALID;
+	struct edid_cache cache = {};
 	__u8 edid[256];
+	int fd = open(edid_path, O_RDONLY);
 
-	if (f == nullptr)
-		return pa;
-	if (fread(edid, sizeof(edid), 1, f) == 1) {
-		unsigned int loc = cec_get_edid_spa_location(edid, sizeof(edid));
+	if (fd < 0)
+		return CEC_PHYS_ADDR_INVALID;
+	unsigned int len = read_edid(fd, edid, sizeof(edid));
+	close(fd);
+	return edid_cache_update(&cache, edid, len);
+}
 
-		if (loc)
-			pa = (edid[loc] << 8) | edid[loc + 1];
+static void edid_changed(struct node *node, __u16 &phys_addr, __u16 new_pa)
+{
+	if (new_pa == phys_addr)
+		return;
+	phys_addr = new_pa;
+	doioctl(node, CEC_ADAP_S_PHYS_ADDR, &phys_addr);
+	if (is_paused)
+		printf("Physical Address: %x.%x.%x.%x\n",
+		       cec_phys_addr_exp(phys_addr));
+}
+
+/*
+ * Watch the EDID file and the directory containing it, so both changes
+ * to the file itself and replacing it (e.g. by renaming a new file over
+ * it) are noticed. Returns the inotify fd, or -1 if the EDID has to be
+ * polled instead: sysfs and debugfs files (which is where EDIDs exported
+ * by the kernel live) never generate inotify events.
+ */
+static int edid_inotify_init(const char *path)
+{
+	std::string dir(path);
+	std::size_t slash = dir.rfind('/');
+	struct statfs sfs;
+	int fd;
+
+	if (statfs(path, &sfs) == 0 &&
+	    (sfs.f_type == SYSFS_MAGIC || sfs.f_type == DEBUGFS_MAGIC))
+		return -1;
+
+	fd = inotify_init1(IN_CLOEXEC);
+	if (fd < 0)
+		return -1;
+
+	if (slash == std::string::npos)
+		dir = ".";
+	else
+		dir.erase(slash ? slash : 1);
+	/* Ignore IN_MODIFY, so a partially written EDID is never parsed */
+	if (inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_DELETE |
+			      IN_MOVED_FROM | IN_MOVED_TO) < 0) {
+		close(fd);
+		return -1;
 	}
-	fclose(f);
-	return pa;
+	return fd;
 }
 
 static void *thread_edid_poll(void *arg)
 {
 	auto node = static_cast<struct node *>(arg);
+	struct edid_cache cache = {};
+	__u8 edid[256];
 	__u16 phys_addr;
-	bool has_edid;
-	char dummy;
+	int ifd = edid_inotify_init(edid_path);
 	int fd;
 
+	doioctl(node, CEC_ADAP_G_PHYS_ADDR, &phys_addr);
+
+	if (ifd >= 0) {
+		const char *name = strrchr(edid_path, '/');
+		char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+		name = name ? name + 1 : edid_path;
+		for (;;) {
+			bool changed = false;
+			ssize_t len;
+
+			fd = open(edid_path, O_RDONLY);
+			if (fd >= 0) {
+				unsigned int size = read_edid(fd, edid, sizeof(edid));
+
+				close(fd);
+				edid_changed(node, phys_addr,
+					     edid_cache_update(&cache, edid, size));
+			} else {
+				edid_changed(node, phys_addr, CEC_PHYS_ADDR_INVALID);
+			}
+
+			/* Sleep until something happens to the EDID file */
+			while (!changed) {
+				len = read(ifd, buf, sizeof(buf));
+				if (len < 0 && errno == EINTR)
+					continue;
+				if (len <= 0)
+					std::exit(EXIT_FAILURE);
+				for (char *p = buf; p < buf + len;) {
+					auto ev = reinterpret_cast<struct inotify_event *>(p);
+
+					if (ev->len && !strcmp(ev->name, name))
+						changed = true;
+					p += sizeof(*ev) + ev->len;
+				}
+			}
+		}
+	}
+
 	fd = open(edid_path, O_RDONLY);
 	if (fd < 0)
 		std::exit(EXIT_FAILURE);
 
-	doioctl(node, CEC_ADAP_G_PHYS_ADDR, &phys_addr);
-	has_edid = phys_addr != CEC_PHYS_ADDR_INVALID;
+	bool has_edid = phys_addr != CEC_PHYS_ADDR_INVALID;
 
 	for (;;) {
-		bool edid;
+		bool present;
+		char dummy;
 
 		/* Poll every 100 ms */
 		usleep(100000);
-		lseek(fd, 0, SEEK_SET);
-		edid = read(fd, &dummy, 1) > 0;
-		if (has_edid != edid) {
-			has_edid = edid;
-			if (!edid)
-				phys_addr = CEC_PHYS_ADDR_INVALID;
-			else
-				phys_addr = parse_phys_addr_from_edid(edid_path);
-			doioctl(node, CEC_ADAP_S_PHYS_ADDR, &phys_addr);
-			if (is_paused)
-				printf("Physical Address: %x.%x.%x.%x\n",
-				       cec_phys_addr_exp(phys_addr));
-		}
+		present = pread(fd, &dummy, 1, 0) > 0;
+		if (has_edid == present)
+			continue;
+		has_edid = present;
+		/*
+		 * Only the presence of the EDID is checked every poll, it is
+		 * only read and parsed when it appears.
+		 */
+		edid_changed(node, phys_addr, present ?
+			     edid_cache_update(&cache, edid,
+					       read_edid(fd, edid, sizeof(edid))) :
+			     CEC_PHYS_ADDR_INVALID);
 	}
 	return nullptr;
 }
@@ -2049,6 +2317,9 @@ int main(int argc, char **argv)
 	const char *osd_name = "";
 	const char *store_pin = nullptr;
 	const char *analyze_pin = nullptr;
+	const char *store_ring = nullptr;
+	const char *analyze_ring_file = nullptr;
+	unsigned ring_size = 4096;
 	bool reply = true;
 	int idx = 0;
 	int fd = -1;
@@ -2160,6 +2431,19 @@ int main(int argc, char **argv)
 		case OptAnalyzePin:
 			analyze_pin = optarg;
 			break;
+		case OptStoreRing:
+			store_ring = optarg;
+			break;
+		case OptRingSize:
+			ring_size = strtoul(optarg, nullptr, 0);
+			if (!ring_size) {
+				fprintf(stderr, "invalid ring size\n");
+				std::exit(EXIT_FAILURE);
+			}
+			break;
+		case OptAnalyzeRing:
+			analyze_ring_file = optarg;
+			break;
 		case OptToggleNoReply:
 			reply = !reply;
 			break;
@@ -2541,9 +2825,33 @@ int main(int argc, char **argv)
 		return 0;
 	}
 
+	if (store_ring && store_pin) {
+		fprintf(stderr, "--store-pin and --store-ring options cannot be combined.\n\n");
+		usage();
+		return 1;
+	}
+
 	if (options[OptWallClock] && !options[OptMonitorPin])
 		verbose = true;
 
+	if (analyze_ring_file && (options[OptSetDevice] || store_ring)) {
+		fprintf(stderr, "--analyze-ring cannot be combined with --device or --store-ring.\n\n");
+		usage();
+		return 1;
+	}
+
+	if (analyze_ring_file) {
+		analyze_ring(analyze_ring_file);
+		return 0;
+	}
+
+	if (store_ring && !options[OptMonitor] && !options[OptMonitorAll] &&
+	    !options[OptMonitorPin]) {
+		fprintf(stderr, "--store-ring can only be used when monitoring.\n\n");
+		usage();
+		return 1;
+	}
+
 	if (store_pin && !strcmp(store_pin, "-"))
 		options[OptSkipInfo] = 1;
 
@@ -2878,7 +3186,7 @@ int main(int argc, char **argv)
 skip_la:
 	if (options[OptMonitor] || options[OptMonitorAll] ||
 	    options[OptMonitorPin]) {
-		monitor(node, monitor_time, store_pin);
+		monitor(node, monitor_time, store_pin, store_ring, ring_size);
 	} else if (options[OptWaitForMsgs]) {
 		wait_for_msgs(node, monitor_time);
 	} else if (options[OptPhysAddrFromEDIDPoll]) {
@@ -18,4 +18,71 @@ extern __u64 eob_ts;
 extern __u64 eob_ts_max;
 void log_event_pin(bool is_high, __u64 ts, bool show);
 
+// cec-ring.cpp
+
+/*
+ * The ring log is a file with a header followed by fixed size records,
+ * which is mmap()ed and written to in a circular fashion. 'head' is the
+ * total number of records ever written, so if it is larger than the number
+ * of records then the ring has wrapped around and the oldest record is
+ * at head % nr_recs.
+ *
+ * Each record carries the low 32 bits of its position plus one in 'seq',
+ * which is 0 while the record is written. A reader checks 'seq' before and
+ * after copying a record, and skips the record if it doesn't match: it was
+ * either being overwritten or left incomplete.
+ */
+#define CEC_RING_MAGIC		"CECRING1"
+#define CEC_RING_VERSION	2
+
+enum cec_ring_rec_type {
+	CEC_RING_MSG = 1,
+	CEC_RING_EVENT,
+	// The monotonic clock and wallclock time at the same moment
+	CEC_RING_CLOCK,
+};
+
+struct cec_ring_clock {
+	__u64 monotonic_ns;
+	__u64 timeofday_us;
+};
+
+struct cec_ring_rec {
+	__u32 type;
+	__u32 seq;
+	union {
+		struct cec_msg msg;
+		struct cec_event ev;
+		struct cec_ring_clock clock;
+	};
+};
+
+struct cec_ring_hdr {
+	char magic[8];
+	__u32 version;
+	__u32 rec_size;
+	__u64 nr_recs;
+	__u64 head;
+	__u16 phys_addr;
+	__u16 log_addr_mask;
+	__u32 reserved[9];
+};
+
+struct cec_ring {
+	int fd;
+	size_t size;
+	struct cec_ring_hdr *hdr;
+	struct cec_ring_rec *recs;
+};
+
+struct cec_ring *cec_ring_create(const char *path, __u64 nr_recs,
+				 __u16 phys_addr, __u16 log_addr_mask);
+struct cec_ring *cec_ring_open(const char *path);
+void cec_ring_close(struct cec_ring *ring);
+bool cec_ring_read(const struct cec_ring *ring, __u64 pos, struct cec_ring_rec &rec);
+void cec_ring_add_msg(struct cec_ring *ring, const struct cec_msg &msg);
+void cec_ring_add_event(struct cec_ring *ring, const struct cec_event &ev);
+void cec_ring_add_clock(struct cec_ring *ring, const struct timespec &mono,
+			const struct timeval &tod);
+
 #endif
@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Binary ring log of CEC messages and events.
+ *
+ * Storing the raw cec_msg and cec_event structs in an mmap()ed file costs
+ * a memcpy per message, so the bus can be recorded continuously without
+ * the overhead of decoding and printing each message. The log is decoded
+ * later by cec-ctl --analyze-ring.
+ */
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <linux/cec.h>
+
+#ifdef __ANDROID__
+#include <android-config.h>
+#else
+#include <config.h>
+#endif
+
+#include "cec-ctl.h"
+
+static struct cec_ring *cec_ring_map(int fd, size_t size, bool writable)
+{
+	auto ring = static_cast<struct cec_ring *>(calloc(1, sizeof(struct cec_ring)));
+	void *p;
+
+	if (!ring)
+		return nullptr;
+	p = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+		 MAP_SHARED, fd, 0);
+	if (p == MAP_FAILED) {
+		free(ring);
+		return nullptr;
+	}
+	ring->fd = fd;
+	ring->size = size;
+	ring->hdr = static_cast<struct cec_ring_hdr *>(p);
+	ring->recs = reinterpret_cast<struct cec_ring_rec *>(ring->hdr + 1);
+	return ring;
+}
+
+struct cec_ring *cec_ring_create(const char *path, __u64 nr_recs,
+				 __u16 phys_addr, __u16 log_addr_mask)
+{
+	size_t size = sizeof(struct cec_ring_hdr) +
+		      nr_recs * sizeof(struct cec_ring_rec);
+	struct cec_ring *ring;
+	int fd;
+
+	fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+		return nullptr;
+	/*
+	 * Allocate the blocks up front, so the ring never fails with SIGBUS
+	 * when the disk fills up while recording.
+	 */
+	errno = posix_fallocate(fd, 0, size);
+	if (errno && errno != EOPNOTSUPP && errno != EINVAL) {
+		close(fd);
+		return nullptr;
+	}
+	if (ftruncate(fd, size)) {
+		close(fd);
+		return nullptr;
+	}
+	ring = cec_ring_map(fd, size, true);
+	if (!ring) {
+		close(fd);
+		return nullptr;
+	}
+	memcpy(ring->hdr->magic, CEC_RING_MAGIC, sizeof(ring->hdr->magic));
+	ring->hdr->version = CEC_RING_VERSION;
+	ring->hdr->rec_size = sizeof(struct cec_ring_rec);
+	ring->hdr->nr_recs = nr_recs;
+	ring->hdr->phys_addr = phys_addr;
+	ring->hdr->log_addr_mask = log_addr_mask;
+	return ring;
+}
+
+struct cec_ring *cec_ring_open(const char *path)
+{
+	struct cec_ring_hdr hdr;
+	struct cec_ring *ring;
+	struct stat st;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return nullptr;
+	if (fstat(fd, &st) || read(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+	    memcmp(hdr.magic, CEC_RING_MAGIC, sizeof(hdr.magic)) ||
+	    hdr.version != CEC_RING_VERSION ||
+	    hdr.rec_size != sizeof(struct cec_ring_rec) || !hdr.nr_recs ||
+	    hdr.nr_recs > (st.st_size - sizeof(hdr)) / sizeof(struct cec_ring_rec)) {
+		close(fd);
+		errno = EINVAL;
+		return nullptr;
+	}
+	ring = cec_ring_map(fd, st.st_size, false);
+	if (!ring)
+		close(fd);
+	return ring;
+}
+
+void cec_ring_close(struct cec_ring *ring)
+{
+	munmap(ring->hdr, ring->size);
+	close(ring->fd);
+	free(ring);
+}
+
+/*
+ * Copy the record at position pos. Returns false if it was overwritten
+ * or not completely written, e.g. because cec-ctl was killed meanwhile.
+ */
+bool cec_ring_read(const struct cec_ring *ring, __u64 pos, struct cec_ring_rec &rec)
+{
+	const struct cec_ring_rec *r = &ring->recs[pos % ring->hdr->nr_recs];
+	__u32 seq = pos + 1;
+
+	if (__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != seq)
+		return false;
+	memcpy(&rec, r, sizeof(rec));
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	return __atomic_load_n(&r->seq, __ATOMIC_RELAXED) == seq;
+}
+
+/*
+ * Invalidate the record before overwriting it, so a reader that still
+ * considers it part of the ring skips it instead of reading a mix of the
+ * old and the new record.
+ */
+static struct cec_ring_rec *cec_ring_next(struct cec_ring *ring, __u32 type)
+{
+	struct cec_ring_rec *rec = &ring->recs[ring->hdr->head % ring->hdr->nr_recs];
+
+	__atomic_store_n(&rec->seq, 0, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	rec->type = type;
+	return rec;
+}
+
+/* Validate the complete record, then make it part of the ring. */
+static void cec_ring_commit(struct cec_ring *ring)
+{
+	__u64 head = ring->hdr->head;
+
+	__atomic_store_n(&ring->recs[head % ring->hdr->nr_recs].seq,
+			 (__u32)(head + 1), __ATOMIC_RELEASE);
+	__atomic_store_n(&ring->hdr->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void cec_ring_add_msg(struct cec_ring *ring, const struct cec_msg &msg)
+{
+	cec_ring_next(ring, CEC_RING_MSG)->msg = msg;
+	cec_ring_commit(ring);
+}
+
+void cec_ring_add_event(struct cec_ring *ring, const struct cec_event &ev)
+{
+	cec_ring_next(ring, CEC_RING_EVENT)->ev = ev;
+	cec_ring_commit(ring);
+}
+
+void cec_ring_add_clock(struct cec_ring *ring, const struct timespec &mono,
+			const struct timeval &tod)
+{
+	struct cec_ring_rec *rec = cec_ring_next(ring, CEC_RING_CLOCK);
+
+	rec->clock.monotonic_ns = mono.tv_sec * 1000000000ULL + mono.tv_nsec;
+	rec->clock.timeofday_us = tod.tv_sec * 1000000ULL + tod.tv_usec;
+	cec_ring_commit(ring);
+}
@@ -0,0 +1,341 @@
+// SPDX-License-Identifier: GPL-2.0
+//
+// Compiles the raw patterns of a keymap into a trie, which can be
+// searched in userspace or by the raw BPF decoder.
+//
+// Each node of the trie stands for the set of patterns which are still
+// alive after a number of pulses and spaces. A pattern matches a duration
+// d if raw - margin < d < raw + margin, so the children of a node are found
+// by splitting the duration range at every start and end of such an
+// interval; every piece leads to the set of patterns covering it. Since the
+// pieces never overlap, the trie is deterministic. Nodes for the same set
+// at the same depth are looked up in a hash table and shared, which keeps
+// the trie small when many patterns use the same timings.
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <argp.h>
+
+#include "keymap.h"
+#include "ir-raw-index.h"
+
+#define HASH_BUCKETS 65536
+
+struct build_node {
+	unsigned int depth;
+	unsigned int nr;
+	unsigned int *set;
+	uint64_t hash;
+	unsigned int hash_next;
+};
+
+struct builder {
+	struct raw_index *index;
+	struct build_node *bnodes;
+	unsigned int alloc_nodes;
+	unsigned int alloc_edges;
+	unsigned int *buckets;
+};
+
+static uint64_t set_hash(unsigned int depth, const unsigned int *set, unsigned int nr)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	unsigned int i;
+
+	hash = (hash ^ depth) * 0x100000001b3ULL;
+	for (i = 0; i < nr; i++)
+		hash = (hash ^ set[i]) * 0x100000001b3ULL;
+
+	return hash;
+}
+
+// Find the node for this set of patterns at this depth, or add it
+static int intern_node(struct builder *b, unsigned int depth,
+		       const unsigned int *set, unsigned int nr, uint32_t *id)
+{
+	struct raw_index *index = b->index;
+	uint64_t hash = set_hash(depth, set, nr);
+	unsigned int bucket = hash % HASH_BUCKETS;
+	struct build_node *bn;
+	unsigned int i;
+
+	for (i = b->buckets[bucket]; i != RAW_INDEX_NO_NODE; i = bn->hash_next) {
+		bn = &b->bnodes[i];
+		if (bn->hash == hash && bn->depth == depth && bn->nr == nr &&
+		    !memcmp(bn->set, set, nr * sizeof(*set))) {
+			*id = i;
+			return 0;
+		}
+	}
+
+	if (index->nr_nodes == b->alloc_nodes) {
+		unsigned int n = b->alloc_nodes ? b->alloc_nodes * 2 : 64;
+		void *p;
+
+		p = realloc(b->bnodes, n * sizeof(*b->bnodes));
+		if (!p)
+			return -1;
+		b->bnodes = p;
+		p = realloc(index->nodes, n * sizeof(*index->nodes));
+		if (!p)
+			return -1;
+		index->nodes = p;
+		b->alloc_nodes = n;
+	}
+
+	bn = &b->bnodes[index->nr_nodes];
+	bn->set = malloc(nr * sizeof(*set) ?: 1);
+	if (!bn->set)
+		return -1;
+	memcpy(bn->set, set, nr * sizeof(*set));
+	bn->depth = depth;
+	bn->nr = nr;
+	bn->hash = hash;
+	bn->hash_next = b->buckets[bucket];
+	b->buckets[bucket] = index->nr_nodes;
+
+	memset(&index->nodes[index->nr_nodes], 0, sizeof(*index->nodes));
+	*id = index->nr_nodes++;
+
+	return 0;
+}
+
+static int add_edge(struct builder *b, uint32_t low, uint32_t high, uint32_t next)
+{
+	struct raw_index *index = b->index;
+
+	if (index->nr_edges == b->alloc_edges) {
+		unsigned int n = b->alloc_edges ? b->alloc_edges * 2 : 64;
+		void *p;
+
+		p = realloc(index->edges, n * sizeof(*index->edges));
+		if (!p)
+			return -1;
+		index->edges = p;
+		b->alloc_edges = n;
+	}
+
+	index->edges[index->nr_edges].low = low;
+	index->edges[index->nr_edges].high = high;
+	index->edges[index->nr_edges].next = next;
+	index->nr_edges++;
+
+	return 0;
+}
+
+static int cmp_u64(const void *l, const void *r)
+{
+	uint64_t a = *(const uint64_t *)l, b = *(const uint64_t *)r;
+
+	return a < b ? -1 : a > b;
+}
+
+static int build_node(struct builder *b, uint32_t id, unsigned int margin,
+		      unsigned int *cover, unsigned int *prev_cover,
+		      uint64_t *low, uint64_t *high, uint64_t *bps)
+{
+	struct raw_index *index = b->index;
+	unsigned int depth = b->bnodes[id].depth;
+	unsigned int *set = b->bnodes[id].set;
+	unsigned int nr = b->bnodes[id].nr;
+	unsigned int i, j, nr_bps = 0, nr_cover, nr_prev = 0;
+	uint32_t child;
+
+	index->nodes[id].first_edge = index->nr_edges;
+
+	for (i = 0; i < nr; i++) {
+		struct raw_entry *e = index->entries[set[i]];
+		uint32_t r;
+
+		if (e->raw_length <= depth) {
+			// the first pattern ending here wins
+			if (e->raw_length == depth && !index->nodes[id].entry) {
+				index->nodes[id].entry = set[i] + 1;
+				index->nodes[id].scancode = e->scancode;
+			}
+			low[i] = 1;
+			high[i] = 0;
+			continue;
+		}
+
+		r = e->raw[depth];
+		low[i] = r >= margin ? r - margin + 1 : 0;
+		high[i] = margin ? (uint64_t)r + margin - 1 : r;
+		bps[nr_bps++] = low[i];
+		bps[nr_bps++] = high[i] + 1;
+	}
+
+	qsort(bps, nr_bps, sizeof(*bps), cmp_u64);
+
+	for (j = 0; j + 1 < nr_bps; j++) {
+		uint64_t a = bps[j], z = bps[j + 1] - 1;
+
+		if (bps[j] == bps[j + 1])
+			continue;
+
+		nr_cover = 0;
+		for (i = 0; i < nr; i++) {
+			if (low[i] <= a && high[i] >= z)
+				cover[nr_cover++] = set[i];
+		}
+
+		if (!nr_cover) {
+			nr_prev = 0;
+			continue;
+		}
+
+		if (a > UINT32_MAX)
+			break;
+		if (z > UINT32_MAX)
+			z = UINT32_MAX;
+
+		// extend the previous edge if it leads to the same set
+		if (nr_prev == nr_cover &&
+		    index->nr_edges > index->nodes[id].first_edge &&
+		    index->edges[index->nr_edges - 1].high + 1 == a &&
+		    !memcmp(prev_cover, cover, nr_cover * sizeof(*cover))) {
+			index->edges[index->nr_edges - 1].high = z;
+			continue;
+		}
+
+		if (intern_node(b, depth + 1, cover, nr_cover, &child) ||
+		    add_edge(b, a, z, child))
+			return -1;
+
+		memcpy(prev_cover, cover, nr_cover * sizeof(*cover));
+		nr_prev = nr_cover;
+	}
+
+	index->nodes[id].nr_edges = index->nr_edges - index->nodes[id].first_edge;
+
+	return 0;
+}
+
+struct raw_index *raw_index_compile(struct raw_entry *raw, unsigned int margin)
+{
+	struct builder b = {};
+	struct raw_index *index;
+	unsigned int *cover = NULL, *prev_cover = NULL;
+	uint64_t *low = NULL, *high = NULL, *bps = NULL;
+	struct raw_entry *e;
+	unsigned int i, n;
+	uint32_t id;
+	int ret = -1;
+
+	index = calloc(1, sizeof(*index));
+	if (!index)
+		return NULL;
+
+	for (e = raw, n = 0; e; e = e->next)
+		n++;
+
+	index->entries = calloc(n ?: 1, sizeof(*index->entries));
+	b.buckets = malloc(HASH_BUCKETS * sizeof(*b.buckets));
+	cover = malloc((n ?: 1) * sizeof(*cover));
+	prev_cover = malloc((n ?: 1) * sizeof(*prev_cover));
+	low = malloc((n ?: 1) * sizeof(*low));
+	high = malloc((n ?: 1) * sizeof(*high));
+	bps = malloc((n ?: 1) * 2 * sizeof(*bps));
+	if (!index->entries || !b.buckets || !cover || !prev_cover ||
+	    !low || !high || !bps)
+		goto done;
+
+	memset(b.buckets, 0xff, HASH_BUCKETS * sizeof(*b.buckets));
+	b.index = index;
+
+	for (e = raw; e; e = e->next) {
+		for (i = 1; i < e->raw_length; i += 2) {
+			if (e->raw[i] > index->trail_space)
+				index->trail_space = e->raw[i];
+		}
+		cover[index->nr_entries] = index->nr_entries;
+		index->entries[index->nr_entries++] = e;
+	}
+
+	// 1ms extra for trailing space. This also ensures that the
+	// trail_space is larger than largest space + margin in the
+	// decoder
+	index->trail_space += 1000;
+
+	if (intern_node(&b, 0, cover, n, &id))
+		goto done;
+
+	// nodes are added while building, so this is a breadth-first walk
+	for (id = 0; id < index->nr_nodes; id++) {
+		if (build_node(&b, id, margin, cover, prev_cover, low, high, bps))
+			goto done;
+	}
+
+	ret = 0;
+done:
+	for (i = 0; i < index->nr_nodes; i++)
+		free(b.bnodes[i].set);
+	free(b.bnodes);
+	free(b.buckets);
+	free(cover);
+	free(prev_cover);
+	free(low);
+	free(high);
+	free(bps);
+
+	if (ret) {
+		raw_index_free(index);
+		return NULL;
+	}
+
+	return index;
+}
+
+void raw_index_free(struct raw_index *index)
+{
+	if (!index)
+		return;
+
+	free(index->nodes);
+	free(index->edges);
+	free(index->entries);
+	free(index);
+}
+
+// Feed a pulse or space to the decoder, which starts in node 0. Returns
+// the matching pattern when a trailing space ends it.
+struct raw_entry *raw_index_decode(const struct raw_index *index, uint32_t *node,
+				   bool pulse, unsigned int duration)
+{
+	const struct raw_index_node *n;
+	unsigned int lo, hi, mid;
+
+	if (!pulse && duration >= index->trail_space) {
+		struct raw_entry *e = NULL;
+
+		if (*node != RAW_INDEX_NO_NODE && index->nodes[*node].entry)
+			e = index->entries[index->nodes[*node].entry - 1];
+
+		*node = 0;
+		return e;
+	}
+
+	if (*node == RAW_INDEX_NO_NODE)
+		return NULL;
+
+	n = &index->nodes[*node];
+	lo = n->first_edge;
+	hi = lo + n->nr_edges;
+	*node = RAW_INDEX_NO_NODE;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+
+		if (duration < index->edges[mid].low) {
+			hi = mid;
+		} else if (duration > index->edges[mid].high) {
+			lo = mid + 1;
+		} else {
+			*node = index->edges[mid].next;
+			break;
+		}
+	}
+
+	return NULL;
+}
@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef __IR_RAW_INDEX_H
+#define __IR_RAW_INDEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct raw_entry;
+
+/*
+ * The raw patterns of a keymap compiled into a deterministic trie. Every
+ * node has a list of edges sorted by duration, each covering a range of
+ * durations which match the next pulse or space of the patterns still
+ * alive in that node, with the margin applied. Patterns with timings in
+ * the same tolerance bucket share their nodes, so a pulse or space costs
+ * a binary search over the edges of one node, no matter how many patterns
+ * the keymap has. Node 0 is the root.
+ *
+ * The layout of these structs is shared with the raw BPF decoder.
+ */
+#define RAW_INDEX_NO_NODE 0xffffffffU
+
+struct raw_index_node {
+	uint64_t scancode;
+	uint32_t first_edge;
+	uint32_t nr_edges;
+	// 1-based index of the pattern ending in this node, or 0
+	uint32_t entry;
+	uint32_t reserved;
+};
+
+struct raw_index_edge {
+	uint32_t low;
+	uint32_t high;
+	uint32_t next;
+};
+
+struct raw_index {
+	struct raw_index_node *nodes;
+	unsigned int nr_nodes;
+	struct raw_index_edge *edges;
+	unsigned int nr_edges;
+	struct raw_entry **entries;
+	unsigned int nr_entries;
+	unsigned int trail_space;
+};
+
+struct raw_index *raw_index_compile(struct raw_entry *raw, unsigned int margin);
+void raw_index_free(struct raw_index *index);
+struct raw_entry *raw_index_decode(const struct raw_index *index, uint32_t *node,
+				   bool pulse, unsigned int duration);
+
+#endif
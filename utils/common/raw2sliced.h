@@ -71,4 +71,16 @@ void vbi_parse(struct vbi_handle *vh, const unsigned char *buf,
 		struct v4l2_sliced_vbi_format *vbi,
 		struct v4l2_sliced_vbi_data *data);
 
+// Parses the lines first_line up to (but not including) last_line of the raw
+// buffer. Lines are numbered as in the data array, i.e. the lines of the
+// second field follow those of the first field. The found services are OR-ed
+// into vbi, so it has to be zeroed by the caller.
+// The slicer state in vh is not modified, so several threads can parse
+// different lines or buffers concurrently as long as each thread uses its
+// own vbi struct.
+void vbi_parse_lines(const struct vbi_handle *vh, const unsigned char *buf,
+		unsigned first_line, unsigned last_line,
+		struct v4l2_sliced_vbi_format *vbi,
+		struct v4l2_sliced_vbi_data *data);
+
 #endif
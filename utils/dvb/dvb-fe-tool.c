@@ -22,9 +22,15 @@
 #include "libdvbv5/dvb-dev.h"
 #include <config.h>
 #include <argp.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #ifdef ENABLE_NLS
@@ -67,6 +73,12 @@ static const struct argp_option options[] = {
 	{"tcp-port",	'T',	N_("PORT"),	0, 	N_("dvbv5-daemon host tcp port"), 0},
 	{"device-mon",	'D',	0,		0,	N_("monitors device insert/removal"), 0},
 	{"count",	'c',	N_("COUNT"),	0,	N_("samples to take (default 0 = infinite)"), 0},
+	{"log",		'L',	N_("FILE"),	0,	N_("logs frontend stats to FILE ('-' for stdout)"), 0},
+	{"log-format",	'F',	N_("FORMAT"),	0,	N_("log format: csv (default) or bin"), 0},
+	{"log-frontends", 'l',	N_("LIST"),	0,	N_("frontends to log, as ADAPTER[:FRONTEND],... (default: -a/-f)"), 0},
+	{"interval",	'i',	N_("MSEC"),	0,	N_("log sampling interval (default 50)"), 0},
+	{"window",	'w',	N_("SAMPLES"),	0,	N_("samples in the rolling stats of the log (default 32)"), 0},
+	{"log-to-csv",	'C',	N_("FILE"),	0,	N_("prints a binary log as CSV"), 0},
 	{"help",        '?',	0,		0,	N_("Give this help list"), -1},
 	{"usage",	-3,	0,		0,	N_("Give a short usage message")},
 	{"version",	'V',	0,		0,	N_("Print program version"), -1},
@@ -86,6 +98,12 @@ static int acoustical = 0;
 static int timeout_flag = 0;
 static int device_mon = 0;
 static int count = 0;
+static const char *log_file = NULL;
+static const char *log_fe_list = NULL;
+static const char *log_dump = NULL;
+static int log_csv = 1;
+static unsigned log_interval = 50;
+static unsigned log_window = 32;
 
 static void do_timeout(int x)
 {
@@ -153,6 +171,31 @@ static error_t parse_opt(int k, char *arg, struct argp_state *state)
 	case 'c':
 		count = atoi(arg);
 		break;
+	case 'L':
+		log_file = arg;
+		break;
+	case 'F':
+		if (!strcmp(arg, "csv"))
+			log_csv = 1;
+		else if (!strcmp(arg, "bin"))
+			log_csv = 0;
+		else
+			return ARGP_ERR_UNKNOWN;
+		break;
+	case 'l':
+		log_fe_list = arg;
+		break;
+	case 'i':
+		log_interval = strtoul(arg, NULL, 0);
+		break;
+	case 'w':
+		log_window = strtoul(arg, NULL, 0);
+		if (!log_window)
+			return ARGP_ERR_UNKNOWN;
+		break;
+	case 'C':
+		log_dump = arg;
+		break;
 	case '?':
 		argp_state_help(state, state->out_stream,
 				ARGP_HELP_SHORT_USAGE | ARGP_HELP_LONG
@@ -292,6 +335,653 @@ static void get_show_stats(struct dvb_v5_fe_parms *parms)
 	} while (!timeout_flag);
 }
 
+/*
+ * Statistics logger. Samples the DVBv5 stats of one or more frontends on
+ * every tick and appends them, as raw integers, to an in-memory block.
+ * Samples identical to the previous one of the same frontend are dropped,
+ * so the log follows the rate at which the driver updates its stats. The
+ * block is written out once it is full or once per second, either as is
+ * (binary) or formatted as CSV in one go.
+ */
+#define FE_LOG_MAGIC		"DVBL"
+#define FE_LOG_VERSION		1
+#define FE_LOG_BLOCK		1024
+#define FE_LOG_MAX_FE		16
+#define FE_LOG_REPORT_NS	1000000000ULL
+
+/* The scale of each stat, as a 2-bit enum fecap_scale_params */
+#define FE_LOG_SCALE_SIGNAL	0
+#define FE_LOG_SCALE_CNR	2
+#define FE_LOG_SCALE_PRE	4
+#define FE_LOG_SCALE_POST	6
+#define FE_LOG_SCALE_UCB	8
+#define FE_LOG_SCALE(s, shift)	(((s) >> (shift)) & 3)
+
+struct fe_log_header {
+	char magic[4];
+	uint32_t version;
+	uint32_t sample_size;
+	uint32_t n_fe;
+};
+
+struct fe_log_fe {
+	uint16_t adapter;
+	uint16_t frontend;
+	uint32_t delsys;
+};
+
+/* Samples are stored in host byte order */
+struct fe_log_sample {
+	uint64_t ts;		/* CLOCK_MONOTONIC, in ns */
+	uint32_t status;
+	uint16_t fe;		/* index in the list of frontends */
+	uint16_t scales;
+	int64_t signal;		/* 0.001 dBm or 0..65535 */
+	int64_t cnr;		/* 0.001 dB or 0..65535 */
+	uint64_t pre_err, pre_total;
+	uint64_t post_err, post_total;
+	uint64_t ucb;
+};
+
+struct fe_log_window {
+	struct fe_log_sample *ring;
+	unsigned size, head, used;
+	int64_t sum_signal, sum_cnr;
+	unsigned n_signal, n_cnr;
+	unsigned samples;	/* since the last report */
+};
+
+struct fe_log_dev {
+	struct dvb_device *dvb;
+	struct fe_log_fe fe;
+	struct fe_log_sample last;
+	int has_last;
+	struct fe_log_window win;
+};
+
+static const char fe_log_csv_header[] =
+	"ts_ns,adapter,frontend,status,signal,signal_scale,cnr,cnr_scale,"
+	"pre_err,pre_total,post_err,post_total,ucb\n";
+
+static uint64_t fe_log_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int fe_log_write(int fd, const void *buf, size_t size)
+{
+	const char *p = buf;
+	ssize_t ret;
+
+	while (size) {
+		ret = write(fd, p, size);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		p += ret;
+		size -= ret;
+	}
+	return 0;
+}
+
+static char *fe_log_fmt_u64(char *p, uint64_t v)
+{
+	char tmp[20];
+	int n = 0;
+
+	do {
+		tmp[n++] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+	while (n)
+		*p++ = tmp[--n];
+	*p++ = ',';
+	return p;
+}
+
+static char *fe_log_fmt_s64(char *p, int64_t v)
+{
+	if (v < 0) {
+		*p++ = '-';
+		return fe_log_fmt_u64(p, -(uint64_t)v);
+	}
+	return fe_log_fmt_u64(p, v);
+}
+
+/* Formats a sample as a CSV line; the buffer must hold 256 bytes */
+static char *fe_log_fmt_csv(char *p, const struct fe_log_sample *s,
+			    const struct fe_log_fe *fe)
+{
+	static const char * const scale_name[] = { "", "dB", "rel", "cnt" };
+	unsigned sc;
+
+	p = fe_log_fmt_u64(p, s->ts);
+	p = fe_log_fmt_u64(p, fe->adapter);
+	p = fe_log_fmt_u64(p, fe->frontend);
+	p = fe_log_fmt_u64(p, s->status);
+
+	sc = FE_LOG_SCALE(s->scales, FE_LOG_SCALE_SIGNAL);
+	if (sc)
+		p = fe_log_fmt_s64(p, s->signal);
+	else
+		*p++ = ',';
+	p = stpcpy(p, scale_name[sc]);
+	*p++ = ',';
+
+	sc = FE_LOG_SCALE(s->scales, FE_LOG_SCALE_CNR);
+	if (sc)
+		p = fe_log_fmt_s64(p, s->cnr);
+	else
+		*p++ = ',';
+	p = stpcpy(p, scale_name[sc]);
+	*p++ = ',';
+
+	if (FE_LOG_SCALE(s->scales, FE_LOG_SCALE_PRE)) {
+		p = fe_log_fmt_u64(p, s->pre_err);
+		p = fe_log_fmt_u64(p, s->pre_total);
+	} else {
+		p = stpcpy(p, ",,");
+	}
+	if (FE_LOG_SCALE(s->scales, FE_LOG_SCALE_POST)) {
+		p = fe_log_fmt_u64(p, s->post_err);
+		p = fe_log_fmt_u64(p, s->post_total);
+	} else {
+		p = stpcpy(p, ",,");
+	}
+	if (FE_LOG_SCALE(s->scales, FE_LOG_SCALE_UCB))
+		p = fe_log_fmt_u64(p, s->ucb);
+	else
+		*p++ = ',';
+
+	p[-1] = '\n';
+	return p;
+}
+
+static int fe_log_flush(int fd, const struct fe_log_sample *samples,
+			unsigned n, const struct fe_log_dev *devs)
+{
+	static char buf[FE_LOG_BLOCK * 256];
+	char *p = buf;
+	unsigned i;
+
+	if (!n)
+		return 0;
+	if (!log_csv)
+		return fe_log_write(fd, samples, n * sizeof(*samples));
+
+	for (i = 0; i < n; i++)
+		p = fe_log_fmt_csv(p, &samples[i], &devs[samples[i].fe].fe);
+	return fe_log_write(fd, buf, p - buf);
+}
+
+static uint64_t fe_log_counter(struct dvb_v5_fe_parms *parms, unsigned cmd,
+			       int *avail)
+{
+	struct dtv_stats *stat = dvb_fe_retrieve_stats_layer(parms, cmd, 0);
+
+	if (!stat || stat->scale != FE_SCALE_COUNTER) {
+		*avail = 0;
+		return 0;
+	}
+	return stat->uvalue;
+}
+
+static int64_t fe_log_value(struct dvb_v5_fe_parms *parms, unsigned cmd,
+			    unsigned *scale)
+{
+	struct dtv_stats *stat = dvb_fe_retrieve_stats_layer(parms, cmd, 0);
+
+	if (!stat || stat->scale == FE_SCALE_NOT_AVAILABLE) {
+		*scale = FE_SCALE_NOT_AVAILABLE;
+		return 0;
+	}
+	*scale = stat->scale;
+	return stat->scale == FE_SCALE_DECIBEL ? stat->svalue : (int64_t)stat->uvalue;
+}
+
+static int fe_log_sample(struct dvb_v5_fe_parms *parms, struct fe_log_sample *s)
+{
+	unsigned scale;
+	uint32_t status;
+	int avail;
+
+	if (dvb_fe_get_stats(parms))
+		return -1;
+
+	memset(s, 0, sizeof(*s));
+	if (!dvb_fe_retrieve_stats(parms, DTV_STATUS, &status))
+		s->status = status;
+
+	s->signal = fe_log_value(parms, DTV_STAT_SIGNAL_STRENGTH, &scale);
+	s->scales |= scale << FE_LOG_SCALE_SIGNAL;
+	s->cnr = fe_log_value(parms, DTV_STAT_CNR, &scale);
+	s->scales |= scale << FE_LOG_SCALE_CNR;
+
+	avail = 1;
+	s->pre_err = fe_log_counter(parms, DTV_STAT_PRE_ERROR_BIT_COUNT, &avail);
+	s->pre_total = fe_log_counter(parms, DTV_STAT_PRE_TOTAL_BIT_COUNT, &avail);
+	if (avail)
+		s->scales |= FE_SCALE_COUNTER << FE_LOG_SCALE_PRE;
+	else
+		s->pre_err = s->pre_total = 0;
+
+	avail = 1;
+	s->post_err = fe_log_counter(parms, DTV_STAT_POST_ERROR_BIT_COUNT, &avail);
+	s->post_total = fe_log_counter(parms, DTV_STAT_POST_TOTAL_BIT_COUNT, &avail);
+	if (avail)
+		s->scales |= FE_SCALE_COUNTER << FE_LOG_SCALE_POST;
+	else
+		s->post_err = s->post_total = 0;
+
+	avail = 1;
+	s->ucb = fe_log_counter(parms, DTV_STAT_ERROR_BLOCK_COUNT, &avail);
+	if (avail)
+		s->scales |= FE_SCALE_COUNTER << FE_LOG_SCALE_UCB;
+
+	return 0;
+}
+
+/* Adds a sample to the rolling window, keeping the sums up to date */
+static void fe_log_window_add(struct fe_log_window *w,
+			      const struct fe_log_sample *s)
+{
+	struct fe_log_sample *old = &w->ring[w->head];
+
+	if (w->used == w->size) {
+		if (FE_LOG_SCALE(old->scales, FE_LOG_SCALE_SIGNAL)) {
+			w->sum_signal -= old->signal;
+			w->n_signal--;
+		}
+		if (FE_LOG_SCALE(old->scales, FE_LOG_SCALE_CNR)) {
+			w->sum_cnr -= old->cnr;
+			w->n_cnr--;
+		}
+	} else {
+		w->used++;
+	}
+
+	*old = *s;
+	if (FE_LOG_SCALE(s->scales, FE_LOG_SCALE_SIGNAL)) {
+		w->sum_signal += s->signal;
+		w->n_signal++;
+	}
+	if (FE_LOG_SCALE(s->scales, FE_LOG_SCALE_CNR)) {
+		w->sum_cnr += s->cnr;
+		w->n_cnr++;
+	}
+	w->head = (w->head + 1) % w->size;
+	w->samples++;
+}
+
+static const struct fe_log_sample *fe_log_window_get(const struct fe_log_window *w,
+						     unsigned i)
+{
+	return &w->ring[(w->head + w->size - w->used + i) % w->size];
+}
+
+static void fe_log_prt_value(const char *name, int64_t sum, unsigned n,
+			     const struct fe_log_window *w, unsigned shift,
+			     int is_signal)
+{
+	const struct fe_log_sample *s;
+	unsigned scale = 0, i;
+	int64_t v, min = INT64_MAX, max = INT64_MIN;
+
+	if (!n)
+		return;
+
+	for (i = 0; i < w->used; i++) {
+		s = fe_log_window_get(w, i);
+		if (!FE_LOG_SCALE(s->scales, shift))
+			continue;
+		scale = FE_LOG_SCALE(s->scales, shift);
+		v = is_signal ? s->signal : s->cnr;
+		if (v < min)
+			min = v;
+		if (v > max)
+			max = v;
+	}
+
+	if (scale == FE_SCALE_DECIBEL)
+		fprintf(stderr, " %s= %.2f%s [%.2f..%.2f]", name,
+			sum / (n * 1000.), is_signal ? "dBm" : "dB",
+			min / 1000., max / 1000.);
+	else
+		fprintf(stderr, " %s= %.2f%% [%.2f..%.2f]", name,
+			sum * 100. / (n * 65535.),
+			min * 100. / 65535, max * 100. / 65535);
+}
+
+/* BER over the window, from the first and last bit counters */
+static void fe_log_prt_ber(const char *name, const struct fe_log_window *w,
+			   unsigned shift)
+{
+	const struct fe_log_sample *first = NULL, *last = NULL, *s;
+	uint64_t err, total;
+	unsigned i;
+
+	for (i = 0; i < w->used; i++) {
+		s = fe_log_window_get(w, i);
+		if (!FE_LOG_SCALE(s->scales, shift))
+			continue;
+		if (!first)
+			first = s;
+		last = s;
+	}
+	if (!first)
+		return;
+
+	/* The counters restart when the frontend is retuned */
+	if (shift == FE_LOG_SCALE_PRE) {
+		if (last->pre_total < first->pre_total ||
+		    last->pre_err < first->pre_err)
+			return;
+		err = last->pre_err - first->pre_err;
+		total = last->pre_total - first->pre_total;
+	} else {
+		if (last->post_total < first->post_total ||
+		    last->post_err < first->post_err)
+			return;
+		err = last->post_err - first->post_err;
+		total = last->post_total - first->post_total;
+	}
+	if (total)
+		fprintf(stderr, " %s= %.2e", name, (double)err / total);
+}
+
+static void fe_log_report(struct fe_log_dev *dev, uint64_t elapsed)
+{
+	struct fe_log_window *w = &dev->win;
+	const struct fe_log_sample *first, *last;
+
+	fprintf(stderr, "adapter%d/frontend%d: %.1f samples/s",
+		dev->fe.adapter, dev->fe.frontend,
+		w->samples * 1e9 / elapsed);
+	w->samples = 0;
+
+	if (!w->used) {
+		fprintf(stderr, "\n");
+		return;
+	}
+
+	last = fe_log_window_get(w, w->used - 1);
+	fprintf(stderr, " %s (0x%02x)",
+		(last->status & FE_HAS_LOCK) ? _("Lock") : _("No lock"),
+		last->status);
+	fe_log_prt_value(_("Signal"), w->sum_signal, w->n_signal, w,
+			 FE_LOG_SCALE_SIGNAL, 1);
+	fe_log_prt_value(_("C/N"), w->sum_cnr, w->n_cnr, w,
+			 FE_LOG_SCALE_CNR, 0);
+	fe_log_prt_ber(_("preBER"), w, FE_LOG_SCALE_PRE);
+	fe_log_prt_ber(_("postBER"), w, FE_LOG_SCALE_POST);
+
+	first = fe_log_window_get(w, 0);
+	if (FE_LOG_SCALE(first->scales, FE_LOG_SCALE_UCB) &&
+	    FE_LOG_SCALE(last->scales, FE_LOG_SCALE_UCB) &&
+	    last->ucb >= first->ucb)
+		fprintf(stderr, " UCB= +%llu",
+			(unsigned long long)(last->ucb - first->ucb));
+	fprintf(stderr, "\n");
+}
+
+static int fe_log_parse_list(struct fe_log_dev *devs)
+{
+	const char *p = log_fe_list;
+	unsigned n = 0;
+	char *end;
+
+	if (!p) {
+		devs[0].fe.adapter = adapter;
+		devs[0].fe.frontend = frontend;
+		return 1;
+	}
+
+	while (*p) {
+		if (n == FE_LOG_MAX_FE) {
+			ERROR(_("at most %d frontends can be logged"), FE_LOG_MAX_FE);
+			return -1;
+		}
+		devs[n].fe.adapter = strtoul(p, &end, 0);
+		if (end == p)
+			goto err;
+		p = end;
+		if (*p == ':') {
+			devs[n].fe.frontend = strtoul(++p, &end, 0);
+			if (end == p)
+				goto err;
+			p = end;
+		}
+		n++;
+		if (*p == ',')
+			p++;
+		else if (*p)
+			goto err;
+	}
+	return n;
+
+err:
+	ERROR(_("invalid frontend list: %s"), log_fe_list);
+	return -1;
+}
+
+static int fe_log_open(struct fe_log_dev *dev)
+{
+	struct dvb_dev_list *dvb_dev;
+
+	dev->dvb = dvb_dev_alloc();
+	if (!dev->dvb)
+		return -1;
+
+	if (server && port && dvb_dev_remote_init(dev->dvb, server, port) < 0)
+		return -1;
+
+	dvb_dev_set_log(dev->dvb, verbose, NULL);
+	dvb_dev_find(dev->dvb, NULL, NULL);
+
+	dvb_dev = dvb_dev_seek_by_adapter(dev->dvb, dev->fe.adapter,
+					  dev->fe.frontend,
+					  DVB_DEVICE_FRONTEND);
+	if (!dvb_dev) {
+		ERROR(_("adapter%d/frontend%d not found"),
+		      dev->fe.adapter, dev->fe.frontend);
+		return -1;
+	}
+
+	if (!dvb_dev_open(dev->dvb, dvb_dev->sysname, O_RDONLY))
+		return -1;
+
+	dev->fe.delsys = dev->dvb->fe_parms->current_sys;
+
+	dev->win.size = log_window;
+	dev->win.ring = calloc(log_window, sizeof(*dev->win.ring));
+	if (!dev->win.ring)
+		return -1;
+
+	return 0;
+}
+
+static int fe_log_run(void)
+{
+	static struct fe_log_sample block[FE_LOG_BLOCK];
+	struct fe_log_dev devs[FE_LOG_MAX_FE] = {};
+	struct fe_log_sample s;
+	struct timespec next;
+	uint64_t now, t, start, last_report, interval_ns;
+	unsigned n_block = 0;
+	int i, n_devs, fd, ret = -1;
+
+	n_devs = fe_log_parse_list(devs);
+	if (n_devs < 0)
+		return -1;
+
+	for (i = 0; i < n_devs; i++)
+		if (fe_log_open(&devs[i]))
+			goto ret;
+
+	if (!strcmp(log_file, "-")) {
+		fd = STDOUT_FILENO;
+	} else {
+		fd = open(log_file, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			ERROR(_("can't open %s: %s"), log_file, strerror(errno));
+			goto ret;
+		}
+	}
+
+	if (log_csv) {
+		ret = fe_log_write(fd, fe_log_csv_header,
+				   sizeof(fe_log_csv_header) - 1);
+	} else {
+		struct fe_log_header hdr = {
+			.magic = FE_LOG_MAGIC,
+			.version = FE_LOG_VERSION,
+			.sample_size = sizeof(struct fe_log_sample),
+			.n_fe = n_devs,
+		};
+
+		ret = fe_log_write(fd, &hdr, sizeof(hdr));
+		for (i = 0; !ret && i < n_devs; i++)
+			ret = fe_log_write(fd, &devs[i].fe, sizeof(devs[i].fe));
+	}
+	if (ret) {
+		ERROR(_("write error: %s"), strerror(-ret));
+		goto close;
+	}
+
+	signal(SIGTERM, do_timeout);
+	signal(SIGINT, do_timeout);
+
+	interval_ns = log_interval * 1000000ULL;
+	start = last_report = fe_log_now();
+	t = start;
+
+	do {
+		for (i = 0; i < n_devs; i++) {
+			struct fe_log_dev *dev = &devs[i];
+
+			if (fe_log_sample(dev->dvb->fe_parms, &s))
+				continue;
+			s.ts = fe_log_now();
+			s.fe = i;
+
+			/* Only keep the samples where something changed */
+			if (dev->has_last &&
+			    !memcmp(&s.status, &dev->last.status,
+				    sizeof(s) - offsetof(struct fe_log_sample, status)))
+				continue;
+			dev->last = s;
+			dev->has_last = 1;
+
+			fe_log_window_add(&dev->win, &s);
+			block[n_block++] = s;
+			if (n_block == FE_LOG_BLOCK) {
+				ret = fe_log_flush(fd, block, n_block, devs);
+				n_block = 0;
+				if (ret)
+					break;
+			}
+		}
+		if (ret)
+			break;
+
+		now = fe_log_now();
+		if (now - last_report >= FE_LOG_REPORT_NS) {
+			ret = fe_log_flush(fd, block, n_block, devs);
+			n_block = 0;
+			if (ret)
+				break;
+			for (i = 0; i < n_devs; i++)
+				fe_log_report(&devs[i], now - last_report);
+			last_report = now;
+		}
+
+		if (count > 0 && !--count)
+			break;
+
+		/* Keep a steady sampling rate, without catching up */
+		t += interval_ns;
+		if (t < now)
+			t = now;
+		next.tv_sec = t / 1000000000ULL;
+		next.tv_nsec = t % 1000000000ULL;
+		if (!timeout_flag)
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+	} while (!timeout_flag);
+
+	if (!ret)
+		ret = fe_log_flush(fd, block, n_block, devs);
+	if (ret)
+		ERROR(_("write error: %s"), strerror(-ret));
+
+close:
+	if (fd != STDOUT_FILENO)
+		close(fd);
+ret:
+	for (i = 0; i < n_devs; i++) {
+		if (devs[i].dvb)
+			dvb_dev_free(devs[i].dvb);
+		free(devs[i].win.ring);
+	}
+
+	return ret ? -1 : 0;
+}
+
+/* Converts a binary log to CSV, on stdout */
+static int fe_log_dump(void)
+{
+	static struct fe_log_sample block[FE_LOG_BLOCK];
+	struct fe_log_dev devs[FE_LOG_MAX_FE] = {};
+	struct fe_log_header hdr;
+	FILE *fp;
+	size_t n;
+	unsigned i;
+	int ret = -1;
+
+	fp = fopen(log_dump, "r");
+	if (!fp) {
+		ERROR(_("can't open %s: %s"), log_dump, strerror(errno));
+		return -1;
+	}
+
+	if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+	    memcmp(hdr.magic, FE_LOG_MAGIC, sizeof(hdr.magic)) ||
+	    hdr.version != FE_LOG_VERSION ||
+	    hdr.sample_size != sizeof(struct fe_log_sample) ||
+	    hdr.n_fe > FE_LOG_MAX_FE) {
+		ERROR(_("%s is not a dvb-fe-tool binary log"), log_dump);
+		goto ret;
+	}
+	for (i = 0; i < hdr.n_fe; i++) {
+		if (fread(&devs[i].fe, sizeof(devs[i].fe), 1, fp) != 1) {
+			ERROR(_("%s: truncated header"), log_dump);
+			goto ret;
+		}
+	}
+
+	log_csv = 1;
+	ret = fe_log_write(STDOUT_FILENO, fe_log_csv_header,
+			   sizeof(fe_log_csv_header) - 1);
+	while (!ret && (n = fread(block, sizeof(*block), FE_LOG_BLOCK, fp))) {
+		for (i = 0; i < n; i++) {
+			if (block[i].fe >= hdr.n_fe) {
+				ERROR(_("%s: invalid frontend index"), log_dump);
+				ret = -EINVAL;
+				break;
+			}
+		}
+		if (!ret)
+			ret = fe_log_flush(STDOUT_FILENO, block, n, devs);
+	}
+ret:
+	fclose(fp);
+	return ret ? -1 : 0;
+}
+
 static const char * const event_type[] = {
 	[DVB_DEV_ADD] = "added",
 	[DVB_DEV_CHANGE] = "changed",
@@ -332,6 +1022,11 @@ int main(int argc, char *argv[])
 	 * If called without any option, be verbose, to print the
 	 * DVB frontend information.
 	 */
+	if (log_dump)
+		return fe_log_dump();
+	if (log_file)
+		return fe_log_run();
+
 	if (!get && !delsys && !set_params && !femon)
 		verbose++;
 
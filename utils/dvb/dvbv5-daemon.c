@@ -54,6 +54,7 @@
 #include "../../lib/libdvbv5/dvb-dev-priv.h"
 #include "libdvbv5/dvb-file.h"
 #include "libdvbv5/dvb-dev.h"
+#include "usdt.h"
 
 #ifdef ENABLE_NLS
 # define _(string) gettext(string)
@@ -1400,8 +1401,10 @@ static void *start_server(void *fd_pointer)
 		while (method->name) {
 			if (!strcmp(cmd, method->name)) {
 				if (dvb_fd > 0 || method->locks_dvb) {
+					USDT(dvbv5_daemon, cmd_start, seq, cmd, size);
 					ret = method->handler(seq, cmd,
 							      fd, p, size);
+					USDT(dvbv5_daemon, cmd_end, seq, cmd, ret);
 					if (ret < 0)
 						break;
 					if (method->locks_dvb)
@@ -48,6 +48,7 @@
 #include <argp.h>
 #include <sys/time.h>
 #include <time.h>
+#include <pthread.h>
 
 #include <config.h>
 
@@ -69,9 +70,15 @@
 #include "libdvbv5/dvb-dev.h"
 #include "libdvbv5/dvb-scan.h"
 #include "libdvbv5/header.h"
+#include "libdvbv5/crc32.h"
+#include "libdvbv5/descriptors.h"
+#include "libdvbv5/pat.h"
+#include "libdvbv5/pmt.h"
 #include "libdvbv5/countries.h"
 
 #define CHANNEL_FILE	"channels.conf"
+#define LOCK_POLL_USEC	20000
+#define EXTRACT_MAX_OUTPUTS	32
 #define PROGRAM_NAME	"dvbv5-zap"
 
 
@@ -85,6 +92,10 @@ const int NANO_SECONDS_IN_SEC = 1000000000;
 const char *argp_program_version = PROGRAM_NAME " version " V4L_UTILS_VERSION;
 const char *argp_program_bug_address = "Mauro Carvalho Chehab <mchehab@kernel.org>";
 
+struct extract_arg {
+	char *channel, *fname;
+};
+
 struct arguments {
 	char *confname, *lnb_name, *output, *demux_dev, *dvr_dev, *dvr_fname;
 	char *filename, *dvr_pipe;
@@ -95,8 +106,11 @@ struct arguments {
 	unsigned n_apid, n_vpid, extra_pids, all_pids;
 	enum dvb_file_formats input_format, output_format;
 	unsigned traffic_monitor, low_traffic, non_human, port;
-	char *search, *server;
+	char *search, *server, *pid_cache;
 	const char *cc;
+	unsigned timing;
+	struct extract_arg *extract;
+	unsigned n_extract;
 
 	/* Used by status print */
 	unsigned n_status_lines;
@@ -107,6 +121,7 @@ static const struct argp_option options[] = {
 	{"audio_pid",	'A', N_("audio_pid#"),		0, N_("audio pid program to use (default 0)"), 0},
 	{"channels",	'c', N_("file"),		0, N_("read channels list from 'file'"), 0},
 	{"extra-pids",	'E', NULL,			0, N_("output all channel pids"), 0 },
+	{"extract",	'e', N_("channel=file"),	0, N_("write the service of 'channel' as a single program TS to 'file' (can be used more than once)"), 0},
 	{"demux",	'd', N_("demux#"),		0, N_("use given demux (default 0)"), 0},
 	{"frontend",	'f', N_("frontend#"),		0, N_("use given frontend (default 0)"), 0},
 	{"input-format", 'I',	N_("format"),		0, N_("Input format: ZAP, CHANNEL, DVBV5 (default: DVBV5)"), 0},
@@ -132,6 +147,8 @@ static const struct argp_option options[] = {
 	{"server",	'H', N_("SERVER"),		0, N_("dvbv5-daemon host IP address"), 0},
 	{"tcp-port",	'T', N_("PORT"),		0, N_("dvbv5-daemon host tcp port"), 0},
 	{"dvr-pipe",	'D', N_("PIPE"),		0, N_("Named pipe for DVR output, when using remote access (by default: /tmp/dvr-pipe)"), 0},
+	{"pid-cache",	'k', N_("file"),		0, N_("keep the PMT and elementary stream PIDs of each channel at 'file', in order to zap faster"), 0},
+	{"timing",	'M', NULL,			0, N_("show how long it took to tune, to lock and to receive the first packet"), 0},
 	{"help",        '?', 0,				0, N_("Give this help list"), -1},
 	{"usage",	-3,  0,				0, N_("Give a short usage message")},
 	{"version",	-4,  0,				0, N_("Print program version"), -1},
@@ -166,6 +183,28 @@ static int timeout_flag = 0;
 	} while (0)
 
 
+static struct dvb_entry *find_channel(struct dvb_file *dvb_file,
+				      const char *channel)
+{
+	struct dvb_entry *entry;
+
+	for (entry = dvb_file->first_entry; entry != NULL; entry = entry->next) {
+		if (entry->channel && !strcmp(entry->channel, channel))
+			return entry;
+		if (entry->vchannel && !strcmp(entry->vchannel, channel))
+			return entry;
+	}
+	/*
+	 * Give a second shot, using a case insensitive seek
+	 */
+	for (entry = dvb_file->first_entry; entry != NULL; entry = entry->next) {
+		if (entry->channel && !strcasecmp(entry->channel, channel))
+			return entry;
+	}
+
+	return NULL;
+}
+
 /*
  * Find channel configuration.
  * On success, the caller must dvb_file_free(*out_file).
@@ -174,7 +213,7 @@ static int parse(struct arguments *args,
 		 struct dvb_v5_fe_parms *parms,
 		 const char *channel,
 		 struct dvb_file **out_file,
-		 const struct dvb_entry **out_entry)
+		 struct dvb_entry **out_entry)
 {
 	struct dvb_file *dvb_file;
 	struct dvb_entry *entry;
@@ -211,22 +250,7 @@ static int parse(struct arguments *args,
 	if (!dvb_file)
 		return -2;
 
-	for (entry = dvb_file->first_entry; entry != NULL; entry = entry->next) {
-		if (entry->channel && !strcmp(entry->channel, channel))
-			break;
-		if (entry->vchannel && !strcmp(entry->vchannel, channel))
-			break;
-	}
-	/*
-	 * Give a second shot, using a case insensitive seek
-	 */
-	if (!entry) {
-		for (entry = dvb_file->first_entry; entry != NULL;
-		     entry = entry->next) {
-			if (entry->channel && !strcasecmp(entry->channel, channel))
-				break;
-		}
-	}
+	entry = find_channel(dvb_file, channel);
 
 	/*
 	 * When this tool is used to just tune to a channel, to monitor it or
@@ -486,7 +510,7 @@ static int print_frontend_stats(FILE *fd,
 static int check_frontend(struct arguments *args,
 			  struct dvb_v5_fe_parms *parms)
 {
-	int rc;
+	int rc, polls = 0;
 	fe_status_t status = 0;
 	do {
 		rc = dvb_fe_get_stats(parms);
@@ -503,11 +527,16 @@ static int check_frontend(struct arguments *args,
 			usleep(1000000);
 			continue;
 		}
-		if (!args->silent)
-			print_frontend_stats(stderr, args, parms);
 		if (status & FE_HAS_LOCK)
 			break;
-		usleep(1000000);
+
+		/*
+		 * Poll the lock often, in order to not delay the zap, but
+		 * keep printing the stats once per second.
+		 */
+		if (!args->silent && !(polls++ % (1000000 / LOCK_POLL_USEC)))
+			print_frontend_stats(stderr, args, parms);
+		usleep(LOCK_POLL_USEC);
 	} while (!timeout_flag);
 	if (args->silent < 2)
 		print_frontend_stats(stderr, args, parms);
@@ -551,19 +580,627 @@ static struct timespec *elapsed_time(struct timespec *start)
 	return &elapsed;
 }
 
+/*
+ * Timing of the zap steps, shown with --timing. All times are counted
+ * from the moment the frontend starts to be tuned.
+ */
+static struct timespec zap_start;
+static int show_timing;
+
+static void timing_mark(const char *step)
+{
+	struct timespec now;
+	double ms;
+
+	if (!show_timing)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ms = (now.tv_sec - zap_start.tv_sec) * 1000.
+	     + (now.tv_nsec - zap_start.tv_nsec) * 1. / 1000000;
+	fprintf(stderr, _("timing: %s after %.1f ms\n"), step, ms);
+}
+
+/*
+ * The PID validation thread opens and closes demux devices while the
+ * main thread may still be opening the DVR. Both change the list of
+ * open devices, so they need to be serialized.
+ */
+static pthread_mutex_t dev_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct dvb_open_descriptor *zap_dev_open(struct dvb_device *dvb,
+						const char *sysname, int flags)
+{
+	struct dvb_open_descriptor *fd;
+
+	pthread_mutex_lock(&dev_lock);
+	fd = dvb_dev_open(dvb, sysname, flags);
+	pthread_mutex_unlock(&dev_lock);
+
+	return fd;
+}
+
+static void zap_dev_close(struct dvb_open_descriptor *fd)
+{
+	pthread_mutex_lock(&dev_lock);
+	dvb_dev_close(fd);
+	pthread_mutex_unlock(&dev_lock);
+}
+
+static int add_pid_filter(struct dvb_device *dvb, struct arguments *args,
+			  uint16_t pid, dmx_pes_type_t type, const char *name)
+{
+	struct dvb_open_descriptor *fd;
+
+	fd = zap_dev_open(dvb, args->demux_dev, O_RDWR);
+	if (!fd) {
+		ERROR("failed opening '%s'", args->demux_dev);
+		return -1;
+	}
+
+	if (args->silent < 2)
+		fprintf(stderr, _("%s pid %d\n"), name, pid);
+
+	return dvb_dev_dmx_set_pesfilter(fd, pid, type,
+				args->dvr ? DMX_OUT_TS_TAP : DMX_OUT_DECODER,
+				args->dvr ? 64 * 1024 : 0);
+}
+
+/*
+ * PID cache
+ *
+ * When the PIDs aren't at the channel file, or when the PAT and PMT are
+ * recorded, zapping needs to wait for the PAT and then for the PMT of the
+ * service, which takes a good fraction of a second after the lock. With
+ * --pid-cache, what those tables said at the last zap of each channel is
+ * kept at a file, one channel per line, with tab-separated fields:
+ *
+ *	channel, frequency, service ID, PMT PID, PCR PID, PMT version, PIDs
+ *
+ * PIDs is a space-separated list of <kind><stream type>:<PID>, where kind
+ * is V for video, A for audio and O for other streams. With that, the PES
+ * filters are set right after tuning. The tables are still read after the
+ * lock, by a separate thread, which refreshes the cache and adds filters
+ * for the PIDs that the cached data missed.
+ */
+#define PID_CACHE_MAX_ES	32
+#define PID_CACHE_TIMEOUT	2	/* seconds, for each table */
+
+struct pid_cache_es {
+	uint16_t pid;
+	uint8_t kind;
+	uint8_t type;
+};
+
+struct pid_cache_entry {
+	char *channel;
+	uint32_t freq;
+	uint16_t service_id;
+	uint16_t pmt_pid;
+	uint16_t pcr_pid;
+	int version;		/* -1 if the PMT was never read */
+	unsigned n_es;
+	struct pid_cache_es es[PID_CACHE_MAX_ES];
+	struct pid_cache_entry *next;
+};
+
+static struct pid_cache_entry *pid_cache;
+
+static void pid_cache_add_es(struct pid_cache_entry *c, uint8_t kind,
+			     uint8_t type, uint16_t pid)
+{
+	if (c->n_es == PID_CACHE_MAX_ES)
+		return;
+
+	c->es[c->n_es].kind = kind;
+	c->es[c->n_es].type = type;
+	c->es[c->n_es].pid = pid;
+	c->n_es++;
+}
+
+static void pid_cache_load(const char *fname)
+{
+	struct pid_cache_entry *c, **tail = &pid_cache;
+	char line[4096], *fields[7], *p, *tok, *save;
+	unsigned type, pid;
+	char kind;
+	FILE *fp;
+	int i;
+
+	fp = fopen(fname, "r");
+	if (!fp)
+		return;
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+		line[strcspn(line, "\n")] = '\0';
+
+		p = line;
+		for (i = 0; i < 7; i++) {
+			fields[i] = strsep(&p, "\t");
+			if (!fields[i])
+				break;
+		}
+		if (i < 7)
+			continue;
+
+		c = calloc(1, sizeof(*c));
+		if (!c)
+			break;
+		c->channel = strdup(fields[0]);
+		c->freq = strtoul(fields[1], NULL, 0);
+		c->service_id = strtoul(fields[2], NULL, 0);
+		c->pmt_pid = strtoul(fields[3], NULL, 0);
+		c->pcr_pid = strtoul(fields[4], NULL, 0);
+		c->version = strtol(fields[5], NULL, 0);
+
+		for (tok = strtok_r(fields[6], " ", &save); tok;
+		     tok = strtok_r(NULL, " ", &save)) {
+			if (sscanf(tok, "%c%x:%u", &kind, &type, &pid) == 3)
+				pid_cache_add_es(c, kind, type, pid);
+		}
+
+		*tail = c;
+		tail = &c->next;
+	}
+	fclose(fp);
+}
+
+static int pid_cache_save(const char *fname)
+{
+	struct pid_cache_entry *c;
+	char *tmp;
+	FILE *fp;
+	unsigned i;
+	int ret;
+
+	if (asprintf(&tmp, "%s.tmp", fname) < 0)
+		return -1;
+
+	fp = fopen(tmp, "w");
+	if (!fp) {
+		PERROR(_("can't write the PID cache '%s'"), tmp);
+		free(tmp);
+		return -1;
+	}
+
+	fprintf(fp, "# dvbv5-zap PID cache\n");
+	fprintf(fp, "# channel\tfrequency\tservice ID\tPMT PID\tPCR PID\tPMT version\tPIDs\n");
+	for (c = pid_cache; c; c = c->next) {
+		fprintf(fp, "%s\t%u\t%u\t%u\t%u\t%d\t", c->channel, c->freq,
+			c->service_id, c->pmt_pid, c->pcr_pid, c->version);
+		for (i = 0; i < c->n_es; i++)
+			fprintf(fp, "%s%c%02x:%u", i ? " " : "", c->es[i].kind,
+				c->es[i].type, c->es[i].pid);
+		fprintf(fp, "\n");
+	}
+
+	/* Replace the file at once, as other zaps may be reading it */
+	ret = fclose(fp);
+	if (!ret)
+		ret = rename(tmp, fname);
+	if (ret) {
+		PERROR(_("can't write the PID cache '%s'"), fname);
+		unlink(tmp);
+	}
+	free(tmp);
+
+	return ret;
+}
+
+static void pid_cache_free(void)
+{
+	struct pid_cache_entry *c;
+
+	while (pid_cache) {
+		c = pid_cache;
+		pid_cache = c->next;
+		free(c->channel);
+		free(c);
+	}
+}
+
+static struct pid_cache_entry *pid_cache_find(const char *channel,
+					      uint32_t freq,
+					      uint16_t service_id)
+{
+	struct pid_cache_entry *c;
+
+	for (c = pid_cache; c; c = c->next) {
+		if (c->freq == freq && c->service_id == service_id &&
+		    !strcmp(c->channel, channel))
+			return c;
+	}
+	return NULL;
+}
+
+static int pid_cache_same(const struct pid_cache_entry *a,
+			  const struct pid_cache_entry *b)
+{
+	return a->pmt_pid == b->pmt_pid && a->pcr_pid == b->pcr_pid &&
+	       a->version == b->version && a->n_es == b->n_es &&
+	       !memcmp(a->es, b->es, a->n_es * sizeof(*a->es));
+}
+
+/*
+ * Stores the entry at the cache. Returns 1 if the cache changed, and
+ * should be written back to the file.
+ */
+static int pid_cache_store(const struct pid_cache_entry *new)
+{
+	struct pid_cache_entry *c, *next, **tail;
+	char *channel;
+
+	c = pid_cache_find(new->channel, new->freq, new->service_id);
+	if (c) {
+		if (pid_cache_same(c, new))
+			return 0;
+		channel = c->channel;
+		next = c->next;
+		*c = *new;
+		c->channel = channel;
+		c->next = next;
+		return 1;
+	}
+
+	c = malloc(sizeof(*c));
+	if (!c)
+		return 0;
+	*c = *new;
+	c->channel = strdup(new->channel);
+	c->next = NULL;
+
+	for (tail = &pid_cache; *tail; tail = &(*tail)->next);
+	*tail = c;
+
+	return 1;
+}
+
+static void pid_cache_from_entry(struct pid_cache_entry *c,
+				 const struct dvb_entry *entry, uint32_t freq)
+{
+	int i;
+
+	memset(c, 0, sizeof(*c));
+	c->channel = entry->channel;
+	c->freq = freq;
+	c->service_id = entry->service_id;
+	c->version = -1;
+
+	for (i = 0; i < entry->video_pid_len; i++)
+		pid_cache_add_es(c, 'V', 0, entry->video_pid[i]);
+	for (i = 0; i < entry->audio_pid_len; i++)
+		pid_cache_add_es(c, 'A', 0, entry->audio_pid[i]);
+	for (i = 0; i < entry->other_el_pid_len; i++)
+		pid_cache_add_es(c, 'O', entry->other_el_pid[i].type,
+				 entry->other_el_pid[i].pid);
+}
+
+static uint8_t pid_cache_kind(struct dvb_table_pmt_stream *stream)
+{
+	switch (stream->type) {
+	case 0x01: /* ISO/IEC 11172-2 Video */
+	case 0x02: /* H.262, ISO/IEC 13818-2 or ISO/IEC 11172-2 video */
+	case 0x1b: /* H.264 AVC */
+	case 0x24: /* HEVC */
+	case 0x42: /* CAVS */
+	case 0x80: /* MPEG-2 MOTO video */
+		return 'V';
+	case 0x03: /* ISO/IEC 11172-3 Audio */
+	case 0x04: /* ISO/IEC 13818-3 Audio */
+	case 0x07: /* DTS and DTS-HD Audio */
+	case 0x0f: /* ISO/IEC 13818-7 Audio with ADTS (AAC) */
+	case 0x11: /* ISO/IEC 14496-3 Audio with the LATM */
+	case 0x1c: /* ISO/IEC 14496-3 Audio, without additional transport syntax */
+	case 0x81: /* A52 */
+	case 0x87: /* E-AC3 */
+		return 'A';
+	case 0x06: /* private data */
+		dvb_desc_find(struct dvb_desc, desc, stream, AC_3_descriptor)
+			return 'A';
+		dvb_desc_find(struct dvb_desc, desc, stream, enhanced_AC_3_descriptor)
+			return 'A';
+		break;
+	}
+	return 'O';
+}
+
+static void pid_cache_from_pmt(struct pid_cache_entry *c,
+			       struct dvb_table_pmt *pmt)
+{
+	c->pcr_pid = pmt->pcr_pid;
+	c->version = pmt->header.version;
+	c->n_es = 0;
+
+	dvb_pmt_stream_foreach(stream, pmt)
+		pid_cache_add_es(c, pid_cache_kind(stream), stream->type,
+				 stream->elementary_pid);
+}
+
+/* Gives the cached PIDs to a channel that has none at the channel file */
+static void pid_cache_fill_entry(const struct pid_cache_entry *c,
+				 struct dvb_entry *entry)
+{
+	unsigned i;
+
+	free(entry->video_pid);
+	free(entry->audio_pid);
+	free(entry->other_el_pid);
+	entry->video_pid = calloc(c->n_es, sizeof(*entry->video_pid));
+	entry->audio_pid = calloc(c->n_es, sizeof(*entry->audio_pid));
+	entry->other_el_pid = calloc(c->n_es, sizeof(*entry->other_el_pid));
+	entry->other_el_pid_len = 0;
+	if (!entry->video_pid || !entry->audio_pid || !entry->other_el_pid)
+		return;
+
+	for (i = 0; i < c->n_es; i++) {
+		switch (c->es[i].kind) {
+		case 'V':
+			entry->video_pid[entry->video_pid_len++] = c->es[i].pid;
+			break;
+		case 'A':
+			entry->audio_pid[entry->audio_pid_len++] = c->es[i].pid;
+			break;
+		default:
+			entry->other_el_pid[entry->other_el_pid_len].type = c->es[i].type;
+			entry->other_el_pid[entry->other_el_pid_len].pid = c->es[i].pid;
+			entry->other_el_pid_len++;
+		}
+	}
+}
+
+/* The PCR needs its own filter when it isn't carried by a filtered PID */
+static int pid_cache_pcr_needed(const struct pid_cache_entry *c,
+				const uint16_t *pids, unsigned n)
+{
+	unsigned i;
+
+	if (!c->pcr_pid || c->pcr_pid == 0x1fff)
+		return 0;
+
+	for (i = 0; i < n; i++) {
+		if (pids[i] == c->pcr_pid)
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Fills pids with the PIDs that get a filter, following the same rules
+ * used for the channel file PIDs, and returns how many they are.
+ */
+static unsigned pid_cache_selected(const struct pid_cache_entry *c,
+				   const struct arguments *args,
+				   uint16_t pids[PID_CACHE_MAX_ES + 1],
+				   int with_pcr)
+{
+	unsigned i, n = 0, n_video = 0, n_audio = 0, vpid, apid;
+	int sel;
+
+	for (i = 0; i < c->n_es; i++) {
+		if (c->es[i].kind == 'V')
+			n_video++;
+		else if (c->es[i].kind == 'A')
+			n_audio++;
+	}
+	vpid = args->n_vpid < n_video ? args->n_vpid : 0;
+	apid = args->n_apid < n_audio ? args->n_apid : 0;
+
+	n_video = n_audio = 0;
+	for (i = 0; i < c->n_es; i++) {
+		if (c->es[i].kind == 'V')
+			sel = n_video++ == vpid || args->extra_pids;
+		else if (c->es[i].kind == 'A')
+			sel = n_audio++ == apid || args->extra_pids;
+		else
+			sel = args->extra_pids;
+		if (sel)
+			pids[n++] = c->es[i].pid;
+	}
+
+	if (with_pcr && pid_cache_pcr_needed(c, pids, n))
+		pids[n++] = c->pcr_pid;
+
+	return n;
+}
+
+struct pid_validate {
+	struct arguments *args;
+	struct dvb_device *dvb;
+	struct dvb_v5_fe_parms *parms;
+
+	/* What the filters were set from */
+	struct pid_cache_entry used;
+	int cached;
+
+	/* The ES filters came from the cache, or there were none */
+	int refresh;
+
+	pthread_t thread;
+	int running;
+};
+
+static void *pid_validate_thread(void *priv)
+{
+	struct pid_validate *v = priv;
+	struct arguments *args = v->args;
+	struct pid_cache_entry fresh = v->used;
+	struct dvb_table_pat *pat = NULL;
+	struct dvb_table_pmt *pmt = NULL;
+	struct dvb_open_descriptor *fd;
+	uint16_t old[PID_CACHE_MAX_ES + 1], new[PID_CACHE_MAX_ES + 1];
+	unsigned n_old, n_new, i, j;
+	int pmt_pid = -1, dmx_fd, warned = 0;
+
+	fd = zap_dev_open(v->dvb, args->demux_dev, O_RDWR);
+	if (!fd) {
+		ERROR("failed opening '%s'", args->demux_dev);
+		return NULL;
+	}
+	dmx_fd = dvb_dev_get_fd(fd);
+
+	if (dvb_read_section(v->parms, dmx_fd, DVB_TABLE_PAT, DVB_TABLE_PAT_PID,
+			     (void **)&pat, PID_CACHE_TIMEOUT) < 0 || !pat)
+		goto done;
+
+	dvb_pat_program_foreach(program, pat) {
+		if (program->service_id == fresh.service_id)
+			pmt_pid = program->pid;
+	}
+	if (pmt_pid < 0) {
+		fprintf(stderr, _("couldn't find pmt-pid for sid %04x\n"),
+			fresh.service_id);
+		goto done;
+	}
+
+	if (dvb_read_section_with_id(v->parms, dmx_fd, DVB_TABLE_PMT, pmt_pid,
+				     fresh.service_id, (void **)&pmt,
+				     PID_CACHE_TIMEOUT) < 0 || !pmt)
+		goto done;
+
+	timing_mark(_("PAT/PMT"));
+
+	fresh.pmt_pid = pmt_pid;
+	pid_cache_from_pmt(&fresh, pmt);
+
+	if (v->cached && !pid_cache_same(&fresh, &v->used) && args->silent < 2)
+		fprintf(stderr, _("cached PIDs for '%s' are outdated\n"),
+			fresh.channel);
+
+	/* Add the PIDs that the cached data missed */
+	if (v->refresh) {
+		n_old = pid_cache_selected(&v->used, args, old, 1);
+		n_new = pid_cache_selected(&fresh, args, new, 1);
+		for (i = 0; i < n_new; i++) {
+			for (j = 0; j < n_old; j++) {
+				if (new[i] == old[j])
+					break;
+			}
+			if (j < n_old)
+				continue;
+
+			/* The decoder can't take another video or audio PID */
+			if (!args->dvr) {
+				if (!warned)
+					fprintf(stderr, _("the new PIDs will be used at the next zap\n"));
+				warned = 1;
+				break;
+			}
+			add_pid_filter(v->dvb, args, new[i], DMX_PES_OTHER,
+				       _("new"));
+		}
+	}
+	if (args->rec_psi && fresh.pmt_pid != v->used.pmt_pid)
+		add_pid_filter(v->dvb, args, fresh.pmt_pid, DMX_PES_OTHER,
+			       _("pmt"));
+
+	if (pid_cache_store(&fresh))
+		pid_cache_save(args->pid_cache);
+
+done:
+	if (pat)
+		dvb_table_pat_free(pat);
+	if (pmt)
+		dvb_table_pmt_free(pmt);
+	zap_dev_close(fd);
+
+	return NULL;
+}
+
+static void pid_validate_start(struct pid_validate *v)
+{
+	if (!v->args)
+		return;
+
+	if (pthread_create(&v->thread, NULL, pid_validate_thread, v)) {
+		ERROR("can't start the PID cache validation");
+		return;
+	}
+	v->running = 1;
+}
+
+static void pid_validate_stop(struct pid_validate *v)
+{
+	if (!v->running)
+		return;
+
+	v->parms->abort = 1;
+	pthread_join(v->thread, NULL);
+	v->running = 0;
+}
+
+/*
+ * Reads the TS from the DVR, using mmapped buffers when the Kernel supports
+ * them, in order to avoid copying every TS byte to userspace. Otherwise,
+ * it falls back to read().
+ */
+struct dvr_stream {
+	struct dvb_open_descriptor *fd;
+	int mmap;
+	struct dvb_dev_buffer buf;
+	unsigned char rbuf[BUFLEN];
+};
+
+static void dvr_stream_init(struct dvr_stream *s, struct dvb_open_descriptor *fd,
+			    int silent)
+{
+	int ret;
+
+	memset(s, 0, sizeof(*s) - sizeof(s->rbuf));
+	s->fd = fd;
+	ret = dvb_dev_stream_start(fd, DVB_BUF_SIZE / BUFLEN, BUFLEN);
+	s->mmap = ret > 0;
+	if (s->mmap && silent < 2)
+		fprintf(stderr, _("  streaming with %d mmapped buffers\n"), ret);
+}
+
+/*
+ * Returns the number of bytes available at *data, or a negative error code.
+ * On success, the data must be given back with dvr_stream_put().
+ */
+static ssize_t dvr_stream_get(struct dvr_stream *s, unsigned char **data)
+{
+	int ret;
+
+	if (!s->mmap) {
+		*data = s->rbuf;
+		return dvb_dev_read(s->fd, s->rbuf, BUFLEN);
+	}
+
+	/*
+	 * Unlike read(), this can't report an overrun: when no buffer is
+	 * free, the Kernel drops the data without telling.
+	 */
+	ret = dvb_dev_stream_dqbuf(s->fd, &s->buf);
+	if (ret < 0)
+		return ret;
+	*data = s->buf.data;
+	return s->buf.bytesused;
+}
+
+static void dvr_stream_put(struct dvr_stream *s)
+{
+	if (s->mmap)
+		dvb_dev_stream_qbuf(s->fd, &s->buf);
+}
+
 static void copy_to_file(struct dvb_open_descriptor *in_fd, int out_fd,
 			 int timeout, int silent)
 {
-	char buf[BUFLEN];
+	struct dvr_stream stream;
+	unsigned char *buf;
 	int r, first = 1;
 	long long int rc = 0LL;
 	struct timespec start, *elapsed;
 
+	dvr_stream_init(&stream, in_fd, silent);
+
 	/* Initialize start time, due to -EOVERFLOW with first == 1 */
 	clock_gettime(CLOCK_MONOTONIC, &start);
 
 	while (timeout_flag == 0) {
-		r = dvb_dev_read(in_fd, buf, sizeof(buf));
+		r = dvr_stream_get(&stream, &buf);
 		if (r < 0) {
 			if (r == -EOVERFLOW) {
 				elapsed = elapsed_time(&start);
@@ -589,6 +1226,7 @@ static void copy_to_file(struct dvb_open_descriptor *in_fd, int out_fd,
 		 * So, let's reset the start time here.
 		 */
 		if (first) {
+			timing_mark(_("first packet"));
 			if (timeout > 0)
 				alarm(timeout);
 
@@ -600,6 +1238,7 @@ static void copy_to_file(struct dvb_open_descriptor *in_fd, int out_fd,
 			PERROR(_("Write failed"));
 			break;
 		}
+		dvr_stream_put(&stream);
 
 		rc += r;
 	}
@@ -718,6 +1357,32 @@ static error_t parse_opt(int k, char *optarg, struct argp_state *state)
 	case 'D':
 		args->dvr_pipe = strdup(optarg);
 		break;
+	case 'k':
+		args->pid_cache = strdup(optarg);
+		break;
+	case 'e': {
+		struct extract_arg *e;
+		char *p = strrchr(optarg, '=');
+
+		if (!p || p == optarg || !p[1])
+			argp_error(state, _("--extract needs channel=file"));
+		if (args->n_extract == EXTRACT_MAX_OUTPUTS)
+			argp_error(state, _("up to %d services can be extracted"),
+				   EXTRACT_MAX_OUTPUTS);
+
+		e = realloc(args->extract,
+			    (args->n_extract + 1) * sizeof(*args->extract));
+		if (!e)
+			return ENOMEM;
+		args->extract = e;
+		e = &args->extract[args->n_extract++];
+		e->channel = strndup(optarg, p - optarg);
+		e->fname = strdup(p + 1);
+		break;
+	}
+	case 'M':
+		args->timing = 1;
+		break;
 	case '?':
 		argp_state_help(state, state->out_stream,
 				ARGP_HELP_SHORT_USAGE | ARGP_HELP_LONG
@@ -766,6 +1431,7 @@ int do_traffic_monitor(struct arguments *args, struct dvb_device *dvb,
 		       int out_fd, int timeout)
 {
 	struct dvb_open_descriptor *fd, *dvr_fd;
+	struct dvr_stream stream;
 	struct timespec startt;
 	struct dvb_v5_fe_parms *parms = dvb->fe_parms;
 	unsigned long long pidt[0x2001], wait, cont_err = 0;
@@ -809,17 +1475,19 @@ int do_traffic_monitor(struct arguments *args, struct dvb_device *dvb,
 
 	wait = 1000;
 
+	dvr_stream_init(&stream, dvr_fd, args->silent);
+
 	monitor_log(_("%.2fs: Starting capture\n"));
 	while (1) {
 		struct timespec *elapsed;
-		unsigned char buffer[BUFLEN];
+		unsigned char *buffer;
 		int pid, ok, diff;
 		ssize_t r;
 
 		if (timeout_flag)
 			break;
 
-		if ((r = dvb_dev_read(dvr_fd, buffer, BUFLEN)) <= 0) {
+		if ((r = dvr_stream_get(&stream, &buffer)) <= 0) {
 			if (r == -EOVERFLOW) {
 				monitor_log(_("%.2fs: buffer overrun\n"));
 				continue;
@@ -942,6 +1610,7 @@ int do_traffic_monitor(struct arguments *args, struct dvb_device *dvb,
 				pidt[0x2000]++;
 			}
 		}
+		dvr_stream_put(&stream);
 
 		elapsed = elapsed_time(&startt);
 		if (!elapsed)
@@ -1014,6 +1683,572 @@ int do_traffic_monitor(struct arguments *args, struct dvb_device *dvb,
 	return 0;
 }
 
+/*
+ * Service extraction
+ *
+ * With --extract, the whole multiplex is read from the DVR only once, and
+ * split into one single program transport stream per requested service.
+ * Each output gets a PAT regenerated with just its program, its own PMT
+ * and the packets of the PIDs listed at that PMT, including the PCR. The
+ * PMT sections are reassembled, checked and packetized again, as the PMT
+ * PID may be shared with other services. Each output has a ring buffer,
+ * written to its file by a thread of its own, in order to not stop
+ * reading the DVR while some disk is busy.
+ */
+#define TS_PACKET_SIZE		188
+#define EXTRACT_RING_SIZE	(TS_PACKET_SIZE * 16384)
+
+struct ts_section {
+	uint8_t buf[4096];
+	unsigned len;
+	int active, cc;
+};
+
+typedef void (*ts_section_cb)(void *priv, uint8_t *sect, unsigned len);
+
+struct ts_output {
+	struct ts_extract *x;
+	const char *channel, *fname;
+	unsigned bit;
+	uint16_t service_id;
+
+	/* From the PAT and the PMT */
+	int pmt_pid;
+	struct ts_section pmt_sect;
+	uint8_t pmt[1024];
+	unsigned pmt_len;
+	uint16_t pids[256];
+	unsigned n_pids;
+	uint8_t pat_version, pat_cc, pmt_cc;
+
+	/*
+	 * Only the main thread touches head and tail_seen. The writer
+	 * thread gets the data up to pub_head, under the lock.
+	 */
+	uint8_t *ring;
+	size_t head, tail_seen, pub_head, tail;
+	int fd, done, error;
+	pthread_t writer;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	unsigned long long dropped;
+};
+
+struct ts_extract {
+	struct arguments *args;
+	struct ts_output *out;
+	unsigned n_out;
+	uint16_t tsid;
+	int has_pat;
+	struct ts_section pat_sect;
+
+	/* Bitmasks of the outputs that want each PID */
+	uint32_t es_mask[0x2000];
+	uint32_t pmt_mask[0x2000];
+};
+
+static unsigned ts_section_add(struct ts_section *s, const uint8_t *data,
+			       unsigned size, ts_section_cb cb, void *priv)
+{
+	unsigned used = 0, want, n;
+
+	while (used < size && s->active) {
+		want = 3;
+		if (s->len >= 3) {
+			want += ((s->buf[1] & 0x0f) << 8) | s->buf[2];
+			/* Too small to have a header and a CRC, or too big */
+			if (want < 3 + 9 || want > sizeof(s->buf)) {
+				s->active = 0;
+				break;
+			}
+		}
+
+		n = want - s->len;
+		if (n > size - used)
+			n = size - used;
+		memcpy(s->buf + s->len, data + used, n);
+		s->len += n;
+		used += n;
+
+		if (s->len == want && want > 3) {
+			cb(priv, s->buf, s->len);
+			s->active = 0;
+		}
+	}
+	if (!s->active)
+		s->len = 0;
+
+	return used;
+}
+
+/* Reassembles the sections of a PID, calling cb for every complete one */
+static void ts_section_feed(struct ts_section *s, const uint8_t *pkt,
+			    ts_section_cb cb, void *priv)
+{
+	const uint8_t *p = pkt + 4, *end = pkt + TS_PACKET_SIZE;
+	int pusi = pkt[1] & 0x40, cc = pkt[3] & 0x0f;
+	unsigned pointer;
+
+	if (pkt[3] & 0x20)
+		p += 1 + p[0];
+	if (!(pkt[3] & 0x10) || p >= end)
+		return;
+
+	/* A lost packet means a broken section */
+	if (s->active && cc != ((s->cc + 1) & 0x0f)) {
+		s->active = 0;
+		s->len = 0;
+	}
+	s->cc = cc;
+
+	if (pusi) {
+		pointer = *p++;
+		if (p + pointer > end) {
+			s->active = 0;
+			s->len = 0;
+			return;
+		}
+		if (s->active)
+			ts_section_add(s, p, pointer, cb, priv);
+		p += pointer;
+		s->active = 1;
+		s->len = 0;
+	}
+
+	while (p < end && s->active) {
+		p += ts_section_add(s, p, end - p, cb, priv);
+
+		/* More sections may follow, up to the stuffing bytes */
+		if (!s->active && pusi && p < end && *p != 0xff)
+			s->active = 1;
+	}
+}
+
+static int ts_section_valid(const uint8_t *sect, unsigned len)
+{
+	/* current_next_indicator, and the CRC of the whole section */
+	return (sect[5] & 0x01) && !dvb_crc32((uint8_t *)sect, len, 0xffffffff);
+}
+
+static void *ts_output_writer(void *priv)
+{
+	struct ts_output *o = priv;
+	size_t head, tail, n;
+	ssize_t ret;
+	int done;
+
+	while (1) {
+		pthread_mutex_lock(&o->lock);
+		while (o->tail == o->pub_head && !o->done)
+			pthread_cond_wait(&o->cond, &o->lock);
+		head = o->pub_head;
+		tail = o->tail;
+		done = o->done;
+		pthread_mutex_unlock(&o->lock);
+
+		if (head == tail && done)
+			break;
+
+		/* Up to the end of the data, or of the ring */
+		n = head - tail;
+		if (n > EXTRACT_RING_SIZE - tail % EXTRACT_RING_SIZE)
+			n = EXTRACT_RING_SIZE - tail % EXTRACT_RING_SIZE;
+
+		ret = write(o->fd, o->ring + tail % EXTRACT_RING_SIZE, n);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			PERROR(_("Write to '%s' failed"), o->fname);
+			pthread_mutex_lock(&o->lock);
+			o->error = 1;
+			pthread_mutex_unlock(&o->lock);
+			break;
+		}
+
+		pthread_mutex_lock(&o->lock);
+		o->tail += ret;
+		pthread_mutex_unlock(&o->lock);
+	}
+
+	return NULL;
+}
+
+static void ts_output_put(struct ts_output *o, const uint8_t *pkt)
+{
+	if (o->head - o->tail_seen + TS_PACKET_SIZE > EXTRACT_RING_SIZE) {
+		o->dropped++;
+		return;
+	}
+
+	/* The ring size is a multiple of the packet size */
+	memcpy(o->ring + o->head % EXTRACT_RING_SIZE, pkt, TS_PACKET_SIZE);
+	o->head += TS_PACKET_SIZE;
+}
+
+/*
+ * Hands what was put since the last call to the writer, and picks up the
+ * space it freed meanwhile. The latter is needed even if nothing was put:
+ * once the ring is full, ts_output_put() drops everything until then.
+ */
+static void ts_output_flush(struct ts_output *o)
+{
+	pthread_mutex_lock(&o->lock);
+	o->tail_seen = o->tail;
+	if (o->head != o->pub_head) {
+		o->pub_head = o->head;
+		pthread_cond_signal(&o->cond);
+	}
+	pthread_mutex_unlock(&o->lock);
+}
+
+static void ts_output_section(struct ts_output *o, uint16_t pid, uint8_t *cc,
+			      const uint8_t *sect, unsigned len)
+{
+	uint8_t pkt[TS_PACKET_SIZE], *p;
+	unsigned off = 0, n;
+
+	while (off < len) {
+		pkt[0] = 0x47;
+		pkt[1] = (off ? 0 : 0x40) | pid >> 8;
+		pkt[2] = pid & 0xff;
+		pkt[3] = 0x10 | *cc;
+		*cc = (*cc + 1) & 0x0f;
+
+		p = pkt + 4;
+		if (!off)
+			*p++ = 0;	/* pointer_field */
+
+		n = len - off;
+		if (n > pkt + TS_PACKET_SIZE - p)
+			n = pkt + TS_PACKET_SIZE - p;
+		memcpy(p, sect + off, n);
+		memset(p + n, 0xff, pkt + TS_PACKET_SIZE - p - n);
+		off += n;
+
+		ts_output_put(o, pkt);
+	}
+}
+
+/* Writes a PAT with just the output program, followed by its PMT */
+static void ts_output_psi(struct ts_output *o)
+{
+	uint8_t pat[16];
+	uint32_t crc;
+
+	pat[0] = 0x00;				/* table_id */
+	pat[1] = 0xb0;				/* section_length: 13 */
+	pat[2] = 13;
+	pat[3] = o->x->tsid >> 8;
+	pat[4] = o->x->tsid & 0xff;
+	pat[5] = 0xc1 | (o->pat_version & 0x1f) << 1;
+	pat[6] = 0;				/* section_number */
+	pat[7] = 0;				/* last_section_number */
+	pat[8] = o->service_id >> 8;
+	pat[9] = o->service_id & 0xff;
+	pat[10] = 0xe0 | o->pmt_pid >> 8;
+	pat[11] = o->pmt_pid & 0xff;
+
+	crc = dvb_crc32(pat, 12, 0xffffffff);
+	pat[12] = crc >> 24;
+	pat[13] = crc >> 16;
+	pat[14] = crc >> 8;
+	pat[15] = crc;
+
+	ts_output_section(o, 0, &o->pat_cc, pat, sizeof(pat));
+	ts_output_section(o, o->pmt_pid, &o->pmt_cc, o->pmt, o->pmt_len);
+}
+
+static void ts_output_add_pid(struct ts_output *o, uint16_t pid)
+{
+	/* The PCR is usually carried by the video PID */
+	if (pid >= 0x1fff || o->n_pids == ARRAY_SIZE(o->pids) ||
+	    o->x->es_mask[pid] & 1U << o->bit)
+		return;
+
+	o->pids[o->n_pids++] = pid;
+	o->x->es_mask[pid] |= 1U << o->bit;
+}
+
+static void extract_pmt(void *priv, uint8_t *sect, unsigned len)
+{
+	struct ts_output *o = priv;
+	unsigned i, info_len, es_len;
+	uint8_t *p, *end = sect + len - 4;
+
+	if (sect[0] != 0x02 || len > sizeof(o->pmt) ||
+	    ((sect[3] << 8) | sect[4]) != o->service_id ||
+	    !ts_section_valid(sect, len))
+		return;
+
+	if (len == o->pmt_len && !memcmp(sect, o->pmt, len))
+		return;
+
+	memcpy(o->pmt, sect, len);
+	o->pmt_len = len;
+
+	for (i = 0; i < o->n_pids; i++)
+		o->x->es_mask[o->pids[i]] &= ~(1U << o->bit);
+	o->n_pids = 0;
+
+	ts_output_add_pid(o, ((sect[8] & 0x1f) << 8) | sect[9]);
+
+	info_len = ((sect[10] & 0x0f) << 8) | sect[11];
+	for (p = sect + 12 + info_len; p + 5 <= end; p += 5 + es_len) {
+		es_len = ((p[3] & 0x0f) << 8) | p[4];
+		ts_output_add_pid(o, ((p[1] & 0x1f) << 8) | p[2]);
+	}
+
+	if (o->x->args->silent < 2)
+		fprintf(stderr, _("%s: PMT version %d, %d pids\n"),
+			o->channel, (sect[5] >> 1) & 0x1f, o->n_pids);
+
+	/* Start the output, or let the players know about the change */
+	ts_output_psi(o);
+}
+
+static void extract_pat(void *priv, uint8_t *sect, unsigned len)
+{
+	struct ts_extract *x = priv;
+	struct ts_output *o;
+	uint16_t tsid = (sect[3] << 8) | sect[4];
+	uint8_t *p, *end = sect + len - 4;
+	int pid;
+	unsigned i;
+
+	if (sect[0] != 0x00 || !ts_section_valid(sect, len))
+		return;
+
+	for (p = sect + 8; p + 4 <= end; p += 4) {
+		pid = ((p[2] & 0x1f) << 8) | p[3];
+
+		for (i = 0; i < x->n_out; i++) {
+			o = &x->out[i];
+			if (o->service_id != (((p[0] << 8) | p[1])) ||
+			    o->pmt_pid == pid)
+				continue;
+
+			if (o->pmt_pid >= 0)
+				x->pmt_mask[o->pmt_pid] &= ~(1U << o->bit);
+			x->pmt_mask[pid] |= 1U << o->bit;
+			o->pmt_pid = pid;
+			o->pmt_len = 0;
+			o->pmt_sect.active = 0;
+			o->pmt_sect.len = 0;
+			o->pat_version++;
+		}
+	}
+
+	if (x->has_pat && tsid != x->tsid) {
+		for (i = 0; i < x->n_out; i++)
+			x->out[i].pat_version++;
+	}
+	x->tsid = tsid;
+	x->has_pat = 1;
+
+	/* Repeat the PSI of each output as often as the multiplex does */
+	for (i = 0; i < x->n_out; i++) {
+		if (x->out[i].pmt_len)
+			ts_output_psi(&x->out[i]);
+	}
+}
+
+static void extract_packet(struct ts_extract *x, const uint8_t *pkt)
+{
+	uint16_t pid = ((pkt[1] & 0x1f) << 8) | pkt[2];
+	uint32_t mask;
+	unsigned i;
+
+	if (!pid) {
+		ts_section_feed(&x->pat_sect, pkt, extract_pat, x);
+		return;
+	}
+
+	for (mask = x->pmt_mask[pid]; mask; mask &= mask - 1) {
+		struct ts_output *o = &x->out[__builtin_ctz(mask)];
+
+		ts_section_feed(&o->pmt_sect, pkt, extract_pmt, o);
+	}
+
+	for (mask = x->es_mask[pid]; mask; mask &= mask - 1) {
+		i = __builtin_ctz(mask);
+		if (x->out[i].pmt_len)
+			ts_output_put(&x->out[i], pkt);
+	}
+}
+
+static int extract_open(struct ts_extract *x, struct dvb_file *dvb_file,
+			uint32_t freq)
+{
+	struct arguments *args = x->args;
+	struct dvb_entry *entry;
+	struct ts_output *o;
+	uint32_t f = 0;
+	unsigned i;
+
+	x->out = calloc(args->n_extract, sizeof(*x->out));
+	if (!x->out)
+		return -1;
+
+	for (i = 0; i < args->n_extract; i++) {
+		entry = find_channel(dvb_file, args->extract[i].channel);
+		if (!entry) {
+			ERROR("Can't find channel '%s'",
+			      args->extract[i].channel);
+			return -1;
+		}
+		dvb_retrieve_entry_prop(entry, DTV_FREQUENCY, &f);
+		if (f != freq) {
+			ERROR("channel '%s' is not at the tuned frequency",
+			      args->extract[i].channel);
+			return -1;
+		}
+
+		o = &x->out[i];
+		o->x = x;
+		o->bit = i;
+		o->channel = args->extract[i].channel;
+		o->fname = args->extract[i].fname;
+		o->service_id = entry->service_id;
+		o->pmt_pid = -1;
+		o->ring = malloc(EXTRACT_RING_SIZE);
+		if (!o->ring)
+			return -1;
+
+		o->fd = open(o->fname, O_LARGEFILE | O_WRONLY | O_CREAT | O_TRUNC,
+			     0644);
+		if (o->fd < 0) {
+			PERROR(_("open of '%s' failed"), o->fname);
+			return -1;
+		}
+
+		pthread_mutex_init(&o->lock, NULL);
+		pthread_cond_init(&o->cond, NULL);
+		if (pthread_create(&o->writer, NULL, ts_output_writer, o)) {
+			ERROR("can't start the writer for '%s'", o->fname);
+			close(o->fd);
+			o->fd = -1;
+			return -1;
+		}
+		x->n_out++;
+
+		if (args->silent < 2)
+			fprintf(stderr, _("extracting service %d ('%s') to '%s'\n"),
+				o->service_id, o->channel, o->fname);
+	}
+
+	return 0;
+}
+
+static void extract_close(struct ts_extract *x)
+{
+	struct ts_output *o;
+	unsigned i;
+
+	for (i = 0; i < x->n_out; i++) {
+		o = &x->out[i];
+
+		pthread_mutex_lock(&o->lock);
+		o->pub_head = o->head;
+		o->done = 1;
+		pthread_cond_signal(&o->cond);
+		pthread_mutex_unlock(&o->lock);
+		pthread_join(o->writer, NULL);
+
+		if (x->args->silent < 2)
+			fprintf(stderr, _("%s: wrote %llu bytes, dropped %llu packets\n"),
+				o->channel, (unsigned long long)o->tail,
+				o->dropped);
+
+		close(o->fd);
+		pthread_mutex_destroy(&o->lock);
+		pthread_cond_destroy(&o->cond);
+	}
+
+	if (x->out) {
+		for (i = 0; i < x->args->n_extract; i++)
+			free(x->out[i].ring);
+		free(x->out);
+	}
+}
+
+static int do_extract(struct arguments *args, struct dvb_device *dvb,
+		      struct dvb_file *dvb_file)
+{
+	struct dvb_v5_fe_parms *parms = dvb->fe_parms;
+	struct dvb_open_descriptor *fd, *dvr_fd;
+	struct dvr_stream stream;
+	struct ts_extract *x;
+	unsigned char *buf;
+	uint32_t freq = 0;
+	int first = 1, ret = -1;
+	unsigned i;
+	ssize_t r;
+
+	x = calloc(1, sizeof(*x));
+	if (!x)
+		return -1;
+	x->args = args;
+
+	dvb_fe_retrieve_parm(parms, DTV_FREQUENCY, &freq);
+	if (extract_open(x, dvb_file, freq) < 0)
+		goto done;
+
+	if (!check_frontend(args, parms)) {
+		fprintf(stderr, _("frontend doesn't lock\n"));
+		goto done;
+	}
+
+	fd = dvb_dev_open(dvb, args->demux_dev, O_RDWR);
+	if (!fd)
+		goto done;
+	if (args->silent < 2)
+		fprintf(stderr, _("  dvb_set_pesfilter to 0x2000\n"));
+	if (dvb_dev_dmx_set_pesfilter(fd, 0x2000, DMX_PES_OTHER,
+				      DMX_OUT_TS_TAP, 0) < 0)
+		goto done;
+
+	dvr_fd = dvb_dev_open(dvb, args->dvr_dev, O_RDONLY);
+	if (!dvr_fd)
+		goto done;
+	dvb_dev_set_bufsize(dvr_fd, DVB_BUF_SIZE);
+	dvr_stream_init(&stream, dvr_fd, args->silent);
+
+	while (!timeout_flag) {
+		r = dvr_stream_get(&stream, &buf);
+		if (r < 0) {
+			if (r == -EOVERFLOW) {
+				fprintf(stderr, _("buffer overrun\n"));
+				continue;
+			}
+			ERROR("Read failed");
+			break;
+		}
+
+		if (first) {
+			timing_mark(_("first packet"));
+			if (args->timeout > 0)
+				alarm(args->timeout);
+			first = 0;
+		}
+
+		for (i = 0; i + TS_PACKET_SIZE <= (size_t)r; i += TS_PACKET_SIZE) {
+			if (buf[i] == 0x47)
+				extract_packet(x, &buf[i]);
+		}
+		dvr_stream_put(&stream);
+
+		for (i = 0; i < x->n_out; i++)
+			ts_output_flush(&x->out[i]);
+	}
+	ret = 0;
+
+done:
+	extract_close(x);
+	free(x);
+
+	return ret;
+}
+
 static void set_signals(struct arguments *args)
 {
 	signal(SIGTERM, do_timeout);
@@ -1034,7 +2269,7 @@ int main(int argc, char **argv)
 	int lnb = -1, idx = -1;
 	int pmtpid = 0;
 	struct dvb_file *dvb_file = NULL;
-	const struct dvb_entry *dvb_entry = NULL;
+	struct dvb_entry *dvb_entry = NULL;
 	struct dvb_open_descriptor *pat_fd = NULL, *pmt_fd = NULL;
 	struct dvb_open_descriptor *sdt_fd = NULL;
 	struct dvb_open_descriptor *sid_fd = NULL, *dvr_fd = NULL;
@@ -1044,6 +2279,9 @@ int main(int argc, char **argv)
 	struct dvb_v5_fe_parms *parms = NULL;
 	struct dvb_device *dvb;
 	struct dvb_dev_list *dvb_dev;
+	struct pid_cache_entry *cached = NULL;
+	struct pid_validate validate = {};
+	uint32_t freq = 0;
 	const struct argp argp = {
 		.options = options,
 		.parser = parse_opt,
@@ -1070,6 +2308,8 @@ int main(int argc, char **argv)
 
 	if (idx < argc)
 		channel = argv[idx];
+	else if (args.n_extract)
+		channel = args.extract[0].channel;
 
 	if (!channel) {
 		argp_help(&argp, stderr, ARGP_HELP_STD_HELP, PROGRAM_NAME);
@@ -1088,6 +2328,14 @@ int main(int argc, char **argv)
 		return -1;
 	}
 
+	if (args.n_extract && (args.traffic_monitor || args.dvr ||
+			       args.filename || args.rec_psi ||
+			       args.exit_after_tuning)) {
+		ERROR("extract can't be used with monitor, record or exit modes\n");
+		argp_help(&argp, stderr, ARGP_HELP_STD_HELP, PROGRAM_NAME);
+		return -1;
+	}
+
 	if (args.lnb_name) {
 		lnb = dvb_sat_search_lnb(args.lnb_name);
 		if (lnb < 0) {
@@ -1170,13 +2418,55 @@ int main(int argc, char **argv)
 	if (parse(&args, parms, channel, &dvb_file, &dvb_entry))
 		goto err;
 
+	/*
+	 * The cache is only useful when the PES filters are set by this
+	 * tool. Its PIDs are used only if the channel file has none.
+	 */
+	if (args.pid_cache && dvb_entry->channel && !args.all_pids &&
+	    !args.traffic_monitor && !args.exit_after_tuning) {
+		pid_cache_load(args.pid_cache);
+		dvb_fe_retrieve_parm(parms, DTV_FREQUENCY, &freq);
+		cached = pid_cache_find(dvb_entry->channel, freq,
+					dvb_entry->service_id);
+
+		validate.refresh = !dvb_entry->video_pid_len &&
+				   !dvb_entry->audio_pid_len;
+		if (cached) {
+			validate.used = *cached;
+			validate.cached = 1;
+			if (validate.refresh)
+				pid_cache_fill_entry(cached, dvb_entry);
+		} else {
+			pid_cache_from_entry(&validate.used, dvb_entry, freq);
+		}
+
+		/* The tables can only be read from a local demux */
+		if (!args.server) {
+			validate.args = &args;
+			validate.dvb = dvb;
+			validate.parms = parms;
+		}
+	}
+
+	show_timing = args.timing;
+	clock_gettime(CLOCK_MONOTONIC, &zap_start);
+
 	if (setup_frontend(&args, parms) < 0)
 		goto err;
 
+	timing_mark(_("tune"));
+
 	if (args.exit_after_tuning) {
 		set_signals(&args);
 		err = 0;
-		check_frontend(&args, parms);
+		if (check_frontend(&args, parms))
+			timing_mark(_("lock"));
+		goto err;
+	}
+
+	if (args.n_extract) {
+		set_signals(&args);
+		err = do_extract(&args, dvb, dvb_file);
 		goto err;
 	}
 
@@ -1197,17 +2487,27 @@ int main(int argc, char **argv)
 	}
 
 	if (args.rec_psi) {
-		sid_fd = dvb_dev_open(dvb, args.demux_dev, O_RDWR);
-		if (!sid_fd) {
-			ERROR("opening sid demux failed");
-			return -1;
-		}
-		pmtpid = dvb_dev_dmx_get_pmt_pid(sid_fd, dvb_entry->service_id);
-		dvb_dev_close(sid_fd);
-		if (pmtpid <= 0) {
-			fprintf(stderr, _("couldn't find pmt-pid for sid %04x\n"),
-				dvb_entry->service_id);
-			goto err;
+		if (cached && cached->pmt_pid) {
+			pmtpid = cached->pmt_pid;
+			if (args.silent < 2)
+				fprintf(stderr, _("using cached pmt pid %d\n"),
+					pmtpid);
+		} else {
+			sid_fd = dvb_dev_open(dvb, args.demux_dev, O_RDWR);
+			if (!sid_fd) {
+				ERROR("opening sid demux failed");
+				return -1;
+			}
+			pmtpid = dvb_dev_dmx_get_pmt_pid(sid_fd,
+							 dvb_entry->service_id);
+			dvb_dev_close(sid_fd);
+			if (pmtpid <= 0) {
+				fprintf(stderr, _("couldn't find pmt-pid for sid %04x\n"),
+					dvb_entry->service_id);
+				goto err;
+			}
+			validate.used.pmt_pid = pmtpid;
+			timing_mark(_("pmt pid"));
 		}
 
 		pat_fd = dvb_dev_open(dvb, args.demux_dev, O_RDWR);
@@ -1347,6 +2647,17 @@ int main(int argc, char **argv)
 				}
 			}
 		}
+
+		if (validate.refresh) {
+			uint16_t pids[PID_CACHE_MAX_ES + 1];
+			unsigned n = pid_cache_selected(&validate.used, &args,
+							pids, 0);
+
+			if (pid_cache_pcr_needed(&validate.used, pids, n) &&
+			    add_pid_filter(dvb, &args, validate.used.pcr_pid,
+					   DMX_PES_PCR, _("pcr")) < 0)
+				goto err;
+		}
 	}
 
 	if ((dvb_entry->video_pid_len || dvb_entry->audio_pid_len) && !args.all_pids && !args.rec_psi) {
@@ -1362,6 +2673,8 @@ int main(int argc, char **argv)
 		fprintf(stderr, _("frontend doesn't lock\n"));
 		goto err;
 	}
+	timing_mark(_("lock"));
+	pid_validate_start(&validate);
 
 	if (args.dvr) {
 		if (args.filename) {
@@ -1384,7 +2697,7 @@ int main(int argc, char **argv)
 			get_show_stats(stderr, &args, parms, 0);
 
 		if (file_fd >= 0) {
-			dvr_fd = dvb_dev_open(dvb, args.dvr_dev, O_RDONLY);
+			dvr_fd = zap_dev_open(dvb, args.dvr_dev, O_RDONLY);
 			if (!dvr_fd) {
 				ERROR("failed opening '%s'", args.dvr_dev);
 				goto err;
@@ -1411,7 +2724,7 @@ int main(int argc, char **argv)
 
 			fprintf(stderr, _("DVR pipe interface '%s' will be opened\n"), args.dvr_pipe);
 
-			dvr_fd = dvb_dev_open(dvb, args.dvr_dev, O_RDONLY);
+			dvr_fd = zap_dev_open(dvb, args.dvr_dev, O_RDONLY);
 			if (!dvr_fd) {
 				ERROR("failed opening '%s'", args.dvr_dev);
 				err = -1;
@@ -1449,7 +2762,9 @@ int main(int argc, char **argv)
 	err = 0;
 
 err:
+	pid_validate_stop(&validate);
 	dvb_dev_free(dvb);
+	pid_cache_free();
 
 	if (dvb_file) {
 		dvb_file_free(dvb_file);
@@ -1470,6 +2785,13 @@ err:
 		free(args.search);
 	if (args.server)
 		free(args.server);
+	if (args.pid_cache)
+		free(args.pid_cache);
+	for (unsigned i = 0; i < args.n_extract; i++) {
+		free(args.extract[i].channel);
+		free(args.extract[i].fname);
+	}
+	free(args.extract);
 	if (args.dvr_pipe != default_dvr_pipe)
 		free(args.dvr_pipe);
 
@@ -33,6 +33,7 @@
 #include "ir-encode.h"
 #include "keymap.h"
 #include "bpf_encoder.h"
+#include "ir-raw-index.h"
 
 #ifdef ENABLE_NLS
 # define _(string) gettext(string)
@@ -134,7 +135,7 @@ static const struct argp_option options[] = {
 	{ "no-measure-carrier", 'M', 0,		0,	N_("disable reporting carrier frequency") },
 	{ "timeout",	't',	N_("TIMEOUT"),	0,	N_("set receiving timeout") },
 		{ .doc = N_("Sending options:") },
-	{ "keymap",	'k',	N_("KEYMAP"),	0,	N_("use keymap to send key from") },
+	{ "keymap",	'k',	N_("KEYMAP"),	0,	N_("use keymap to send key from, or to decode received raw IR") },
 	{ "carrier",	'c',	N_("CARRIER"),	0,	N_("set send carrier") },
 	{ "duty-cycle",	'D',	N_("DUTY"),	0,	N_("set send duty cycle") },
 	{ "emitters",	'e',	N_("EMITTERS"),	0,	N_("set send emitters") },
@@ -1120,12 +1121,74 @@ static int lirc_send(struct arguments *args, int fd, unsigned features, struct s
 	return 0;
 }
 
+struct raw_decoder {
+	struct raw_decoder *next;
+	struct raw_index *index;
+	uint32_t node;
+};
+
+static struct raw_decoder *raw_decoders(struct keymap *map)
+{
+	struct raw_decoder *list = NULL, *d;
+
+	for (; map; map = map->next) {
+		if (!map->raw)
+			continue;
+
+		d = malloc(sizeof(*d));
+		if (!d) {
+			fprintf(stderr, _("Failed to allocate memory\n"));
+			break;
+		}
+
+		d->index = raw_index_compile(map->raw,
+					     keymap_param(map, "margin", 200));
+		if (!d->index) {
+			fprintf(stderr, _("%s: failed to compile raw patterns\n"), map->name);
+			free(d);
+			continue;
+		}
+
+		d->node = 0;
+		d->next = list;
+		list = d;
+	}
+
+	return list;
+}
+
+static const char *raw_decode(struct raw_decoder *d, bool pulse, unsigned duration)
+{
+	const char *keycode = NULL;
+	struct raw_entry *re;
+
+	for (; d; d = d->next) {
+		re = raw_index_decode(d->index, &d->node, pulse, duration);
+		if (re && !keycode)
+			keycode = re->keycode;
+	}
+
+	return keycode;
+}
+
+static void free_raw_decoders(struct raw_decoder *d)
+{
+	while (d) {
+		struct raw_decoder *next = d->next;
+
+		raw_index_free(d->index);
+		free(d);
+		d = next;
+	}
+}
+
 int lirc_receive(struct arguments *args, int fd, unsigned features)
 {
 	char *dev = args->device;
 	FILE *out = stdout;
 	int rc = EX_IOERR;
 	int mode = LIRC_MODE_MODE2;
+	struct raw_decoder *decoders;
 
 	if (!(features & LIRC_CAN_REC_MODE2)) {
 		fprintf(stderr, _("%s: device cannot receive raw ir\n"), dev);
@@ -1151,6 +1214,9 @@ int lirc_receive(struct arguments *args, int fd, unsigned features)
 	bool leading_space = true;
 	unsigned carrier = 0;
 
+	// Received IR is matched against the raw patterns of any keymaps
+	decoders = raw_decoders(args->keymap);
+
 	while (keep_reading) {
 		ssize_t ret = TEMP_FAILURE_RETRY(read(fd, buf, sizeof(buf)));
 		if (ret < 0) {
@@ -1167,6 +1233,7 @@ int lirc_receive(struct arguments *args, int fd, unsigned features)
 		for (int i=0; i<ret / sizeof(unsigned); i++) {
 			unsigned val = buf[i] & LIRC_VALUE_MASK;
 			unsigned msg = buf[i] & LIRC_MODE2_MASK;
+			const char *keycode = NULL;
 
 			// FIXME: the kernel often send us a space after
 			// the IR receiver comes out of idle mode. This
@@ -1175,9 +1242,16 @@ int lirc_receive(struct arguments *args, int fd, unsigned features)
 				continue;
 
 			leading_space = false;
+			if (msg == LIRC_MODE2_PULSE || msg == LIRC_MODE2_SPACE ||
+			    msg == LIRC_MODE2_TIMEOUT)
+				keycode = raw_decode(decoders,
+						     msg == LIRC_MODE2_PULSE, val);
+
 			if (args->oneshot &&
 				(msg == LIRC_MODE2_TIMEOUT ||
 				(msg == LIRC_MODE2_SPACE && val > 19000))) {
+				if (keycode)
+					fprintf(out, "# keycode %s\n", keycode);
 				keep_reading = false;
 				break;
 			}
@@ -1232,12 +1306,16 @@ int lirc_receive(struct arguments *args, int fd, unsigned features)
 				}
 			}
 
+			if (keycode)
+				fprintf(out, "# keycode %s\n", keycode);
+
 			fflush(out);
 		}
 	}
 
 	rc = 0;
 err:
+	free_raw_decoders(decoders);
 	if (args->savetofile)
 		fclose(out);
 
@@ -0,0 +1 @@
+../common/ir-raw-index.h
\ No newline at end of file
@@ -1,5 +1,7 @@
 // SPDX-License-Identifier: GPL-2.0
+#include <config.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -16,6 +18,7 @@
 #include <assert.h>
 #include <argp.h>
 #include "keymap.h"
+#include "ir-raw-index.h"
 #include "bpf_load.h"
 
 #ifdef ENABLE_NLS
@@ -30,6 +33,14 @@
 
 #define LOG_BUF_SIZE (256 * 1024)
 
+#define CACHE_MAGIC 0x46504252 /* "RBPF" */
+#define CACHE_VERSION 2
+#define CACHE_MAP_NAME_LEN 64
+#define MAX_MAP_RELOS 64
+#define MAX_CACHE_INSNS (1024 * 1024)
+#define MAX_CACHE_VALUE_SIZE 65536
+#define MAX_CACHE_ENTRIES (1024 * 1024)
+
 // This should match the struct in the raw BPF decoder
 struct raw_pattern {
 	unsigned int scancode;
@@ -44,6 +55,44 @@ int trail_space;
 char bpf_log_buf[LOG_BUF_SIZE];
 extern int debug;
 
+// A map relocation. The map fds differ on every run, so the cache
+// records which instruction refers to which map and patches in the
+// fd after the maps have been created.
+struct map_relo {
+	unsigned int insn_idx;
+	unsigned int map_idx;
+};
+
+// Contents of a map which ir-keytable fills in, e.g. the raw patterns
+struct map_values {
+	void *data;
+	unsigned int value_size;
+	unsigned int entries;
+};
+
+// On-disk layout of a cached decoder: this header, followed by
+// nr_maps struct cache_map, nr_relos struct map_relo, insn_cnt
+// struct bpf_insn with all parameters patched in, and finally the
+// contents of each map which has values.
+struct cache_header {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t key;
+	uint32_t nr_maps;
+	uint32_t nr_relos;
+	uint32_t insn_cnt;
+	uint32_t reserved;
+	char license[128];
+	char name[128];
+};
+
+struct cache_map {
+	char name[CACHE_MAP_NAME_LEN];
+	struct bpf_load_map_def def;
+	uint32_t value_size;
+	uint32_t entries;
+};
+
 struct bpf_file {
 	Elf *elf;
 	char license[128];
@@ -59,6 +108,13 @@ struct bpf_file {
 	Elf_Data *symbols;
 	struct protocol_param *param;
 	char name[128];
+	int prog_sec;
+	struct map_relo relo[MAX_MAP_RELOS];
+	int nr_relos;
+	struct map_values values[MAX_MAPS];
+	void *raw_values;
+	struct raw_index *raw_index;
+	bool uncacheable;
 };
 
 static int load_and_attach(int lirc_fd, struct bpf_file *bpf_file, struct bpf_insn *prog, int size)
@@ -88,14 +144,13 @@ static int load_and_attach(int lirc_fd, struct bpf_file *bpf_file, struct bpf_in
 	return 0;
 }
 
-static int build_raw_map(struct bpf_map_data *map, struct raw_entry *raw, int numa_node)
+static int build_raw_values(struct bpf_file *bpf_file, struct map_values *v,
+			    struct raw_entry *raw)
 {
-	int no_patterns, value_size, fd, key, i;
+	int no_patterns, value_size, i;
 	struct raw_entry *e;
 	struct raw_pattern *p;
-	LIBBPF_OPTS(bpf_map_create_opts, opts,
-		.map_flags = map->def.map_flags,
-	);
+	unsigned char *values;
 
 	no_patterns = 0;
 
@@ -111,26 +166,13 @@ static int build_raw_map(struct bpf_map_data *map, struct raw_entry *raw, int nu
 
 	value_size = sizeof(struct raw_pattern) + max_length * sizeof(short);
 
-	opts.numa_node = numa_node;
-	fd = bpf_map_create(map->def.type,
-			    map->name,
-			    map->def.key_size,
-			    value_size,
-			    no_patterns,
-			    &opts);
-	if (fd < 0) {
-		printf(_("failed to create a map: %d %s\n"),
-		       errno, strerror(errno));
-		return -1;
-	}
-
-	p = malloc(value_size);
-	if (!p) {
+	values = calloc(no_patterns ?: 1, value_size);
+	if (!values) {
 		printf(_("Failed to allocate memory"));
 		return -1;
 	}
 
-	key = 0;
+	p = (struct raw_pattern *)values;
 
 	for (e = raw; e; e = e->next) {
 		p->scancode = e->scancode;
@@ -140,26 +182,124 @@ static int build_raw_map(struct bpf_map_data *map, struct raw_entry *raw, int nu
 				trail_space = e->raw[i];
 		}
 
-		// Add trailing space and clear rest of the struct
-		while (i < max_length)
-			p->raw[i++] = 0;
-
-		if (bpf_map_update_elem(fd, &key, p, BPF_ANY)) {
-			printf(_("failed to update raw map: %d %s\n"),
-			       errno, strerror(errno));
-			free(p);
-			return -1;
-		}
-
-		key++;
+		// The trailing space and the rest of the struct are
+		// already cleared by calloc()
+		p = (struct raw_pattern *)((unsigned char *)p + value_size);
 	}
-	free(p);
 
 	// 1ms extra for trailing space. This also ensure that the
 	// trail_space is larger than largest space + margin in the
 	// decoder
 	trail_space += 1000;
 
+	bpf_file->raw_values = values;
+	v->data = values;
+	v->value_size = value_size;
+	v->entries = no_patterns;
+
+	return 0;
+}
+
+// Get the initial value of a variable from the data section
+static int elf_data_value(struct bpf_file *bpf_file, const char *name, int *val)
+{
+	const char *sym_name;
+	GElf_Sym sym;
+	int i;
+
+	if (!bpf_file->symbols || !bpf_file->data)
+		return -1;
+
+	for (i = 0; i < bpf_file->symbols->d_size / sizeof(GElf_Sym); i++) {
+		if (!gelf_getsym(bpf_file->symbols, i, &sym) ||
+		    sym.st_shndx != bpf_file->dataidx)
+			continue;
+
+		sym_name = elf_strptr(bpf_file->elf, bpf_file->strtabidx, sym.st_name);
+		if (!sym_name || strcmp(sym_name, name))
+			continue;
+
+		*val = *(int*)((unsigned char*)bpf_file->data->d_buf + sym.st_value);
+		return 0;
+	}
+
+	return -1;
+}
+
+// The raw decoder walks the raw patterns compiled into a trie, which
+// is stored in the raw_nodes and raw_edges maps
+static int build_raw_index(struct bpf_file *bpf_file, struct map_values *v,
+			   const char *name, struct raw_entry *raw)
+{
+	struct raw_index *index = bpf_file->raw_index;
+	int margin = 200;
+
+	if (!index) {
+		if (bpf_param(bpf_file->param, "margin", &margin))
+			elf_data_value(bpf_file, "margin", &margin);
+
+		index = raw_index_compile(raw, margin > 0 ? margin : 0);
+		if (!index) {
+			printf(_("failed to compile raw patterns\n"));
+			return -1;
+		}
+
+		if (debug)
+			printf(_("raw patterns compiled into %u nodes and %u edges\n"),
+			       index->nr_nodes, index->nr_edges);
+
+		bpf_file->raw_index = index;
+		trail_space = index->trail_space;
+	}
+
+	if (!strcmp(name, "raw_nodes")) {
+		v->data = index->nodes;
+		v->value_size = sizeof(*index->nodes);
+		v->entries = index->nr_nodes;
+	} else {
+		v->data = index->edges;
+		v->value_size = sizeof(*index->edges);
+		v->entries = index->nr_edges;
+	}
+
+	return 0;
+}
+
+static int create_filled_map(struct bpf_map_data *map, struct map_values *v,
+			     int numa_node)
+{
+	unsigned char *values = v->data;
+	unsigned int key;
+	int fd;
+	LIBBPF_OPTS(bpf_map_create_opts, opts,
+		.map_flags = map->def.map_flags,
+	);
+
+	// a map cannot be empty, but the decoder will never look at an
+	// entry which was not filled in
+	opts.numa_node = numa_node;
+	fd = bpf_map_create(map->def.type,
+			    map->name,
+			    map->def.key_size,
+			    v->value_size,
+			    v->entries ?: 1,
+			    &opts);
+	if (fd < 0) {
+		printf(_("failed to create a map: %d %s\n"),
+		       errno, strerror(errno));
+		return -1;
+	}
+
+	for (key = 0; key < v->entries; key++) {
+		if (bpf_map_update_elem(fd, &key, values, BPF_ANY)) {
+			printf(_("failed to update %s map: %d %s\n"),
+			       map->name, errno, strerror(errno));
+			close(fd);
+			return -1;
+		}
+		values += v->value_size;
+	}
+
 	return fd;
 }
 
@@ -187,8 +327,22 @@ static int load_maps(struct bpf_file *bpf_file, struct raw_entry *raw)
 							4,
 							maps[i].def.max_entries,
 							&opts);
-		} else if (!strcmp(maps[i].name, "raw_map")) {
-			bpf_file->map_fd[i] = build_raw_map(&maps[i], raw, numa_node);
+		} else if (bpf_file->values[i].data ||
+			   !strcmp(maps[i].name, "raw_map") ||
+			   !strcmp(maps[i].name, "raw_nodes") ||
+			   !strcmp(maps[i].name, "raw_edges")) {
+			struct map_values *v = &bpf_file->values[i];
+
+			// When loading from the cache, the values were
+			// stored along with the program
+			if (!v->data) {
+				if (!strcmp(maps[i].name, "raw_map") ?
+				    build_raw_values(bpf_file, v, raw) :
+				    build_raw_index(bpf_file, v, maps[i].name, raw))
+					return 1;
+			}
+			bpf_file->map_fd[i] = create_filled_map(&maps[i], v,
+								numa_node);
 		} else {
 			LIBBPF_OPTS(bpf_map_create_opts, opts,
 				.map_flags = maps[i].def.map_flags,
@@ -276,6 +430,13 @@ static int parse_relo_and_apply(struct bpf_file *bpf_file, GElf_Shdr *shdr,
 			}
 
 			if (match) {
+				if (bpf_file->nr_relos < MAX_MAP_RELOS) {
+					bpf_file->relo[bpf_file->nr_relos].insn_idx = insn_idx;
+					bpf_file->relo[bpf_file->nr_relos].map_idx = map_idx;
+					bpf_file->nr_relos++;
+				} else {
+					bpf_file->uncacheable = true;
+				}
 				insn[insn_idx].src_reg = BPF_PSEUDO_MAP_FD;
 				insn[insn_idx].imm = bpf_file->map_data[map_idx].fd;
 				continue;
@@ -442,6 +603,273 @@ static int load_elf_maps_section(struct bpf_file *bpf_file)
 	return nr_maps;
 }
 
+static uint64_t fnv1a(uint64_t hash, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+
+	while (len--) {
+		hash ^= *p++;
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+// The cache key covers everything which ends up in the relocated program
+// and its maps: the object file itself, the parameters which are patched
+// into the instructions and the raw patterns which fill the raw_map.
+static uint64_t cache_key(const char *path, struct stat *st,
+			  struct protocol_param *param, struct raw_entry *raw)
+{
+	uint64_t key = 0xcbf29ce484222325ULL;
+
+	key = fnv1a(key, path, strlen(path) + 1);
+	key = fnv1a(key, &st->st_size, sizeof(st->st_size));
+	key = fnv1a(key, &st->st_mtime, sizeof(st->st_mtime));
+
+	for (; param; param = param->next) {
+		key = fnv1a(key, param->name, strlen(param->name) + 1);
+		key = fnv1a(key, &param->value, sizeof(param->value));
+	}
+
+	for (; raw; raw = raw->next) {
+		key = fnv1a(key, &raw->scancode, sizeof(raw->scancode));
+		key = fnv1a(key, &raw->raw_length, sizeof(raw->raw_length));
+		key = fnv1a(key, raw->raw, raw->raw_length * sizeof(raw->raw[0]));
+	}
+
+	return key;
+}
+
+static char *cache_path(const char *path, uint64_t key)
+{
+	const char *base = strrchr(path, '/');
+	char *fname;
+	int len;
+
+	base = base ? base + 1 : path;
+	len = strlen(base);
+	if (len > 2 && !strcmp(base + len - 2, ".o"))
+		len -= 2;
+
+	if (asprintf(&fname, IR_KEYTABLE_CACHE_DIR "/%.*s-%016llx.bin",
+		     len, base, (unsigned long long)key) < 0)
+		return NULL;
+
+	return fname;
+}
+
+static void close_maps(struct bpf_file *bpf_file)
+{
+	int i;
+
+	for (i = 0; i < bpf_file->nr_maps; i++) {
+		if (bpf_file->map_fd[i] >= 0)
+			close(bpf_file->map_fd[i]);
+		bpf_file->map_fd[i] = -1;
+	}
+}
+
+// Attach a decoder from a cache file. Returns 0 on success, or -1 if the
+// cache cannot be used, in which case the object file is loaded instead.
+static int load_from_cache(const char *fname, uint64_t key, int lirc_fd,
+			   struct bpf_file *bpf_file)
+{
+	struct cache_header *hdr;
+	struct cache_map *maps;
+	struct map_relo *relo;
+	struct bpf_insn *insns;
+	unsigned char *buf = NULL, *values;
+	struct stat st;
+	size_t size;
+	bool invalid = true;
+	int fd, i, ret = -1;
+
+	fd = open(fname, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	if (fstat(fd, &st) || st.st_size < (off_t)sizeof(*hdr))
+		goto done;
+
+	buf = malloc(st.st_size);
+	if (!buf || read(fd, buf, st.st_size) != st.st_size)
+		goto done;
+
+	hdr = (struct cache_header *)buf;
+	if (hdr->magic != CACHE_MAGIC || hdr->version != CACHE_VERSION ||
+	    hdr->key != key || hdr->nr_maps > MAX_MAPS ||
+	    hdr->nr_relos > MAX_MAP_RELOS || !hdr->insn_cnt ||
+	    hdr->insn_cnt > MAX_CACHE_INSNS)
+		goto done;
+
+	size = sizeof(*hdr) + hdr->nr_maps * sizeof(*maps) +
+		hdr->nr_relos * sizeof(*relo) +
+		hdr->insn_cnt * sizeof(*insns);
+	if (size > (size_t)st.st_size)
+		goto done;
+
+	maps = (struct cache_map *)(hdr + 1);
+	relo = (struct map_relo *)(maps + hdr->nr_maps);
+	insns = (struct bpf_insn *)(relo + hdr->nr_relos);
+	values = (unsigned char *)(insns + hdr->insn_cnt);
+
+	for (i = 0; i < hdr->nr_maps; i++) {
+		if (maps[i].value_size > MAX_CACHE_VALUE_SIZE ||
+		    maps[i].entries > MAX_CACHE_ENTRIES)
+			goto done;
+		size += (size_t)maps[i].value_size * maps[i].entries;
+	}
+	if (size != (size_t)st.st_size)
+		goto done;
+
+	for (i = 0; i < hdr->nr_relos; i++) {
+		if (relo[i].insn_idx >= hdr->insn_cnt ||
+		    relo[i].map_idx >= hdr->nr_maps)
+			goto done;
+	}
+	invalid = false;
+
+	memcpy(bpf_file->license, hdr->license, sizeof(bpf_file->license));
+	bpf_file->license[sizeof(bpf_file->license) - 1] = 0;
+	memcpy(bpf_file->name, hdr->name, sizeof(bpf_file->name));
+	bpf_file->name[sizeof(bpf_file->name) - 1] = 0;
+
+	bpf_file->nr_maps = hdr->nr_maps;
+	for (i = 0; i < hdr->nr_maps; i++) {
+		maps[i].name[CACHE_MAP_NAME_LEN - 1] = 0;
+		if (maps[i].def.inner_map_idx >= hdr->nr_maps)
+			maps[i].def.inner_map_idx = 0;
+		bpf_file->map_fd[i] = -1;
+		bpf_file->map_data[i].fd = -1;
+		bpf_file->map_data[i].name = maps[i].name;
+		bpf_file->map_data[i].def = maps[i].def;
+
+		if (maps[i].value_size) {
+			bpf_file->values[i].data = values;
+			bpf_file->values[i].value_size = maps[i].value_size;
+			bpf_file->values[i].entries = maps[i].entries;
+			values += maps[i].value_size * maps[i].entries;
+		}
+	}
+
+	if (load_maps(bpf_file, NULL)) {
+		close_maps(bpf_file);
+		goto done;
+	}
+
+	for (i = 0; i < hdr->nr_relos; i++) {
+		insns[relo[i].insn_idx].src_reg = BPF_PSEUDO_MAP_FD;
+		insns[relo[i].insn_idx].imm = bpf_file->map_fd[relo[i].map_idx];
+	}
+
+	if (debug)
+		printf(_("loading %s from cache %s\n"), bpf_file->name, fname);
+
+	ret = load_and_attach(lirc_fd, bpf_file, insns,
+			      hdr->insn_cnt * sizeof(*insns));
+	if (ret)
+		close_maps(bpf_file);
+
+done:
+	free(buf);
+	close(fd);
+
+	// a corrupt or stale cache entry is removed and recreated from the
+	// object file; one that merely failed to load is kept, as the failure
+	// is most likely not down to its content
+	if (ret) {
+		if (invalid)
+			unlink(fname);
+		*bpf_file = (struct bpf_file) { .param = bpf_file->param };
+	}
+
+	return ret;
+}
+
+// Write the relocated program and map images to the cache. This is
+// done through a temporary file, so that concurrent instances of
+// ir-keytable for other receivers never see a partial cache entry.
+static void write_cache(const char *fname, uint64_t key,
+			struct bpf_file *bpf_file, struct bpf_insn *insns,
+			int size)
+{
+	struct cache_header hdr = {
+		.magic = CACHE_MAGIC,
+		.version = CACHE_VERSION,
+		.key = key,
+		.nr_maps = bpf_file->nr_maps,
+		.nr_relos = bpf_file->nr_relos,
+		.insn_cnt = size / sizeof(struct bpf_insn),
+	};
+	struct cache_map maps[MAX_MAPS] = {};
+	char *tmp;
+	FILE *fout;
+	int fd, i;
+	bool ok;
+
+	if (bpf_file->uncacheable || bpf_file->nr_maps > MAX_MAPS)
+		return;
+
+	for (i = 0; i < bpf_file->nr_maps; i++) {
+		if (strlen(bpf_file->map_data[i].name) >= CACHE_MAP_NAME_LEN)
+			return;
+		strcpy(maps[i].name, bpf_file->map_data[i].name);
+		maps[i].def = bpf_file->map_data[i].def;
+		if (bpf_file->values[i].data) {
+			maps[i].value_size = bpf_file->values[i].value_size;
+			maps[i].entries = bpf_file->values[i].entries;
+		}
+	}
+
+	memcpy(hdr.license, bpf_file->license, sizeof(hdr.license));
+	memcpy(hdr.name, bpf_file->name, sizeof(hdr.name));
+
+	if (mkdir(IR_KEYTABLE_CACHE_DIR, 0755) && errno != EEXIST)
+		return;
+
+	if (asprintf(&tmp, "%s.XXXXXX", fname) < 0)
+		return;
+
+	fd = mkstemp(tmp);
+	if (fd < 0) {
+		free(tmp);
+		return;
+	}
+
+	fout = fdopen(fd, "w");
+	if (!fout) {
+		close(fd);
+		unlink(tmp);
+		free(tmp);
+		return;
+	}
+
+	ok = fwrite(&hdr, sizeof(hdr), 1, fout) == 1;
+	if (ok && hdr.nr_maps)
+		ok = fwrite(maps, sizeof(maps[0]), hdr.nr_maps, fout) == hdr.nr_maps;
+	if (ok && hdr.nr_relos)
+		ok = fwrite(bpf_file->relo, sizeof(bpf_file->relo[0]),
+			    hdr.nr_relos, fout) == hdr.nr_relos;
+	if (ok)
+		ok = fwrite(insns, sizeof(*insns), hdr.insn_cnt, fout) == hdr.insn_cnt;
+	for (i = 0; ok && i < hdr.nr_maps; i++) {
+		if (maps[i].entries)
+			ok = fwrite(bpf_file->values[i].data, maps[i].value_size,
+				    maps[i].entries, fout) == maps[i].entries;
+	}
+	if (fclose(fout))
+		ok = false;
+
+	if (!ok || chmod(tmp, 0644) || rename(tmp, fname)) {
+		unlink(tmp);
+	} else if (debug) {
+		printf(_("wrote %s to cache %s\n"), bpf_file->name, fname);
+	}
+
+	free(tmp);
+}
+
 int load_bpf_file(const char *path, int lirc_fd, struct protocol_param *param,
 		  struct raw_entry *raw)
 {
@@ -453,6 +881,9 @@ int load_bpf_file(const char *path, int lirc_fd, struct protocol_param *param,
 	Elf_Data *data, *data_prog, *data_map = NULL;
 	char *shname, *shname_prog;
 	int nr_maps = 0;
+	char *fname = NULL;
+	struct stat st;
+	uint64_t key = 0;
 
 	if (elf_version(EV_CURRENT) == EV_NONE)
 		return 1;
@@ -461,6 +892,19 @@ int load_bpf_file(const char *path, int lirc_fd, struct protocol_param *param,
 	if (fd < 0)
 		return 1;
 
+	// The relocated program and maps only depend on the object file,
+	// the parameters and the raw patterns, so setting up the same
+	// protocol for several receivers can skip parsing the ELF file.
+	if (!fstat(fd, &st)) {
+		key = cache_key(path, &st, param, raw);
+		fname = cache_path(path, key);
+		if (fname && !load_from_cache(fname, key, lirc_fd, &bpf_file)) {
+			free(fname);
+			close(fd);
+			return 0;
+		}
+	}
+
 	elf = elf_begin(fd, ELF_C_READ, NULL);
 
 	if (!elf)
@@ -555,8 +999,15 @@ int load_bpf_file(const char *path, int lirc_fd, struct protocol_param *param,
 			insns = (struct bpf_insn *) data_prog->d_buf;
 			bpf_file.processed_sec[i] = true; /* relo section */
 
-			if (parse_relo_and_apply(&bpf_file, &shdr, insns, data))
+			// only a single relocated program can be cached
+			if (bpf_file.prog_sec && bpf_file.prog_sec != shdr.sh_info)
+				bpf_file.uncacheable = true;
+			bpf_file.prog_sec = shdr.sh_info;
+
+			if (parse_relo_and_apply(&bpf_file, &shdr, insns, data)) {
+				bpf_file.uncacheable = true;
 				continue;
+			}
 		}
 	}
 
@@ -573,10 +1024,15 @@ int load_bpf_file(const char *path, int lirc_fd, struct protocol_param *param,
 			continue;
 
 		ret = load_and_attach(lirc_fd, &bpf_file, data->d_buf, data->d_size);
+		if (!ret && fname && (!bpf_file.prog_sec || bpf_file.prog_sec == i))
+			write_cache(fname, key, &bpf_file, data->d_buf, data->d_size);
 		break;
 	}
 
 done:
+	free(bpf_file.raw_values);
+	raw_index_free(bpf_file.raw_index);
+	free(fname);
 	close(fd);
 	return ret;
 }
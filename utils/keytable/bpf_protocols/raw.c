@@ -2,29 +2,28 @@
 //
 // Copyright (C) 2019 Sean Young <sean@mess.org>
 //
-// This decoder matches pre-defined pulse-space sequences. It does so by
-// iterating through the list There are many optimisation possible, if
-// performance is an issue.
-//
-// First of all iterating through the list of patterns is one-by-one, even
-// though after the first few pulse space sequences, most patterns will be
-// will not be a match. The bitmap datastructure could use a "next clear bit"
-// function.
-//
-// Secondly this can be transformed into a much more efficient state machine,
-// where we pre-compile the patterns much like a regex.
+// This decoder matches pre-defined pulse-space sequences. ir-keytable
+// compiles the patterns into a trie (see utils/common/ir-raw-index.c), with
+// edges for the ranges of durations which lead to the next node, margin
+// included. So each pulse or space is a binary search over the edges of
+// one node, rather than a comparison against every pattern.
 
 #include <linux/lirc.h>
 #include <linux/bpf.h>
 
 #include "bpf_helpers.h"
-#include "bitmap.h"
 
-#define MAX_PATTERNS 1024
+// ir-keytable sizes the raw_nodes and raw_edges maps to fit the trie, so
+// these are only placeholders
+#define MAX_NODES 1
+#define MAX_EDGES 1
+// enough binary search steps for any number of edges
+#define MAX_SEARCH 32
+
+#define NO_NODE 0xffffffff
 
 struct decoder_state {
-	int pos;
-	DECLARE_BITMAP(nomatch, MAX_PATTERNS);
+	unsigned int node;
 };
 
 struct bpf_map_def SEC("lirc_mode2/maps") decoder_state_map = {
@@ -34,19 +33,35 @@ struct bpf_map_def SEC("lirc_mode2/maps") decoder_state_map = {
 	.max_entries = 1,
 };
 
-struct raw_pattern {
-	unsigned int scancode;
-	unsigned short raw[0];
+// These should match the structs in ir-raw-index.h
+struct raw_node {
+	unsigned long long scancode;
+	unsigned int first_edge;
+	unsigned int nr_edges;
+	unsigned int entry;
+	unsigned int reserved;
 };
 
-// ir-keytable will load the raw patterns here
-struct bpf_map_def SEC("lirc_mode2/maps") raw_map = {
+struct raw_edge {
+	unsigned int low;
+	unsigned int high;
+	unsigned int next;
+};
+
+// ir-keytable will load the compiled patterns here
+struct bpf_map_def SEC("lirc_mode2/maps") raw_nodes = {
 	.type = BPF_MAP_TYPE_ARRAY,
 	.key_size = sizeof(unsigned int),
-	.value_size = sizeof(struct raw_pattern), // this is not used
-	.max_entries = MAX_PATTERNS,
+	.value_size = sizeof(struct raw_node),
+	.max_entries = MAX_NODES,
 };
 
+struct bpf_map_def SEC("lirc_mode2/maps") raw_edges = {
+	.type = BPF_MAP_TYPE_ARRAY,
+	.key_size = sizeof(unsigned int),
+	.value_size = sizeof(struct raw_edge),
+	.max_entries = MAX_EDGES,
+};
 
 // These values can be overridden in the rc_keymap toml
 //
@@ -54,26 +69,23 @@ struct bpf_map_def SEC("lirc_mode2/maps") raw_map = {
 // an int, so that the compiler emits a mov immediate for the address
 // but uses it as an int. The bpf loader replaces the relocation with the
 // actual value (either overridden or taken from the data segment).
+//
+// The margin is used by ir-keytable when compiling the patterns.
 int margin = 200;
 int rc_protocol = 68;
-// The following two values are calculated by ir-keytable
+// The following value is calculated by ir-keytable
 int trail_space = 1000;
-int max_length = 1;
 
 #define BPF_PARAM(x) (int)(long)(&(x))
 
-static inline int eq_margin(unsigned d1, unsigned d2)
-{
-	return ((d1 > (d2 - BPF_PARAM(margin))) && (d1 < (d2 + BPF_PARAM(margin))));
-}
-
 SEC("lirc_mode2/raw")
 int bpf_decoder(unsigned int *sample)
 {
 	unsigned int key = 0;
 	struct decoder_state *s = bpf_map_lookup_elem(&decoder_state_map, &key);
-	struct raw_pattern *p;
-	unsigned int i;
+	struct raw_node *n;
+	struct raw_edge *e;
+	unsigned int i, lo, hi, mid, next;
 
 	// Make verifier happy. Should never come to pass
 	if (!s)
@@ -89,60 +101,59 @@ int bpf_decoder(unsigned int *sample)
 		return 0;
 	}
 
-	int duration = LIRC_VALUE(*sample);
+	unsigned int duration = LIRC_VALUE(*sample);
 	int pulse = LIRC_IS_PULSE(*sample);
-	int pos = s->pos;
 
-	if (pos < 0 || pos >= BPF_PARAM(max_length)) {
-		if (!pulse && duration >= BPF_PARAM(trail_space)) {
-			bitmap_zero(s->nomatch, MAX_PATTERNS);
-			s->pos = 0;
+	if (!pulse && duration >= BPF_PARAM(trail_space)) {
+		// Are we at the end of a pattern?
+		if (s->node != NO_NODE) {
+			key = s->node;
+			n = bpf_map_lookup_elem(&raw_nodes, &key);
+			if (n && n->entry)
+				bpf_rc_keydown(sample, BPF_PARAM(rc_protocol),
+					       n->scancode, 0);
 		}
 
+		s->node = 0;
 		return 0;
 	}
 
-	if (!pulse && duration >= BPF_PARAM(trail_space)) {
-		for (i = 0; i < MAX_PATTERNS; i++) {
-			key = i;
-			p = bpf_map_lookup_elem(&raw_map, &key);
-			// Make verifier happy. Should never come to pass
-			if (!p)
-				break;
-
-			// Has this pattern already mismatched?
-			if (bitmap_test(s->nomatch, i))
-				continue;
-
-			// Are we at the end of the pattern?
-			if (p->raw[pos] == 0)
-				bpf_rc_keydown(sample, BPF_PARAM(rc_protocol),
-					       p->scancode, 0);
-		}
+	// Has every pattern already mismatched?
+	if (s->node == NO_NODE)
+		return 0;
 
-		bitmap_zero(s->nomatch, MAX_PATTERNS);
-		s->pos = 0;
-	} else {
-		for (i = 0; i < MAX_PATTERNS; i++) {
-			key = i;
-			p = bpf_map_lookup_elem(&raw_map, &key);
-			// Make verifier happy. Should never come to pass
-			if (!p)
-				break;
-
-			// Has this pattern already mismatched?
-			if (bitmap_test(s->nomatch, i))
-				continue;
-
-			// If the pattern ended, or does not match
-			if (p->raw[pos] == 0 ||
-				!eq_margin(duration,  p->raw[pos]))
-				bitmap_set(s->nomatch, i);
-		}
+	key = s->node;
+	n = bpf_map_lookup_elem(&raw_nodes, &key);
+	// Make verifier happy. Should never come to pass
+	if (!n) {
+		s->node = NO_NODE;
+		return 0;
+	}
 
-		s->pos++;
+	lo = n->first_edge;
+	hi = lo + n->nr_edges;
+	next = NO_NODE;
+
+	for (i = 0; i < MAX_SEARCH && lo < hi; i++) {
+		mid = lo + (hi - lo) / 2;
+		key = mid;
+		e = bpf_map_lookup_elem(&raw_edges, &key);
+		// Make verifier happy. Should never come to pass
+		if (!e)
+			break;
+
+		if (duration < e->low) {
+			hi = mid;
+		} else if (duration > e->high) {
+			lo = mid + 1;
+		} else {
+			next = e->next;
+			break;
+		}
 	}
 
+	s->node = next;
+
 	return 0;
 }
 
@@ -0,0 +1 @@
+../common/ir-raw-index.c
\ No newline at end of file
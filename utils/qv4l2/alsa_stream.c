@@ -41,12 +41,29 @@
 #include <alsa/asoundlib.h>
 #include <sys/time.h>
 #include <math.h>
+#include <time.h>
 
 #define ARRAY_SIZE(a) (sizeof(a)/sizeof(*(a)))
 
 /* Private vars to control alsa thread status */
 static int stop_alsa = 0;
-static snd_htimestamp_t timestamp;
+
+/*
+ * A/V sync state. The video side reports the latency between the V4L2
+ * buffer timestamps and the moment the frames are shown, the audio thread
+ * measures the latency between capture and playback and stretches or
+ * shrinks the audio by resampling, so that the audio latency follows the
+ * video latency within the limits of the playback buffer. The same loop
+ * also compensates the drift between the capture and playback clocks.
+ */
+#define SYNC_MAX_PPM		20000	/* at most 2% faster or slower */
+#define SYNC_DEADBAND_US	2000	/* don't correct smaller errors */
+#define SYNC_CORRECT_US		2000000	/* correct the error in ~2 seconds */
+
+static pthread_mutex_t sync_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct alsa_sync_stats sync_stats;
+static int video_latency_valid;
+static long long video_latency_us;
 
 /* Error handlers */
 snd_output_t *output = NULL;
@@ -55,6 +72,7 @@ int verbose = 0;
 
 struct final_params {
     int bufsize;
+    int periodsize;
     int rate;
     int latency;
     int channels;
@@ -210,6 +228,14 @@ static int setparams_set(snd_pcm_t *handle,
 		id, snd_strerror(err));
     }
 
+    /* Use the same clock as the V4L2 buffer timestamps */
+    err = snd_pcm_sw_params_set_tstamp_type(handle, swparams,
+					    SND_PCM_TSTAMP_TYPE_MONOTONIC);
+    if (err < 0 && verbose) {
+	fprintf(error_fp, "alsa: Unable to use monotonic timestamps for %s: %s\n",
+		id, snd_strerror(err));
+    }
+
     err = snd_pcm_sw_params(handle, swparams);
     if (err < 0) {
 	fprintf(error_fp, "alsa: Unable to set sw params for %s: %s\n",
@@ -420,6 +446,7 @@ static int setparams(snd_pcm_t *phandle, snd_pcm_t *chandle,
     }
 
     negotiated->bufsize = c_size;
+    negotiated->periodsize = c_psize;
     negotiated->rate = ratep;
     negotiated->channels = channels;
     negotiated->latency = latency;
@@ -430,8 +457,7 @@ static int setparams(snd_pcm_t *phandle, snd_pcm_t *chandle,
 static snd_pcm_sframes_t readbuf(snd_pcm_t *handle, char *buf, long len)
 {
     snd_pcm_sframes_t r;
-    snd_pcm_uframes_t frames;
-    snd_pcm_htimestamp(handle, &frames, &timestamp);
+
     r = snd_pcm_readi(handle, buf, len);
     if (r < 0 && !(r == -EAGAIN || r == -ENODEV)) {
 	r = snd_pcm_recover(handle, r, 0);
@@ -442,7 +468,8 @@ static snd_pcm_sframes_t readbuf(snd_pcm_t *handle, char *buf, long len)
 }
 
 /* Write len frames (note not up to len, but all of len!) */
-static snd_pcm_sframes_t writebuf(snd_pcm_t *handle, char *buf, long len)
+static snd_pcm_sframes_t writebuf(snd_pcm_t *handle, char *buf, long len,
+				  int framesize)
 {
     snd_pcm_sframes_t r;
 
@@ -458,18 +485,111 @@ static snd_pcm_sframes_t writebuf(snd_pcm_t *handle, char *buf, long len)
 		return r;
 	    }
 	}
-	buf += r * 4;
+	buf += r * framesize;
 	len -= r;
 	snd_pcm_wait(handle, 100);
     }
     return -1;
 }
 
+/*
+ * Stretch or shrink in_frames of S16 audio to out_frames by linear
+ * interpolation. Both are at least 2 and differ by at most a few percent,
+ * so this is good enough and cheap.
+ */
+static void resample(const short *in, long in_frames, short *out,
+		     long out_frames, int channels)
+{
+    unsigned long long step = ((unsigned long long)(in_frames - 1) << 16) /
+			      (out_frames - 1);
+    unsigned long long pos = 0;
+    long i;
+    int c;
+
+    for (i = 0; i < out_frames; i++, pos += step) {
+	long idx = pos >> 16;
+	int frac = pos & 0xffff;
+	const short *a = in + idx * channels;
+	const short *b = idx + 1 < in_frames ? a + channels : a;
+
+	for (c = 0; c < channels; c++)
+	    out[i * channels + c] = a[c] + (((long long)(b[c] - a[c]) * frac) >> 16);
+    }
+}
+
+static long long timespec_to_us(const struct timespec *ts)
+{
+    return ts->tv_sec * 1000000LL + ts->tv_nsec / 1000;
+}
+
+/*
+ * Measure the capture to playback latency and work out by how much the
+ * audio must be sped up or slowed down. Returns the correction in parts
+ * per million, positive to drop audio.
+ */
+static int sync_update(snd_pcm_t *phandle, snd_pcm_t *chandle,
+		       const struct final_params *negotiated,
+		       double *avg_latency_us)
+{
+    snd_pcm_sframes_t cdelay = 0, pdelay = 0;
+    long long min_us, max_us, target_us, latency_us, error_us;
+    int ppm = 0;
+
+    if (snd_pcm_delay(chandle, &cdelay) < 0)
+	cdelay = 0;
+    if (snd_pcm_delay(phandle, &pdelay) < 0)
+	return 0;
+
+    latency_us = (cdelay + pdelay) * 1000000LL / negotiated->rate;
+    if (*avg_latency_us == 0)
+	*avg_latency_us = latency_us;
+    else
+	*avg_latency_us += (latency_us - *avg_latency_us) / 16;
+
+    /*
+     * Below the start threshold playback would underrun, above it there
+     * must be room left in the playback buffer (twice the capture
+     * buffer) for the next capture period.
+     */
+    min_us = negotiated->latency * 1000000LL / negotiated->rate;
+    max_us = (2LL * negotiated->bufsize - negotiated->periodsize) *
+	     1000000LL / negotiated->rate;
+
+    pthread_mutex_lock(&sync_lock);
+    target_us = video_latency_valid ? video_latency_us : min_us;
+    if (target_us < min_us)
+	target_us = min_us;
+    if (target_us > max_us)
+	target_us = max_us;
+
+    error_us = *avg_latency_us - target_us;
+    if (error_us > SYNC_DEADBAND_US || error_us < -SYNC_DEADBAND_US) {
+	ppm = error_us * 1000000LL / SYNC_CORRECT_US;
+	if (ppm > SYNC_MAX_PPM)
+	    ppm = SYNC_MAX_PPM;
+	if (ppm < -SYNC_MAX_PPM)
+	    ppm = -SYNC_MAX_PPM;
+    }
+
+    sync_stats.audio_latency_us = *avg_latency_us;
+    sync_stats.video_latency_us = video_latency_valid ? video_latency_us : 0;
+    sync_stats.av_offset_us = video_latency_valid ?
+			      *avg_latency_us - video_latency_us : 0;
+    sync_stats.target_latency_us = target_us;
+    sync_stats.correction_ppm = ppm;
+    sync_stats.valid = 1;
+    pthread_mutex_unlock(&sync_lock);
+
+    return ppm;
+}
+
 static int alsa_stream(const char *pdevice, const char *cdevice, int latency)
 {
     snd_pcm_t *phandle, *chandle;
-    char *buffer;
-    int err;
+    char *buffer, *resampled;
+    int err, framesize, ppm = 0;
+    long long correction = 0;
+    double avg_latency_us = 0;
     ssize_t r;
     struct final_params negotiated;
     snd_pcm_format_t format = SND_PCM_FORMAT_S16_LE;
@@ -525,10 +645,14 @@ static int alsa_stream(const char *pdevice, const char *cdevice, int latency)
 	return 1;
     }
 
-    buffer = malloc((negotiated.bufsize * snd_pcm_format_width(format) / 8)
-		    * negotiated.channels);
-    if (buffer == NULL) {
+    framesize = snd_pcm_format_width(format) / 8 * negotiated.channels;
+    buffer = malloc(negotiated.bufsize * framesize);
+    /* room for stretching the audio by up to SYNC_MAX_PPM */
+    resampled = malloc((negotiated.bufsize + negotiated.bufsize / 32 + 2) * framesize);
+    if (buffer == NULL || resampled == NULL) {
 	fprintf(error_fp, "alsa: Failed allocating buffer for audio\n");
+	free(buffer);
+	free(resampled);
 	snd_pcm_close(phandle);
 	snd_pcm_close(chandle);
 	return 0;
@@ -545,8 +669,25 @@ static int alsa_stream(const char *pdevice, const char *cdevice, int latency)
 	r = readbuf(chandle, buffer, negotiated.bufsize);
 	if (r == 0)   /* Succesfully recovered from an overrun? */
 	    continue; /* Force restart of capture stream */
-	if (r > 0)
-	    writebuf(phandle, buffer, r);
+	if (r > 0) {
+	    long frames = r;
+
+	    /*
+	     * Accumulate the correction in frames, and apply it once it
+	     * amounts to at least one whole frame
+	     */
+	    correction += (long long)r * ppm;
+	    if (r > 2 && (correction >= 1000000 || correction <= -1000000)) {
+		frames = r - correction / 1000000;
+		correction %= 1000000;
+		resample((short *)buffer, r, (short *)resampled, frames,
+			 negotiated.channels);
+		writebuf(phandle, resampled, frames, framesize);
+	    } else {
+		writebuf(phandle, buffer, r, framesize);
+	    }
+	    ppm = sync_update(phandle, chandle, &negotiated, &avg_latency_us);
+	}
 	/* use poll to wait for next event */
 	while (!stop_alsa && !snd_pcm_wait(chandle, 50))
 	    ;
@@ -562,6 +703,13 @@ static int alsa_stream(const char *pdevice, const char *cdevice, int latency)
     snd_pcm_close(phandle);
     snd_pcm_close(chandle);
 
+    free(buffer);
+    free(resampled);
+
+    pthread_mutex_lock(&sync_lock);
+    sync_stats.valid = 0;
+    pthread_mutex_unlock(&sync_lock);
+
     return 0;
 }
 
@@ -629,6 +777,10 @@ int alsa_thread_startup(const char *pdevice, const char *cdevice, int latency,
     inputs->latency = latency;
 
     stop_alsa = 0;
+    pthread_mutex_lock(&sync_lock);
+    memset(&sync_stats, 0, sizeof(sync_stats));
+    video_latency_valid = 0;
+    pthread_mutex_unlock(&sync_lock);
     ret = pthread_create(&alsa_thread, NULL,
 			 &alsa_thread_entry, (void *) inputs);
     if (ret == 0)
@@ -652,14 +804,34 @@ int alsa_thread_is_running(void)
     return alsa_is_running;
 }
 
-void alsa_thread_timestamp(struct timeval *tv)
+void alsa_thread_video_timestamp(const struct timeval *tv)
 {
-	if (alsa_thread_is_running()) {
-		tv->tv_sec = timestamp.tv_sec;
-		tv->tv_usec = timestamp.tv_nsec / 1000;
-	} else {
-		tv->tv_sec = 0;
-		tv->tv_usec = 0;
-	}
+	struct timespec now;
+	long long latency;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	latency = timespec_to_us(&now) - (tv->tv_sec * 1000000LL + tv->tv_usec);
+	/* Ignore timestamps that are obviously not from the same clock */
+	if (latency < 0 || latency > 10000000)
+		return;
+
+	pthread_mutex_lock(&sync_lock);
+	if (!video_latency_valid)
+		video_latency_us = latency;
+	else
+		video_latency_us += (latency - video_latency_us) / 16;
+	video_latency_valid = 1;
+	pthread_mutex_unlock(&sync_lock);
+}
+
+int alsa_thread_sync_stats(struct alsa_sync_stats *stats)
+{
+	int valid;
+
+	pthread_mutex_lock(&sync_lock);
+	*stats = sync_stats;
+	valid = sync_stats.valid;
+	pthread_mutex_unlock(&sync_lock);
+	return valid;
 }
 #endif
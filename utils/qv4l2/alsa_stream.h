@@ -4,9 +4,24 @@
 #include <stdio.h>
 #include <sys/time.h>
 
+struct alsa_sync_stats {
+	int valid;
+	/* Average latency from audio capture to playback */
+	int audio_latency_us;
+	/* Average latency from V4L2 buffer timestamp to display, or 0 */
+	int video_latency_us;
+	/* audio_latency_us - video_latency_us, positive if audio lags */
+	int av_offset_us;
+	/* The audio latency the sync engine is steering towards */
+	int target_latency_us;
+	/* Current resampling correction, positive when dropping audio */
+	int correction_ppm;
+};
+
 int alsa_thread_startup(const char *pdevice, const char *cdevice,
 			int latency, FILE *__error_fp, int __verbose);
 void alsa_thread_stop(void);
 int alsa_thread_is_running(void);
-void alsa_thread_timestamp(struct timeval *tv);
+void alsa_thread_video_timestamp(const struct timeval *tv);
+int alsa_thread_sync_stats(struct alsa_sync_stats *stats);
 #endif
@@ -1024,9 +1024,6 @@ void ApplicationWindow::capFrame()
 	unsigned bytesused[3];
 	int s = 0;
 	int err = 0;
-#ifdef HAVE_ALSA
-	struct timeval tv_alsa;
-#endif
 
 	if (m_singleStep)
 		m_capNotifier->setEnabled(false);
@@ -1035,10 +1032,6 @@ void ApplicationWindow::capFrame()
 	switch (m_capMethod) {
 	case methodRead:
 		s = read(m_frameData, m_capSrcFormat.g_sizeimage(0));
-#ifdef HAVE_ALSA
-		alsa_thread_timestamp(&tv_alsa);
-#endif
-
 		if (s < 0) {
 			if (errno != EAGAIN) {
 				error("read");
@@ -1079,10 +1072,6 @@ void ApplicationWindow::capFrame()
 			return;
 		}
 
-#ifdef HAVE_ALSA
-		alsa_thread_timestamp(&tv_alsa);
-#endif
-
 		plane[0] = (__u8 *)m_queue.g_dataptr(buf.g_index(), 0);
 		plane[1] = (__u8 *)m_queue.g_dataptr(buf.g_index(), 1);
 		plane[2] = (__u8 *)m_queue.g_dataptr(buf.g_index(), 2);
@@ -1127,12 +1116,22 @@ void ApplicationWindow::capFrame()
 		status.append(QString(" SeqNr: %1").arg(buf.g_sequence()));
 #ifdef HAVE_ALSA
 	if (m_capMethod != methodRead && alsa_thread_is_running()) {
-		if (tv_alsa.tv_sec || tv_alsa.tv_usec) {
-			m_totalAudioLatency.tv_sec += buf.g_timestamp().tv_sec - tv_alsa.tv_sec;
-			m_totalAudioLatency.tv_usec += buf.g_timestamp().tv_usec - tv_alsa.tv_usec;
+		struct alsa_sync_stats stats;
+
+		/*
+		 * Only monotonic timestamps can be compared with the audio
+		 * timestamps, without them the audio just compensates the
+		 * drift between the capture and playback clocks.
+		 */
+		if (buf.g_timestamp_type() == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+			alsa_thread_video_timestamp(&buf.g_timestamp());
+		if (alsa_thread_sync_stats(&stats)) {
+			if (stats.video_latency_us)
+				status.append(QString(" A-V: %1 ms")
+					      .arg(stats.av_offset_us / 1000));
+			status.append(QString(" Audio Latency: %1 ms")
+				      .arg(stats.audio_latency_us / 1000));
 		}
-		status.append(QString(" Average A-V: %1 ms")
-			      .arg((m_totalAudioLatency.tv_sec * 1000 + m_totalAudioLatency.tv_usec / 1000) / m_frame));
 	}
 #endif
 	if (plane[0] == NULL && showFrames())
@@ -1258,9 +1257,6 @@ void ApplicationWindow::clearBuffers()
 void ApplicationWindow::startAudio()
 {
 #ifdef HAVE_ALSA
-	m_totalAudioLatency.tv_sec = 0;
-	m_totalAudioLatency.tv_usec = 0;
-
 	QString audIn = m_genTab->getAudioInDevice();
 	QString audOut = m_genTab->getAudioOutDevice();
 
@@ -292,7 +292,6 @@ private:
 	unsigned m_frame;
 	double m_fps;
 	struct timespec m_startTimestamp;
-	struct timeval m_totalAudioLatency;
 	QFile m_saveRaw;
 };
 
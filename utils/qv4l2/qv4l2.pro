@@ -24,7 +24,7 @@ HEADERS += capture-win.h
 HEADERS += capture-win-qt.h
 HEADERS += general-tab.h
 HEADERS += qv4l2.h
-HEADERS += raw2sliced.h
+HEADERS += ../common/raw2sliced.h
 HEADERS += vbi-tab.h
 HEADERS += ../common/v4l2-tpg.h
 HEADERS += ../common/v4l2-tpg-colors.h
@@ -0,0 +1 @@
+../common/raw2sliced.cpp
\ No newline at end of file
@@ -67,6 +67,9 @@ enum Option {
 	OptMediaBusInfo = 'z',
 	OptStreamFrom = 128,
 	OptStreamFromHdr,
+	OptShard,
+	OptStreamCheckpoint,
+	OptStreamAdaptive,
 	OptVersion,
 	OptLast = 256
 };
@@ -89,6 +92,10 @@ bool is_uvcvideo;
 int media_fd = -1;
 unsigned warnings;
 bool has_mmu = true;
+unsigned shard_index;
+unsigned shard_count = 1;
+const char *stream_checkpoint;
+bool stream_adaptive;
 
 static unsigned color_component;
 static unsigned color_skip;
@@ -144,6 +151,9 @@ static struct option long_options[] = {
 	{"stream-all-formats", optional_argument, nullptr, OptStreamAllFormats},
 	{"stream-all-io", no_argument, nullptr, OptStreamAllIO},
 	{"stream-all-color", required_argument, nullptr, OptStreamAllColorTest},
+	{"shard", required_argument, nullptr, OptShard},
+	{"stream-checkpoint", required_argument, nullptr, OptStreamCheckpoint},
+	{"stream-adaptive", no_argument, nullptr, OptStreamAdaptive},
 	{"version", no_argument, nullptr, OptVersion},
 	{nullptr, 0, nullptr, 0}
 };
@@ -241,6 +251,15 @@ static void usage()
 	printf("                     for one second for all formats, at all sizes, at all intervals\n");
 	printf("                     and with all field values. If <count> is given, then stream\n");
 	printf("                     for that many frames instead of one second.\n");
+	printf("  --shard <i>/<n>    Split the --stream-all-formats tests in <n> parts and only\n");
+	printf("                     run part <i> (0 <= <i> < <n>).\n");
+	printf("  --stream-checkpoint <file>\n");
+	printf("                     Record each format, size and interval that passed the\n");
+	printf("                     --stream-all-formats tests in <file>, and skip those that are\n");
+	printf("                     already recorded there. This allows resuming an interrupted run.\n");
+	printf("  --stream-adaptive  Stop streaming a --stream-all-formats combination as soon as\n");
+	printf("                     the frame rate is stable instead of after one second or <count>\n");
+	printf("                     frames.\n");
 	printf("  -a, --stream-all-io\n");
 	printf("                     Do streaming tests for all inputs or outputs instead of just\n");
 	printf("                     the current input or output. This requires that a valid video\n");
@@ -1636,6 +1655,20 @@ int main(int argc, char **argv)
 			if (optarg)
 				all_fmt_frame_count = strtoul(optarg, nullptr, 0);
 			break;
+		case OptShard:
+			if (sscanf(optarg, "%u/%u", &shard_index, &shard_count) != 2 ||
+			    shard_index >= shard_count) {
+				fprintf(stderr, "invalid shard '%s'\n", optarg);
+				usage();
+				std::exit(EXIT_FAILURE);
+			}
+			break;
+		case OptStreamCheckpoint:
+			stream_checkpoint = optarg;
+			break;
+		case OptStreamAdaptive:
+			stream_adaptive = true;
+			break;
 		case OptStreamAllColorTest:
 			subs = optarg;
 			while (*subs != '\0') {
@@ -59,6 +59,9 @@ extern int kernel_version;
 extern int media_fd;
 extern unsigned warnings;
 extern bool has_mmu;
+extern unsigned shard_index, shard_count;
+extern const char *stream_checkpoint;
+extern bool stream_adaptive;
 
 enum poll_mode {
 	POLL_MODE_NONE,
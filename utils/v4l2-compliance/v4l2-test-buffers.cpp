@@ -2905,9 +2905,46 @@ int restoreFormat(struct node *node)
 	return 0;
 }
 
+/*
+ * Used by --stream-adaptive: keeps the times of the last frames and
+ * reports if the intervals between them are stable.
+ */
+#define STEADY_STATE_FRAMES 8
+
+struct steadyState {
+	double ts[STEADY_STATE_FRAMES + 1];
+	unsigned cnt;
+
+	bool add();
+};
+
+bool steadyState::add()
+{
+	struct timespec now;
+	double min = 0, max = 0, sum = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ts[cnt++ % (STEADY_STATE_FRAMES + 1)] = now.tv_sec + now.tv_nsec / 1000000000.0;
+	if (cnt <= STEADY_STATE_FRAMES)
+		return false;
+
+	for (unsigned i = 0; i < STEADY_STATE_FRAMES; i++) {
+		unsigned first = (cnt + i) % (STEADY_STATE_FRAMES + 1);
+		double interval = ts[(first + 1) % (STEADY_STATE_FRAMES + 1)] - ts[first];
+
+		if (!i || interval < min)
+			min = interval;
+		if (!i || interval > max)
+			max = interval;
+		sum += interval;
+	}
+	return max - min <= sum / STEADY_STATE_FRAMES / 10;
+}
+
 static int testStreaming(struct node *node, unsigned frame_count)
 {
 	int type = node->g_type();
+	steadyState steady = {};
 
 	if (!(node->valid_buftypes & (1 << type)))
 		return ENOTTY;
@@ -2964,6 +3001,8 @@ static int testStreaming(struct node *node, unsigned frame_count)
 			fail_on_test(buf.g_flags() & V4L2_BUF_FLAG_DONE);
 			if (--frame_count == 0)
 				break;
+			if (stream_adaptive && steady.add())
+				break;
 		}
 		q.free(node);
 		if (is_output)
@@ -2988,6 +3027,8 @@ static int testStreaming(struct node *node, unsigned frame_count)
 		if (!no_progress)
 			printf("\r\t\t%s: Frame #%03d", buftype2s(type).c_str(), i);
 		fflush(stdout);
+		if (stream_adaptive && steady.add())
+			break;
 	}
 	if (!no_progress)
 		printf("\r\t\t                                                            ");
@@ -3043,6 +3084,12 @@ static bool haveSelTest(const selTest &test)
 		{ return &selfTest != &test; });
 }
 
+/*
+ * For --stream-checkpoint: set if any test of the current combination of
+ * format, frame size and interval failed.
+ */
+static bool stream_fmt_failed;
+
 static void streamFmtRun(struct node *node, cv4l_fmt &fmt, unsigned frame_count,
 		bool testSelection = false)
 {
@@ -3058,6 +3105,7 @@ static void streamFmtRun(struct node *node, cv4l_fmt &fmt, unsigned frame_count,
 	bool has_crop = node->cur_io_has_crop();
 	char s_crop[32] = "";
 	char s_compose[32] = "";
+	int ret;
 
 	if (has_crop) {
 		node->g_frame_selection(crop, fmt.g_field());
@@ -3071,17 +3119,20 @@ static void streamFmtRun(struct node *node, cv4l_fmt &fmt, unsigned frame_count,
 				compose.r.width, compose.r.height,
 				compose.r.left, compose.r.top);
 	}
+	ret = testStreaming(node, frame_count);
+	if (ret && ret != ENOTTY)
+		stream_fmt_failed = true;
 	printf("\r\t\t%s%sStride %u, Field %s%s: %s   \n",
 			s_crop, s_compose,
 			fmt.g_bytesperline(),
 			field2s(fmt.g_field()).c_str(),
 			testSelection ? ", SelTest" : "",
-			ok(testStreaming(node, frame_count)));
+			ok(ret));
 	node->reopen();
 }
 
-static void streamFmt(struct node *node, __u32 pixelformat, __u32 w, __u32 h,
-		      v4l2_fract *f, unsigned frame_count)
+static void streamFmtTests(struct node *node, __u32 pixelformat, __u32 w, __u32 h,
+			   v4l2_fract *f, unsigned frame_count)
 {
 	const char *op = (node->g_caps() & V4L2_CAP_STREAMING) ? "MMAP" :
 		(node->can_capture ? "read()" : "write()");
@@ -3148,7 +3199,7 @@ static void streamFmt(struct node *node, __u32 pixelformat, __u32 w, __u32 h,
 		if (fmt.g_bytesperline() == bpl)
 			continue;
 		if (fmt.g_sizeimage() <= size)
-			fail("fmt.g_sizeimage() <= size\n");
+			stream_fmt_failed = fail("fmt.g_sizeimage() <= size\n");
 		streamFmtRun(node, fmt, frame_count);
 	}
 
@@ -3206,7 +3257,7 @@ static void streamFmt(struct node *node, __u32 pixelformat, __u32 w, __u32 h,
 		node->g_fmt(tmp);
 		if (tmp.g_width() != fmt.g_width() ||
 		    tmp.g_height() != fmt.g_height())
-			fail("Format resolution changed after changing to min crop\n");
+			stream_fmt_failed = fail("Format resolution changed after changing to min crop\n");
 		selTest test = createSelTest(node);
 		if (!haveSelTest(test)) {
 			selTests.push_back(test);
@@ -3216,7 +3267,7 @@ static void streamFmt(struct node *node, __u32 pixelformat, __u32 w, __u32 h,
 		node->g_fmt(tmp);
 		if (tmp.g_width() != fmt.g_width() ||
 		    tmp.g_height() != fmt.g_height())
-			fail("Format resolution changed after changing to max crop\n");
+			stream_fmt_failed = fail("Format resolution changed after changing to max crop\n");
 		test = createSelTest(node);
 		if (!haveSelTest(test)) {
 			selTests.push_back(test);
@@ -3231,7 +3282,7 @@ static void streamFmt(struct node *node, __u32 pixelformat, __u32 w, __u32 h,
 		node->g_fmt(tmp);
 		if (tmp.g_width() != fmt.g_width() ||
 		    tmp.g_height() != fmt.g_height())
-			fail("Format resolution changed after changing to min compose\n");
+			stream_fmt_failed = fail("Format resolution changed after changing to min compose\n");
 		selTest test = createSelTest(node);
 		if (!haveSelTest(test)) {
 			selTests.push_back(test);
@@ -3241,7 +3292,7 @@ static void streamFmt(struct node *node, __u32 pixelformat, __u32 w, __u32 h,
 		node->g_fmt(tmp);
 		if (tmp.g_width() != fmt.g_width() ||
 		    tmp.g_height() != fmt.g_height())
-			fail("Format resolution changed after changing to max compose\n");
+			stream_fmt_failed = fail("Format resolution changed after changing to max compose\n");
 		test = createSelTest(node);
 		if (!haveSelTest(test)) {
 			selTests.push_back(test);
@@ -3271,7 +3322,7 @@ static void streamFmt(struct node *node, __u32 pixelformat, __u32 w, __u32 h,
 		node->g_fmt(tmp);
 		if (tmp.g_width() != fmt.g_width() ||
 		    tmp.g_height() != fmt.g_height())
-			fail("Format resolution changed after changing first selection\n");
+			stream_fmt_failed = fail("Format resolution changed after changing first selection\n");
 		selTest test = createSelTest(node);
 		if (!haveSelTest(test)) {
 			selTests.push_back(test);
@@ -3282,7 +3333,7 @@ static void streamFmt(struct node *node, __u32 pixelformat, __u32 w, __u32 h,
 		node->g_fmt(tmp);
 		if (tmp.g_width() != fmt.g_width() ||
 		    tmp.g_height() != fmt.g_height())
-			fail("Format resolution changed after changing second selection\n");
+			stream_fmt_failed = fail("Format resolution changed after changing second selection\n");
 		test = createSelTest(node);
 		if (!haveSelTest(test)) {
 			selTests.push_back(test);
@@ -3293,7 +3344,7 @@ static void streamFmt(struct node *node, __u32 pixelformat, __u32 w, __u32 h,
 		node->g_fmt(tmp);
 		if (tmp.g_width() != fmt.g_width() ||
 		    tmp.g_height() != fmt.g_height())
-			fail("Format resolution changed after changing third selection\n");
+			stream_fmt_failed = fail("Format resolution changed after changing third selection\n");
 		test = createSelTest(node);
 		if (!haveSelTest(test)) {
 			selTests.push_back(test);
@@ -3303,6 +3354,51 @@ static void streamFmt(struct node *node, __u32 pixelformat, __u32 w, __u32 h,
 	restoreCropCompose(node, fmt.g_field(), crop, compose);
 }
 
+/*
+ * For --shard and --stream-checkpoint: streamFmt() is called for every
+ * combination of format, frame size and interval, and the combinations
+ * are numbered in the order they are enumerated.
+ */
+static unsigned stream_fmt_idx;
+static unsigned stream_fmt_run;
+static std::set<std::string> stream_fmt_done;
+static FILE *stream_checkpoint_file;
+
+static void streamFmt(struct node *node, __u32 pixelformat, __u32 w, __u32 h,
+		      v4l2_fract *f, unsigned frame_count)
+{
+	std::string key;
+	__u32 io = 0;
+
+	if (stream_fmt_idx++ % shard_count != shard_index)
+		return;
+
+	// with --stream-all-io this is called for each input or output
+	if (node->can_capture)
+		node->g_input(io);
+	else
+		node->g_output(io);
+	key = std::string(node->can_capture ? "input " : "output ") +
+	      std::to_string(io) + ": " + fcc2s(pixelformat) + " " +
+	      std::to_string(w) + "x" + std::to_string(h) + " " +
+	      std::to_string(f ? f->numerator : 0) + "/" +
+	      std::to_string(f ? f->denominator : 0);
+	if (stream_fmt_done.count(key)) {
+		printf("\ttest %s: done in a previous run\n", key.c_str());
+		return;
+	}
+
+	stream_fmt_run++;
+	stream_fmt_failed = false;
+	streamFmtTests(node, pixelformat, w, h, f, frame_count);
+
+	// only passing combinations are skipped when resuming
+	if (stream_checkpoint_file && !stream_fmt_failed) {
+		fprintf(stream_checkpoint_file, "%s\n", key.c_str());
+		fflush(stream_checkpoint_file);
+	}
+}
+
 static void streamIntervals(struct node *node, __u32 pixelformat, __u32 w, __u32 h,
 			    unsigned frame_count)
 {
@@ -3324,6 +3420,39 @@ static void streamIntervals(struct node *node, __u32 pixelformat, __u32 w, __u32
 	streamFmt(node, pixelformat, w, h, &frmival.stepwise.max, frame_count);
 }
 
+static void openStreamCheckpoint()
+{
+	char line[80];
+	FILE *f;
+
+	stream_fmt_done.clear();
+	if (!stream_checkpoint)
+		return;
+
+	f = fopen(stream_checkpoint, "r");
+	if (f) {
+		while (fgets(line, sizeof(line), f)) {
+			line[strcspn(line, "\n")] = '\0';
+			stream_fmt_done.insert(line);
+		}
+		fclose(f);
+	}
+	stream_checkpoint_file = fopen(stream_checkpoint, "a");
+	if (!stream_checkpoint_file)
+		warn("cannot open checkpoint file %s: %s\n",
+		     stream_checkpoint, strerror(errno));
+}
+
+static void closeStreamCheckpoint()
+{
+	if (stream_checkpoint_file)
+		fclose(stream_checkpoint_file);
+	stream_checkpoint_file = nullptr;
+	if (shard_count > 1)
+		printf("\tShard %u/%u: tested %u of %u format combinations\n\n",
+		       shard_index, shard_count, stream_fmt_run, stream_fmt_idx);
+}
+
 void streamAllFormats(struct node *node, unsigned frame_count)
 {
 	v4l2_fmtdesc fmtdesc;
@@ -3331,6 +3460,8 @@ void streamAllFormats(struct node *node, unsigned frame_count)
 	if (node->enum_fmt(fmtdesc, true))
 		return;
 	selTests.clear();
+	stream_fmt_idx = stream_fmt_run = 0;
+	openStreamCheckpoint();
 	do {
 		v4l2_frmsizeenum frmsize;
 		cv4l_fmt fmt;
@@ -3403,6 +3534,7 @@ void streamAllFormats(struct node *node, unsigned frame_count)
 			break;
 		}
 	} while (!node->enum_fmt(fmtdesc));
+	closeStreamCheckpoint();
 }
 
 static void streamM2MRun(struct node *node, unsigned frame_count)
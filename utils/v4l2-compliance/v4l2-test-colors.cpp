@@ -15,10 +15,14 @@
  */
 
 #include <cstdio>
+#include <cstring>
 #include <map>
 #include <set>
+#include <vector>
 
+#include <pthread.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include "compiler.h"
 #include "v4l2-compliance.h"
@@ -88,8 +92,12 @@ static void ycbcr2rgb(const double m[3][3], double y, double cb, double cr,
 	c.b = m[2][0] * y + m[2][1] * cb + m[2][2] * cr;
 }
 
-static void getColor(const cv4l_fmt &fmt, __u8 * const planes[3],
-		unsigned y, unsigned x, color &c)
+/*
+ * Return the packed value of the pixel at (x, y): the v8, v16 or v32
+ * value depending on the format. This is all rawToColor() needs.
+ */
+static __u32 getRawColor(const cv4l_fmt &fmt, __u8 * const planes[3],
+			 unsigned y, unsigned x)
 {
 	unsigned bpl = fmt.g_bytesperline();
 	unsigned yeven = y & ~1;
@@ -305,6 +313,16 @@ static void getColor(const cv4l_fmt &fmt, __u8 * const planes[3],
 		break;
 	}
 
+	// only one of these is set for any given format
+	return v8 | v16 | v32;
+}
+
+static void rawToColor(const cv4l_fmt &fmt, __u32 v, color &c)
+{
+	__u8 v8 = v;
+	__u16 v16 = v;
+	__u32 v32 = v;
+
 	switch (fmt.g_pixelformat()) {
 	case V4L2_PIX_FMT_RGB332:
 		c.r = (v8 >> 5) / 7.0;
@@ -475,6 +493,64 @@ static constexpr const char *colors[] = {
 	"blue"
 };
 
+static unsigned classifyColor(const cv4l_fmt &fmt, __u32 v)
+{
+	color c = { 0, 0, 0, 0 };
+
+	rawToColor(fmt, v, c);
+	if (c.r > c.b && c.r > c.g)
+		return 0;
+	if (c.g > c.r && c.g > c.b)
+		return 1;
+	return 2;
+}
+
+/*
+ * Test patterns consist of few distinct colors, so cache the dominant
+ * color component of recently seen pixel values instead of doing the
+ * floating point conversion for every pixel. The result is identical
+ * to converting every pixel.
+ */
+#define COLOR_CACHE_BITS	12
+#define COLOR_CACHE_SIZE	(1U << COLOR_CACHE_BITS)
+#define COLOR_CACHE_EMPTY	0xff
+
+struct color_region {
+	const cv4l_fmt *fmt;
+	__u8 * const *planes;
+	unsigned y_start, y_end;
+	unsigned w;
+	bool is_50hz;
+	unsigned color_cnt[3];
+	__u32 cache_val[COLOR_CACHE_SIZE];
+	__u8 cache_cls[COLOR_CACHE_SIZE];
+};
+
+static void *countColors(void *arg)
+{
+	auto r = static_cast<color_region *>(arg);
+
+	memset(r->cache_cls, COLOR_CACHE_EMPTY, sizeof(r->cache_cls));
+	for (unsigned y = r->y_start; y < r->y_end; y++) {
+		/*
+		 * 50 Hz (PAL/SECAM) formats have a garbage first half-line,
+		 * so skip that.
+		 */
+		for (unsigned x = (y == 0 && r->is_50hz) ? r->w / 2 : 0; x < r->w; x++) {
+			__u32 v = getRawColor(*r->fmt, r->planes, y, x);
+			unsigned idx = (v * 2654435761U) >> (32 - COLOR_CACHE_BITS);
+
+			if (r->cache_cls[idx] == COLOR_CACHE_EMPTY ||
+			    r->cache_val[idx] != v) {
+				r->cache_val[idx] = v;
+				r->cache_cls[idx] = classifyColor(*r->fmt, v);
+			}
+			r->color_cnt[r->cache_cls[idx]]++;
+		}
+	}
+	return nullptr;
+}
+
 static int testColorsFmt(struct node *node, unsigned component,
 		unsigned skip, unsigned perc)
 {
@@ -551,23 +627,40 @@ static int testColorsFmt(struct node *node, unsigned component,
 
 	total = w * h - (is_50hz ? w / 2 : 0);
 
-	for (unsigned y = 0; y < h; y++) {
-		/*
-		 * 50 Hz (PAL/SECAM) formats have a garbage first half-line,
-		 * so skip that.
-		 */
-		for (unsigned x = (y == 0 && is_50hz) ? w / 2 : 0; x < w; x++) {
-			color c = { 0, 0, 0, 0 };
-
-			getColor(fmt, planes, y, x, c);
-			if (c.r > c.b && c.r > c.g)
-				color_cnt[0]++;
-			else if (c.g > c.r && c.g > c.b)
-				color_cnt[1]++;
-			else
-				color_cnt[2]++;
-		}
+	/* Split the image in bands of lines, one per CPU */
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned num_regions = cpus > 1 ? (cpus > 16 ? 16 : cpus) : 1;
+
+	if (num_regions > h / 16)
+		num_regions = h / 16 ? h / 16 : 1;
+
+	std::vector<color_region> regions(num_regions);
+	std::vector<pthread_t> threads(num_regions);
+	std::vector<bool> started(num_regions);
+
+	for (unsigned i = 0; i < num_regions; i++) {
+		color_region &r = regions[i];
+
+		r.fmt = &fmt;
+		r.planes = planes;
+		r.y_start = h * i / num_regions;
+		r.y_end = h * (i + 1) / num_regions;
+		r.w = w;
+		r.is_50hz = is_50hz;
+		memset(r.color_cnt, 0, sizeof(r.color_cnt));
+		// the first region is done by this thread
+		started[i] = i && !pthread_create(&threads[i], nullptr, countColors, &r);
+	}
+	countColors(&regions[0]);
+	for (unsigned i = 1; i < num_regions; i++) {
+		if (started[i])
+			pthread_join(threads[i], nullptr);
+		else
+			countColors(&regions[i]);
 	}
+	for (const auto &r : regions)
+		for (unsigned i = 0; i < 3; i++)
+			color_cnt[i] += r.color_cnt[i];
 	if (node->g_caps() & V4L2_CAP_STREAMING)
 		q.free(node);
 	else
@@ -1,6 +1,9 @@
 #include <cstring>
+#include <vector>
 
 #include <netdb.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 
 #include <linux/media.h>
@@ -8,6 +11,7 @@
 #include "compiler.h"
 #include "v4l2-ctl.h"
 #include "v4l-stream.h"
+#include "raw2sliced.h"
 #include <media-info.h>
 
 extern "C" {
@@ -51,6 +55,8 @@ static unsigned comp_perc;
 static unsigned comp_perc_count;
 static char *file_from;
 static bool from_with_hdr;
+static unsigned from_hdr_seek;
+static unsigned from_preload;
 static char *host_from;
 static unsigned host_port_from = V4L_STREAM_PORT;
 static int host_fd_from = -1;
@@ -68,6 +74,12 @@ static unsigned int composed_height;
 static bool support_cap_compose;
 static bool support_out_crop;
 static bool in_source_change_event;
+static bool slice_vbi;
+static struct vbi_handle vbi_slicer;
+static std::vector<struct v4l2_sliced_vbi_data> vbi_sliced_data;
+static unsigned vbi_sliced_bufs;
+static unsigned vbi_sliced_lines;
+static double vbi_slice_time;
 
 static __u64 last_fwht_bf_ts;
 static fwht_cframe_hdr last_fwht_hdr;
@@ -82,6 +94,39 @@ static request_fwht fwht_reqs[VIDEO_MAX_FRAME];
 
 #define TS_WINDOW 241
 #define FILE_HDR_ID			v4l2_fourcc('V', 'h', 'd', 'r')
+#define FILE_IDX_ID			v4l2_fourcc('V', 'i', 'd', 'x')
+
+/*
+ * Files written with --stream-to-hdr get an index of all frames in a
+ * separate <file>.idx, so that readers of the frame file itself never see
+ * it:
+ *
+ * FILE_IDX_ID, <size of the frame file>, <count>, <count> index entries
+ *
+ * Like the frame file, it consists of big-endian u32 values, 64 bit values
+ * are stored as two u32 values, the most significant one first. The index
+ * allows mapping the frame file and seeking to any frame, files without
+ * one are read sequentially.
+ */
+struct hdr_index_entry {
+	__u64 offset;	// offset of the FILE_HDR_ID of this frame
+	__u32 size;	// size of the frame, including the headers
+};
+
+#define HDR_INDEX_HEADER_SIZE		(4 * 4)
+#define HDR_INDEX_ENTRY_SIZE		(3 * 4)
+
+static std::vector<hdr_index_entry> hdr_index_out;
+
+// A --stream-from-hdr file with an index, mapped in memory
+static struct {
+	FILE *fin;
+	__u8 *map;
+	size_t size;
+	std::vector<hdr_index_entry> index;
+	unsigned cur;
+	bool copy;	// the frames can be copied straight from the map
+} hdr_in;
 
 enum codec_type {
 	NOT_CODEC,
@@ -264,6 +309,7 @@ void streaming_usage()
 	       "                     and the --silent option is turned on automatically.\n"
 	       "  --stream-to-hdr <file> stream to this file. Same as --stream-to, but each\n"
 	       "                     frame is prefixed by a header. Use for compressed data.\n"
+	       "                     If <file> is seekable, a frame index is written to <file>.idx.\n"
 	       "  --stream-to-host <hostname[:port]>\n"
                "                     stream to this host. The default port is %d.\n"
 	       "  --stream-lossless  always use lossless video compression.\n"
@@ -274,6 +320,9 @@ void streaming_usage()
 	       "                     output the difference between the buffer timestamp and current\n"
 	       "                     clock, if the buffer timestamp source is the monotonic clock.\n"
 	       "                     Requires --verbose as well.\n"
+	       "  --stream-slice-vbi slice captured raw VBI into teletext, CC, WSS and VPS data.\n"
+	       "                     The sliced VBI data is written instead of the raw VBI data\n"
+	       "                     and slicing statistics are shown when streaming stops.\n"
 	       "  --stream-mmap <count>\n"
 	       "                     capture video using mmap() [VIDIOC_(D)QBUF]\n"
 	       "                     count: the number of buffers to allocate. The default is 3.\n"
@@ -287,6 +336,17 @@ void streaming_usage()
 	       "                     If <file> is '-', then the data is read from stdin.\n"
 	       "  --stream-from-hdr <file> stream from this file. Same as --stream-from, but each\n"
 	       "                     frame is prefixed by a header. Use for compressed data.\n"
+	       "                     Files written by --stream-to-hdr get a frame index in <file>.idx,\n"
+	       "                     indexed files are mapped in memory instead of read frame by frame.\n"
+	       "  --stream-from-hdr-seek <frame>\n"
+	       "                     start streaming from frame <frame> of the --stream-from-hdr file.\n"
+	       "                     This requires a file with a frame index. The default is 0.\n"
+	       "  --stream-from-preload <frames>\n"
+	       "                     read the first <frames> frames of the --stream-from(-hdr) file\n"
+	       "                     into memory before streaming starts, and stream from memory\n"
+	       "                     so file I/O does not affect the output rate. Combine with\n"
+	       "                     --stream-loop to repeat them. If <frames> equals the number\n"
+	       "                     of mmap output buffers, each buffer is filled only once.\n"
 	       "  --stream-from-host <hostname[:port]>\n"
 	       "                     stream from this host. The default port is %d.\n"
 	       "  --stream-no-query  Do not query and set the DV timings or standard before streaming.\n"
@@ -456,6 +516,152 @@ static void write_u32(FILE *f, __u32 v)
 	fwrite(&v, 1, sizeof(v), f);
 }
 
+static void write_u64(FILE *f, __u64 v)
+{
+	write_u32(f, v >> 32);
+	write_u32(f, v);
+}
+
+static __u32 get_u32(const __u8 *p)
+{
+	__u32 v;
+
+	memcpy(&v, p, sizeof(v));
+	return ntohl(v);
+}
+
+static __u64 get_u64(const __u8 *p)
+{
+	return (static_cast<__u64>(get_u32(p)) << 32) | get_u32(p + 4);
+}
+
+static void add_hdr_index(FILE *fout, off_t offset)
+{
+	off_t end = ftello(fout);
+
+	// Not seekable, so no index can be written for this stream
+	if (offset < 0 || end < 0)
+		return;
+	hdr_index_out.push_back({ static_cast<__u64>(offset),
+				  static_cast<__u32>(end - offset) });
+}
+
+static std::string hdr_index_name(const char *file)
+{
+	return std::string(file) + ".idx";
+}
+
+static void close_output_file(FILE *fout)
+{
+	off_t size = ftello(fout);
+
+	if (to_with_hdr && host_fd_to < 0 && fout != stdout && size >= 0 &&
+	    !hdr_index_out.empty()) {
+		std::string name = hdr_index_name(file_to);
+		FILE *fidx = fopen(name.c_str(), "w");
+
+		if (fidx) {
+			write_u32(fidx, FILE_IDX_ID);
+			write_u64(fidx, size);
+			write_u32(fidx, hdr_index_out.size());
+			for (const auto &e : hdr_index_out) {
+				write_u64(fidx, e.offset);
+				write_u32(fidx, e.size);
+			}
+			if (fclose(fidx)) {
+				fprintf(stderr, "could not write %s\n", name.c_str());
+				unlink(name.c_str());
+			}
+		} else {
+			fprintf(stderr, "could not open %s for writing\n", name.c_str());
+		}
+	}
+	hdr_index_out.clear();
+	fclose(fout);
+}
+
+/*
+ * Map a --stream-from-hdr file if it has a valid index. Returns false if
+ * it has to be read sequentially instead.
+ */
+static bool map_hdr_file(FILE *fin)
+{
+	std::string name = hdr_index_name(file_from);
+	std::vector<__u8> idx;
+	struct stat st;
+	FILE *fidx;
+	__u64 count;
+	__u8 *map;
+
+	hdr_in.fin = fin;
+	if (fstat(fileno(fin), &st) || !S_ISREG(st.st_mode) || !st.st_size)
+		return false;
+
+	fidx = fopen(name.c_str(), "r");
+	if (!fidx)
+		return false;
+	idx.resize(HDR_INDEX_HEADER_SIZE);
+	if (fread(idx.data(), 1, idx.size(), fidx) != idx.size() ||
+	    get_u32(&idx[0]) != FILE_IDX_ID ||
+	    get_u64(&idx[4]) != static_cast<__u64>(st.st_size)) {
+		// e.g. left over from an earlier recording to the same file
+		fprintf(stderr, "%s does not match %s, reading sequentially\n",
+			name.c_str(), file_from);
+		fclose(fidx);
+		return false;
+	}
+	count = get_u32(&idx[12]);
+	idx.resize(HDR_INDEX_HEADER_SIZE + count * HDR_INDEX_ENTRY_SIZE);
+	if (fread(&idx[HDR_INDEX_HEADER_SIZE], 1, count * HDR_INDEX_ENTRY_SIZE,
+		  fidx) != count * HDR_INDEX_ENTRY_SIZE) {
+		fprintf(stderr, "%s is truncated, reading sequentially\n",
+			name.c_str());
+		fclose(fidx);
+		return false;
+	}
+	fclose(fidx);
+
+	map = static_cast<__u8 *>(mmap(nullptr, st.st_size, PROT_READ,
+				       MAP_SHARED, fileno(fin), 0));
+	if (map == MAP_FAILED)
+		return false;
+
+	hdr_in.index.resize(count);
+	for (unsigned i = 0; i < count; i++) {
+		const __u8 *p = &idx[HDR_INDEX_HEADER_SIZE + i * HDR_INDEX_ENTRY_SIZE];
+		hdr_index_entry &e = hdr_in.index[i];
+
+		e.offset = get_u64(p);
+		e.size = get_u32(p + 8);
+		if (e.size < 4 || e.offset > static_cast<__u64>(st.st_size) ||
+		    e.size > st.st_size - e.offset ||
+		    get_u32(map + e.offset) != FILE_HDR_ID) {
+			fprintf(stderr, "%s: corrupt index entry %u, reading sequentially\n",
+				name.c_str(), i);
+			hdr_in.index.clear();
+			munmap(map, st.st_size);
+			return false;
+		}
+	}
+	hdr_in.map = map;
+	hdr_in.size = st.st_size;
+	hdr_in.cur = 0;
+	return true;
+}
+
+static void close_input_file(FILE *fin)
+{
+	if (hdr_in.fin == fin) {
+		if (hdr_in.map)
+			munmap(hdr_in.map, hdr_in.size);
+		hdr_in.map = nullptr;
+		hdr_in.index.clear();
+		hdr_in.fin = nullptr;
+		hdr_in.copy = false;
+	}
+	fclose(fin);
+}
+
 static std::string timestamp_type2s(__u32 flags)
 {
 	char buf[20];
@@ -757,6 +963,12 @@ void streaming_cmd(int ch, char *optarg)
 		file_from = optarg;
 		from_with_hdr = true;
 		break;
+	case OptStreamFromHdrSeek:
+		from_hdr_seek = strtoul(optarg, nullptr, 0);
+		break;
+	case OptStreamFromPreload:
+		from_preload = strtoul(optarg, nullptr, 0);
+		break;
 	case OptStreamFromHost:
 		host_from = optarg;
 		break;
@@ -1066,6 +1278,64 @@ static bool fill_buffer_from_file(cv4l_fd &fd, cv4l_queue &q, cv4l_buffer &b,
 		return true;
 	}
 
+	if (from_with_hdr && hdr_in.fin != fin && fin != stdin) {
+		if (map_hdr_file(fin)) {
+			if (from_hdr_seek >= hdr_in.index.size()) {
+				fprintf(stderr, "cannot seek to frame %u, %s has %zu frames\n",
+					from_hdr_seek, file_from, hdr_in.index.size());
+				return false;
+			}
+			hdr_in.cur = from_hdr_seek;
+			// for the formats that are read via stdio
+			fseeko(fin, hdr_in.index[from_hdr_seek].offset, SEEK_SET);
+
+			cv4l_fmt cur_fmt;
+
+			fd.g_fmt(cur_fmt, q.g_type());
+			hdr_in.copy = cur_fmt.g_pixelformat() != V4L2_PIX_FMT_FWHT_STATELESS &&
+				      !(codec_type != NOT_CODEC && support_out_crop &&
+					v4l2_fwht_find_pixfmt(cur_fmt.g_pixelformat()));
+		} else if (from_hdr_seek) {
+			fprintf(stderr, "%s has no frame index, cannot seek\n", file_from);
+			return false;
+		}
+	}
+
+	/*
+	 * Copy the frame straight from the mapped file, the formats that
+	 * need special parsing are read via stdio below.
+	 */
+	if (from_with_hdr && hdr_in.map && hdr_in.fin == fin && hdr_in.copy) {
+		if (hdr_in.cur >= hdr_in.index.size()) {
+			if (!stream_loop || hdr_in.index.empty())
+				return false;
+			hdr_in.cur = 0;
+		}
+
+		const hdr_index_entry &e = hdr_in.index[hdr_in.cur++];
+		const __u8 *p = hdr_in.map + e.offset + 4;
+		const __u8 *end = hdr_in.map + e.offset + e.size;
+
+		for (unsigned j = 0; j < q.g_num_planes(); j++) {
+			__u32 len;
+
+			if (end - p < 4 || (len = get_u32(p)) > end - p - 4) {
+				fprintf(stderr, "truncated frame at offset %llu\n", e.offset);
+				return false;
+			}
+			if (len > q.g_length(j)) {
+				fprintf(stderr, "plane size is too large (%u > %u)\n",
+					len, q.g_length(j));
+				return false;
+			}
+			memcpy(q.g_dataptr(b.g_index(), j), p + 4, len);
+			b.s_bytesused(len, j);
+			p += 4 + len;
+		}
+		first = false;
+		return true;
+	}
+
 restart:
 	if (from_with_hdr) {
 		__u32 v;
@@ -1142,6 +1412,99 @@ restart:
 	return true;
 }
 
+/*
+ * Frames read by --stream-from-preload. The planes of all frames are
+ * stored back to back in preload_data, which is locked in memory if
+ * possible.
+ */
+struct preload_frame {
+	size_t offset[VIDEO_MAX_PLANES];
+	__u32 bytesused[VIDEO_MAX_PLANES];
+};
+
+static std::vector<__u8> preload_data;
+static std::vector<preload_frame> preload_frames;
+static unsigned preload_cur;
+static bool preload_in_place;
+
+static bool preload_from_file(cv4l_fd &fd, cv4l_queue &q, cv4l_fmt &fmt, FILE *fin)
+{
+	cv4l_buffer buf(q);
+	bool loop = stream_loop;
+
+	if (fmt.g_pixelformat() == V4L2_PIX_FMT_FWHT_STATELESS) {
+		fprintf(stderr, "--stream-from-preload is not supported for stateless FWHT\n");
+		return false;
+	}
+	if (fd.querybuf(buf, 0)) {
+		fprintf(stderr, "%s fd.querybuf failed\n", __func__);
+		return false;
+	}
+	buf.update(q, 0);
+
+	// Read every frame once, buffer 0 is used as scratch buffer
+	stream_loop = false;
+	while (preload_frames.size() < from_preload &&
+	       fill_buffer_from_file(fd, q, buf, fmt, fin)) {
+		preload_frame f;
+
+		for (unsigned j = 0; j < q.g_num_planes(); j++) {
+			f.offset[j] = preload_data.size();
+			f.bytesused[j] = buf.g_bytesused(j);
+			preload_data.insert(preload_data.end(),
+					    static_cast<__u8 *>(q.g_dataptr(0, j)),
+					    static_cast<__u8 *>(q.g_dataptr(0, j)) + f.bytesused[j]);
+		}
+		preload_frames.push_back(f);
+	}
+	stream_loop = loop;
+
+	if (preload_frames.empty()) {
+		fprintf(stderr, "could not preload any frames from %s\n", file_from);
+		return false;
+	}
+	if (!preload_data.empty() && mlock(preload_data.data(), preload_data.size()))
+		fprintf(stderr, "could not lock preloaded frames in memory: %s\n",
+			strerror(errno));
+	fprintf(stderr, "preloaded %zu frames (%zu bytes)\n",
+		preload_frames.size(), preload_data.size());
+	return true;
+}
+
+static bool fill_buffer_from_preload(cv4l_queue &q, cv4l_buffer &b)
+{
+	if (preload_cur == preload_frames.size()) {
+		if (!stream_loop)
+			return false;
+		preload_cur = 0;
+	}
+
+	/*
+	 * With one frame per mmap buffer, buffers are dequeued in the same
+	 * order as the frames, so buffer N always holds frame N and only
+	 * bytesused has to be restored.
+	 */
+	const preload_frame &f = preload_frames[preload_in_place ?
+						b.g_index() : preload_cur];
+
+	preload_cur++;
+	for (unsigned j = 0; j < q.g_num_planes(); j++) {
+		if (!preload_in_place)
+			memcpy(q.g_dataptr(b.g_index(), j),
+			       &preload_data[f.offset[j]], f.bytesused[j]);
+		b.s_bytesused(f.bytesused[j], j);
+	}
+	return true;
+}
+
+static bool fill_buffer(cv4l_fd &fd, cv4l_queue &q, cv4l_buffer &b,
+			cv4l_fmt &fmt, FILE *fin)
+{
+	if (from_preload)
+		return fill_buffer_from_preload(q, b);
+	return fill_buffer_from_file(fd, q, b, fmt, fin);
+}
+
 static int do_setup_out_buffers(cv4l_fd &fd, cv4l_queue &q, FILE *fin, bool qbuf,
 				bool ignore_count_skip)
 {
@@ -1226,6 +1589,12 @@ static int do_setup_out_buffers(cv4l_fd &fd, cv4l_queue &q, FILE *fin, bool qbuf
 			stream_out_refresh = true;
 	}
 
+	if (fin && from_preload && preload_frames.empty() &&
+	    !preload_from_file(fd, q, fmt, fin))
+		return QUEUE_ERROR;
+	preload_cur = 0;
+	preload_in_place = false;
+
 	for (unsigned i = 0; i < q.g_buffers(); i++) {
 		cv4l_buffer buf(q);
 
@@ -1255,7 +1624,7 @@ static int do_setup_out_buffers(cv4l_fd &fd, cv4l_queue &q, FILE *fin, bool qbuf
 		if (is_meta)
 			meta_fillbuffer(buf, fmt, q);
 
-		if (fin && !fill_buffer_from_file(fd, q, buf, fmt, fin))
+		if (fin && !fill_buffer(fd, q, buf, fmt, fin))
 			return QUEUE_STOPPED;
 
 		if (fmt.g_pixelformat() == V4L2_PIX_FMT_FWHT_STATELESS) {
@@ -1307,6 +1676,9 @@ static int do_setup_out_buffers(cv4l_fd &fd, cv4l_queue &q, FILE *fin, bool qbuf
 	}
 	if (qbuf)
 		output_field = field;
+	if (fin && from_preload && q.g_memory() == V4L2_MEMORY_MMAP &&
+	    preload_frames.size() == q.g_buffers())
+		preload_in_place = true;
 	return 0;
 }
 
@@ -1346,8 +1718,12 @@ static void write_buffer_to_file(cv4l_fd &fd, cv4l_queue &q, cv4l_buffer &buf,
 		comp_perc += (tot_comp_size * 100 / tot_used);
 		comp_perc_count++;
 	}
-	if (to_with_hdr)
+	off_t hdr_offset = -1;
+
+	if (to_with_hdr) {
+		hdr_offset = ftello(fout);
 		write_u32(fout, FILE_HDR_ID);
+	}
 	for (unsigned j = 0; j < buf.g_num_planes(); j++) {
 		__u32 used = buf.g_bytesused(j);
 		unsigned offset = buf.g_data_offset(j);
@@ -1380,11 +1756,78 @@ static void write_buffer_to_file(cv4l_fd &fd, cv4l_queue &q, cv4l_buffer &buf,
 		if (sz != used)
 			fprintf(stderr, "%u != %u\n", sz, used);
 	}
+	if (to_with_hdr && host_fd_to < 0)
+		add_hdr_index(fout, hdr_offset);
 	if (host_fd_to >= 0)
 		fflush(fout);
 #endif
 }
 
+static void setup_slice_vbi(cv4l_fd &fd, cv4l_fmt &fmt)
+{
+	v4l2_std_id std;
+
+	slice_vbi = false;
+	if (fmt.type != V4L2_BUF_TYPE_VBI_CAPTURE) {
+		fprintf(stderr, "--stream-slice-vbi requires a raw VBI capture stream\n");
+		return;
+	}
+	if (fd.g_std(std)) {
+		// Fall back to the standard implied by the VBI line numbering
+		std = fmt.fmt.vbi.start[1] >= 313 ? V4L2_STD_625_50 : V4L2_STD_525_60;
+	}
+	if (!vbi_prepare(&vbi_slicer, &fmt.fmt.vbi, std)) {
+		fprintf(stderr, "no sliced VBI services are possible for this VBI format\n");
+		return;
+	}
+	vbi_sliced_data.resize(vbi_slicer.count[0] + vbi_slicer.count[1]);
+	vbi_sliced_bufs = vbi_sliced_lines = 0;
+	vbi_slice_time = 0;
+	slice_vbi = true;
+}
+
+static void slice_vbi_buffer(cv4l_queue &q, cv4l_buffer &buf, FILE *fout)
+{
+	struct v4l2_sliced_vbi_format sfmt;
+	struct timespec start, end;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	vbi_parse(&vbi_slicer, static_cast<u8 *>(q.g_dataptr(buf.g_index(), 0)),
+		  &sfmt, vbi_sliced_data.data());
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	vbi_slice_time += (end.tv_sec - start.tv_sec) +
+			  (end.tv_nsec - start.tv_nsec) / 1000000000.0;
+	vbi_sliced_bufs++;
+	for (const auto &d : vbi_sliced_data)
+		if (d.id)
+			vbi_sliced_lines++;
+
+	if (!fout)
+		return;
+#ifndef NO_STREAM_TO
+	off_t hdr_offset = -1;
+
+	if (to_with_hdr) {
+		hdr_offset = ftello(fout);
+		write_u32(fout, FILE_HDR_ID);
+		write_u32(fout, sfmt.io_size);
+	}
+	if (fwrite(vbi_sliced_data.data(), 1, sfmt.io_size, fout) != sfmt.io_size)
+		fprintf(stderr, "could not write sliced VBI data\n");
+	if (to_with_hdr && host_fd_to < 0)
+		add_hdr_index(fout, hdr_offset);
+#endif
+}
+
+static void show_slice_vbi_stats()
+{
+	if (!slice_vbi || !vbi_sliced_bufs)
+		return;
+	fprintf(stderr, "Sliced %u VBI lines from %u buffers in %.03f ms (%.02f us/buffer)\n",
+		vbi_sliced_lines, vbi_sliced_bufs, vbi_slice_time * 1000.0,
+		vbi_slice_time * 1000000.0 / vbi_sliced_bufs);
+}
+
 static int do_handle_cap(cv4l_fd &fd, cv4l_queue &q, FILE *fout, int *index,
 			 unsigned &count, fps_timestamps &fps_ts, cv4l_fmt &fmt,
 			 bool ignore_count_skip)
@@ -1421,8 +1864,10 @@ static int do_handle_cap(cv4l_fd &fd, cv4l_queue &q, FILE *fout, int *index,
 	double ts_secs = buf.g_timestamp().tv_sec + buf.g_timestamp().tv_usec / 1000000.0;
 	fps_ts.add_ts(ts_secs, buf.g_sequence(), buf.g_field());
 
-	if (fout && (!stream_skip || ignore_count_skip) &&
-	    !is_empty_frame && !is_error_frame)
+	if (slice_vbi && !is_empty_frame && !is_error_frame)
+		slice_vbi_buffer(q, buf, (!stream_skip || ignore_count_skip) ? fout : nullptr);
+	else if (fout && (!stream_skip || ignore_count_skip) &&
+		 !is_empty_frame && !is_error_frame)
 		write_buffer_to_file(fd, q, buf, fmt, fout);
 
 	if (buf.g_flags() & V4L2_BUF_FLAG_KEYFRAME)
@@ -1566,7 +2011,7 @@ static int do_handle_out(cv4l_fd &fd, cv4l_queue &q, FILE *fin, cv4l_buffer *cap
 			output_field = V4L2_FIELD_TOP;
 	}
 
-	if (fin && !fill_buffer_from_file(fd, q, buf, fmt, fin))
+	if (fin && !fill_buffer(fd, q, buf, fmt, fin))
 		return QUEUE_STOPPED;
 
 	if (!fin && stream_out_refresh) {
@@ -1851,6 +2296,9 @@ recover:
 
 	fd.g_fmt(fmt);
 
+	if (options[OptStreamSliceVbi])
+		setup_slice_vbi(fd, fmt);
+
 	while (stream_sleep == 0)
 		sleep(100);
 
@@ -1914,6 +2362,7 @@ recover:
 	fd.streamoff();
 	fcntl(fd.g_fd(), F_SETFL, fd_flags);
 	fprintf(stderr, "\n");
+	show_slice_vbi_stats();
 
 	q.free(&fd);
 	tpg_free(&tpg);
@@ -1926,7 +2375,7 @@ done:
 	if (fout && fout != stdout) {
 		if (host_fd_to >= 0)
 			write_u32(fout, V4L_STREAM_PACKET_END);
-		fclose(fout);
+		close_output_file(fout);
 	}
 }
 
@@ -2186,7 +2635,7 @@ done:
 	if (options[OptStreamOutDmaBuf])
 		exp_q.close_exported_fds();
 	if (fin && fin != stdin)
-		fclose(fin);
+		close_input_file(fin);
 }
 
 enum stream_type {
@@ -2645,10 +3094,10 @@ done:
 		exp_q.close_exported_fds();
 
 	if (file[CAP] && file[CAP] != stdout)
-		fclose(file[CAP]);
+		close_output_file(file[CAP]);
 
 	if (file[OUT] && file[OUT] != stdin)
-		fclose(file[OUT]);
+		close_input_file(file[OUT]);
 }
 
 static void streaming_set_cap2out(cv4l_fd &fd, cv4l_fd &out_fd)
@@ -2838,10 +3287,10 @@ done:
 	tpg_free(&tpg);
 
 	if (file[CAP] && file[CAP] != stdout)
-		fclose(file[CAP]);
+		close_output_file(file[CAP]);
 
 	if (file[OUT] && file[OUT] != stdin)
-		fclose(file[OUT]);
+		close_input_file(file[OUT]);
 }
 
 void streaming_set(cv4l_fd &fd, cv4l_fd &out_fd, cv4l_fd &exp_fd)
@@ -26,6 +26,7 @@
 #include <dirent.h>
 #include <getopt.h>
 #include <sys/epoll.h>
+#include <sys/stat.h>
 
 #include <linux/media.h>
 
@@ -245,11 +246,14 @@ static struct option long_options[] = {
 #endif
 	{"stream-buf-caps", no_argument, nullptr, OptStreamBufCaps},
 	{"stream-show-delta-now", no_argument, nullptr, OptStreamShowDeltaNow},
+	{"stream-slice-vbi", no_argument, nullptr, OptStreamSliceVbi},
 	{"stream-mmap", optional_argument, nullptr, OptStreamMmap},
 	{"stream-user", optional_argument, nullptr, OptStreamUser},
 	{"stream-dmabuf", no_argument, nullptr, OptStreamDmaBuf},
 	{"stream-from", required_argument, nullptr, OptStreamFrom},
 	{"stream-from-hdr", required_argument, nullptr, OptStreamFromHdr},
+	{"stream-from-hdr-seek", required_argument, nullptr, OptStreamFromHdrSeek},
+	{"stream-from-preload", required_argument, nullptr, OptStreamFromPreload},
 	{"stream-from-host", required_argument, nullptr, OptStreamFromHost},
 	{"stream-out-pattern", required_argument, nullptr, OptStreamOutPattern},
 	{"stream-out-square", no_argument, nullptr, OptStreamOutSquare},
@@ -979,7 +983,7 @@ bool valid_pixel_format(int fd, __u32 pixelformat, bool output, bool mplane)
 		fmt.type = mplane ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE :
 			V4L2_BUF_TYPE_VIDEO_CAPTURE;
 
-	while (!ioctl(fd, VIDIOC_ENUM_FMT, &fmt)) {
+	while (!test_ioctl(fd, VIDIOC_ENUM_FMT, &fmt)) {
 		if (fmt.pixelformat == pixelformat)
 			return true;
 		fmt.index++;
@@ -999,7 +1003,7 @@ __u32 find_pixel_format(int fd, unsigned index, bool output, bool mplane)
 		fmt.type = mplane ? V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE :
 			V4L2_BUF_TYPE_VIDEO_CAPTURE;
 
-	if (ioctl(fd, VIDIOC_ENUM_FMT, &fmt))
+	if (test_ioctl(fd, VIDIOC_ENUM_FMT, &fmt))
 		return 0;
 	return fmt.pixelformat;
 }
@@ -1317,6 +1321,16 @@ int main(int argc, char **argv)
 		break;
 	}
 
+	/*
+	 * libv4l2 emulation plugins claim regular files rather than
+	 * device nodes, so let libv4l2 decide for those.
+	 */
+	struct stat st;
+
+	if (type == MEDIA_TYPE_UNKNOWN && options[OptUseWrapper] &&
+	    !stat(device, &st) && S_ISREG(st.st_mode))
+		type = MEDIA_TYPE_VIDEO;
+
 	if (type == MEDIA_TYPE_UNKNOWN) {
 		fprintf(stderr, "Unable to detect what device %s is, exiting.\n",
 			device);
@@ -224,12 +224,15 @@ enum Option {
 	OptStreamToHost,
 	OptStreamLossless,
 	OptStreamShowDeltaNow,
+	OptStreamSliceVbi,
 	OptStreamBufCaps,
 	OptStreamMmap,
 	OptStreamUser,
 	OptStreamDmaBuf,
 	OptStreamFrom,
 	OptStreamFromHdr,
+	OptStreamFromHdrSeek,
+	OptStreamFromPreload,
 	OptStreamFromHost,
 	OptStreamOutPattern,
 	OptStreamOutSquare,
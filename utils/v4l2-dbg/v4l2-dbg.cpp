@@ -16,6 +16,7 @@
     Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA  02110-1335  USA
  */
 
+#include <algorithm>
 #include <cctype>
 #include <cerrno>
 #include <cstring>
@@ -125,6 +126,8 @@ enum Option {
 	OptLogStatus = 128,
 	OptVerbose,
 	OptListSymbols,
+	OptSnapshot,
+	OptDiff,
 	OptLast = 256
 };
 
@@ -145,6 +148,8 @@ static struct option long_options[] = {
 	{"log-status", no_argument, nullptr, OptLogStatus},
 	{"list-symbols", no_argument, nullptr, OptListSymbols},
 	{"wide", required_argument, nullptr, OptSetStride},
+	{"snapshot", required_argument, nullptr, OptSnapshot},
+	{"diff", required_argument, nullptr, OptDiff},
 	{nullptr, 0, nullptr, 0}
 };
 
@@ -172,7 +177,71 @@ static void usage()
 	       "  -w, --wide <reg length>\n"
 	       "		     Sets step between two registers\n"
 	       "  --list-symbols     List the symbolic register names you can use, if any\n"
-	       "  --log-status       Log the board status in the kernel log [VIDIOC_LOG_STATUS]\n");
+	       "  --log-status       Log the board status in the kernel log [VIDIOC_LOG_STATUS]\n"
+	       "  --snapshot <file>  Save the registers that --list-registers would show in\n"
+	       "                     <file> in binary form [VIDIOC_DBG_G_REGISTER]\n"
+	       "  --diff <old>[,<new>]\n"
+	       "                     Show the registers that differ between snapshot <old>\n"
+	       "                     and snapshot <new>. Without <new>, the registers of the\n"
+	       "                     snapshot are read from the device and compared. Can be\n"
+	       "                     combined with --snapshot to save the new values.\n"
+	       "                     The exit code is 2 if any register differs.\n");
+}
+
+/*
+ * Register snapshot file: a snapshot_header followed by count snapshot_reg
+ * entries, sorted by register address. All values are in host byte order.
+ */
+#define SNAPSHOT_MAGIC "V4L2DBG1"
+
+struct snapshot_header {
+	char magic[8];
+	__u32 match_type;
+	__u32 match_addr;
+	char chip[32];
+	__u32 count;
+	__u32 reserved;
+};
+
+#define SNAPSHOT_FL_FAILED (1 << 0)
+
+struct snapshot_reg {
+	__u64 reg;
+	__u64 val;
+	__u32 size;
+	__u32 flags;
+};
+
+struct reg_range {
+	unsigned long long min, max;
+};
+
+/* Register ranges to dump for chips without a register table */
+static const struct {
+	const char *name;
+	std::vector<reg_range> ranges;
+} chip_ranges[] = {
+	{ "saa7115", { { 0, 0xff } } },
+	// FIXME: use correct reg regions
+	{ "saa717x", { { 0, 0xff } } },
+	{ "saa7127", { { 0, 0x7f } } },
+	{ "ov7670", { { 0, 0x89 } } },
+	{ "cx25840", { { 0, 2 }, { 0x100, 0x15f }, { 0x200, 0x23f },
+		       { 0x400, 0x4bf }, { 0x800, 0x9af } } },
+	{ "cs5345", { { 1, 0x10 } } },
+	{ "cx23416", { { 0x02000000, 0x020000ff } } },
+	{ "cx23418", { { 0x02c40000, 0x02c409c7 } } },
+	{ "cafe", { { 0, 0x43 }, { 0x88, 0x8f }, { 0xb4, 0xbb },
+		    { 0x3000, 0x300c } } },
+};
+
+static std::vector<reg_range> get_chip_ranges(const std::string &name)
+{
+	for (const auto &chip : chip_ranges)
+		if (name == chip.name)
+			return chip.ranges;
+	/* unknown chip, dump 0-0xff by default */
+	return { { 0, 0xff } };
 }
 
 static void print_regs(int fd, struct v4l2_dbg_register *reg, unsigned long min, unsigned long max, int stride)
@@ -292,6 +361,206 @@ static const char *binary(unsigned long long val)
 	return bin;
 }
 
+static const struct board_list *find_board(const char *chip)
+{
+	for (size_t board = boards.size(); board; board--) {
+		if (!strcasecmp(chip, boards[board - 1].name))
+			return &boards[board - 1];
+	}
+	return nullptr;
+}
+
+static void print_reg_name(const struct board_list *curr_bd, unsigned long long reg)
+{
+	const char *name = reg_name(curr_bd, reg);
+
+	if (name)
+		printf("%s (0x%08llx)", name, reg);
+	else
+		printf("0x%08llx", reg);
+}
+
+/*
+ * Read all registers of the given ranges. The ranges are expanded into
+ * register addresses, which are sorted and merged, so that registers that
+ * occur more than once are read only once, in address order and without
+ * the delay that print_regs() has between registers.
+ */
+static void read_regs(int fd, struct v4l2_dbg_register *reg,
+		      const std::vector<reg_range> &ranges, int stride,
+		      std::vector<snapshot_reg> &regs)
+{
+	std::vector<unsigned long long> addrs;
+
+	for (const auto &range : ranges) {
+		unsigned long long step = stride;
+
+		if (range.min == range.max) {
+			addrs.push_back(range.min);
+			continue;
+		}
+
+		/* If the register size is set, then use this as the stride */
+		reg->reg = range.min;
+		if (ioctl(fd, VIDIOC_DBG_G_REGISTER, reg) == 0 && reg->size)
+			step = reg->size;
+		for (unsigned long long i = range.min; i <= range.max; i += step)
+			addrs.push_back(i);
+	}
+
+	std::sort(addrs.begin(), addrs.end());
+	addrs.erase(std::unique(addrs.begin(), addrs.end()), addrs.end());
+
+	regs.clear();
+	regs.reserve(addrs.size());
+	for (auto addr : addrs) {
+		struct snapshot_reg r = {};
+
+		r.reg = addr;
+		reg->reg = addr;
+		if (ioctl(fd, VIDIOC_DBG_G_REGISTER, reg) < 0) {
+			r.flags = SNAPSHOT_FL_FAILED;
+		} else {
+			r.val = reg->val;
+			r.size = reg->size;
+		}
+		regs.push_back(r);
+	}
+}
+
+static void write_snapshot(const char *file, const struct v4l2_dbg_match &match,
+			   const char *chip, const std::vector<snapshot_reg> &regs)
+{
+	struct snapshot_header hdr = {};
+	FILE *f = fopen(file, "wb");
+	size_t len = strnlen(chip, sizeof(hdr.chip) - 1);
+
+	if (!f) {
+		fprintf(stderr, "Failed to open %s: %s\n", file, strerror(errno));
+		std::exit(EXIT_FAILURE);
+	}
+
+	memcpy(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic));
+	hdr.match_type = match.type;
+	hdr.match_addr = match.addr;
+	memcpy(hdr.chip, chip, len);
+	hdr.count = regs.size();
+
+	if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+	    (!regs.empty() &&
+	     fwrite(regs.data(), sizeof(regs[0]), regs.size(), f) != regs.size()) ||
+	    fclose(f)) {
+		fprintf(stderr, "Failed to write %s\n", file);
+		std::exit(EXIT_FAILURE);
+	}
+}
+
+static void read_snapshot(const char *file, struct snapshot_header &hdr,
+			  std::vector<snapshot_reg> &regs)
+{
+	FILE *f = fopen(file, "rb");
+
+	if (!f) {
+		fprintf(stderr, "Failed to open %s: %s\n", file, strerror(errno));
+		std::exit(EXIT_FAILURE);
+	}
+
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+	    memcmp(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic))) {
+		fprintf(stderr, "%s is not a v4l2-dbg register snapshot\n", file);
+		std::exit(EXIT_FAILURE);
+	}
+	hdr.chip[sizeof(hdr.chip) - 1] = '\0';
+
+	regs.resize(hdr.count);
+	if (hdr.count && fread(regs.data(), sizeof(regs[0]), hdr.count, f) != hdr.count) {
+		fprintf(stderr, "%s: truncated register snapshot\n", file);
+		std::exit(EXIT_FAILURE);
+	}
+	fclose(f);
+}
+
+/* Both lists are sorted by address, so a single pass finds all changes */
+static unsigned diff_regs(const struct board_list *curr_bd,
+			  const std::vector<snapshot_reg> &old_regs,
+			  const std::vector<snapshot_reg> &new_regs)
+{
+	auto o = old_regs.begin();
+	auto n = new_regs.begin();
+	unsigned changed = 0;
+
+	while (o != old_regs.end() || n != new_regs.end()) {
+		if (n == new_regs.end() || (o != old_regs.end() && o->reg < n->reg)) {
+			printf("Register ");
+			print_reg_name(curr_bd, o->reg);
+			printf(" only in old snapshot\n");
+			changed++;
+			o++;
+			continue;
+		}
+		if (o == old_regs.end() || n->reg < o->reg) {
+			printf("Register ");
+			print_reg_name(curr_bd, n->reg);
+			printf(" only in new snapshot\n");
+			changed++;
+			n++;
+			continue;
+		}
+		if (o->val != n->val || o->flags != n->flags) {
+			printf("Register ");
+			print_reg_name(curr_bd, o->reg);
+			if (o->flags & SNAPSHOT_FL_FAILED)
+				printf(" = failed");
+			else
+				printf(" = %llxh", (unsigned long long)o->val);
+			if (n->flags & SNAPSHOT_FL_FAILED)
+				printf(" -> failed\n");
+			else
+				printf(" -> %llxh (%sb)\n", (unsigned long long)n->val,
+				       binary(n->val));
+			changed++;
+		}
+		o++;
+		n++;
+	}
+	return changed;
+}
+
+/* The registers that --list-registers shows */
+static std::vector<reg_range> list_ranges(const struct board_list *curr_bd,
+					  const char *chip,
+					  const std::string &reg_min_arg,
+					  const std::string &reg_max_arg)
+{
+	std::vector<reg_range> ranges;
+	unsigned long long reg_min, reg_max;
+
+	if (curr_bd) {
+		reg_min = reg_min_arg.empty() ? 0 : parse_reg(curr_bd, reg_min_arg);
+		reg_max = reg_max_arg.empty() ? (1ll << 32) - 1 :
+			parse_reg(curr_bd, reg_max_arg);
+
+		for (const auto &curr : curr_bd->regs)
+			if (curr.reg >= reg_min && curr.reg <= reg_max)
+				ranges.push_back({ curr.reg, curr.reg });
+		return ranges;
+	}
+
+	if (!reg_min_arg.empty()) {
+		reg_min = parse_reg(curr_bd, reg_min_arg);
+		if (reg_max_arg.empty())
+			reg_max = reg_min + 0xff;
+		else
+			reg_max = parse_reg(curr_bd, reg_max_arg);
+		ranges.push_back({ reg_min, reg_max });
+		return ranges;
+	}
+
+	std::string name(chip);
+
+	return get_chip_ranges(name.substr(0, name.find(' ')));
+}
+
 static int doioctl(int fd, unsigned long int request, void *parm, const char *name)
 {
 	int retVal = ioctl(fd, request, parm);
@@ -345,6 +614,7 @@ int main(int argc, char **argv)
 	std::string reg_set_arg;
 	unsigned long long reg_min = 0, reg_max = 0;
 	std::vector<std::string> get_regs;
+	std::string snapshot_file, diff_old, diff_new;
 	struct v4l2_dbg_match match;
 	char *p;
 
@@ -460,6 +730,18 @@ int main(int argc, char **argv)
 		case OptListSymbols:
 			break;
 
+		case OptSnapshot:
+			snapshot_file = optarg;
+			break;
+
+		case OptDiff:
+			diff_old = optarg;
+			if (diff_old.find(',') != std::string::npos) {
+				diff_new = diff_old.substr(diff_old.find(',') + 1);
+				diff_old.erase(diff_old.find(','));
+			}
+			break;
+
 		case ':':
 			fprintf(stderr, "Option `%s' requires a value\n",
 				argv[optind]);
@@ -474,6 +756,21 @@ int main(int argc, char **argv)
 		}
 	}
 
+	/* Comparing two snapshots does not need the device */
+	if (!diff_new.empty()) {
+		std::vector<snapshot_reg> old_regs, new_regs;
+		struct snapshot_header old_hdr, new_hdr;
+
+		read_snapshot(diff_old.c_str(), old_hdr, old_regs);
+		read_snapshot(diff_new.c_str(), new_hdr, new_regs);
+		if (old_hdr.match_type != new_hdr.match_type ||
+		    old_hdr.match_addr != new_hdr.match_addr ||
+		    strcmp(old_hdr.chip, new_hdr.chip))
+			fprintf(stderr, "Warning: the snapshots are of different chips\n");
+		unsigned changed = diff_regs(find_board(new_hdr.chip), old_regs, new_regs);
+		std::exit(changed ? 2 : EXIT_SUCCESS);
+	}
+
 	if ((fd = open(device, O_RDWR)) < 0) {
 		fprintf(stderr, "Failed to open %s: %s\n", device,
 			strerror(errno));
@@ -497,16 +794,10 @@ int main(int argc, char **argv)
 		if (doioctl(fd, VIDIOC_DBG_G_CHIP_INFO, &chip_info, "VIDIOC_DBG_G_CHIP_INFO") != 0)
 			chip_info.name[0] = '\0';
 
-		if (!strncasecmp(match.name, "ac97", 4)) {
+		if (!strncasecmp(match.name, "ac97", 4))
 			curr_bd = &boards[AC97_BOARD];
-		} else {
-			for (size_t board = boards.size(); board; board--) {
-				if (!strcasecmp(chip_info.name, boards[board - 1].name)) {
-					curr_bd = &boards[board - 1];
-					break;
-				}
-			}
-		}
+		else
+			curr_bd = find_board(chip_info.name);
 	}
 
 	/* Set options */
@@ -654,38 +945,52 @@ int main(int argc, char **argv)
 			*p = '\0';
 		name = chip_info.name;
 
-		if (name == "saa7115") {
-			print_regs(fd, &get_reg, 0, 0xff, stride);
-		} else if (name == "saa717x") {
-			// FIXME: use correct reg regions
-			print_regs(fd, &get_reg, 0, 0xff, stride);
-		} else if (name == "saa7127") {
-			print_regs(fd, &get_reg, 0, 0x7f, stride);
-		} else if (name == "ov7670") {
-			print_regs(fd, &get_reg, 0, 0x89, stride);
-		} else if (name == "cx25840") {
-			print_regs(fd, &get_reg, 0, 2, stride);
-			print_regs(fd, &get_reg, 0x100, 0x15f, stride);
-			print_regs(fd, &get_reg, 0x200, 0x23f, stride);
-			print_regs(fd, &get_reg, 0x400, 0x4bf, stride);
-			print_regs(fd, &get_reg, 0x800, 0x9af, stride);
-		} else if (name == "cs5345") {
-			print_regs(fd, &get_reg, 1, 0x10, stride);
-		} else if (name == "cx23416") {
-			print_regs(fd, &get_reg, 0x02000000, 0x020000ff, stride);
-		} else if (name == "cx23418") {
-			print_regs(fd, &get_reg, 0x02c40000, 0x02c409c7, stride);
-		} else if (name == "cafe") {
-			print_regs(fd, &get_reg, 0, 0x43, stride);
-			print_regs(fd, &get_reg, 0x88, 0x8f, stride);
-			print_regs(fd, &get_reg, 0xb4, 0xbb, stride);
-			print_regs(fd, &get_reg, 0x3000, 0x300c, stride);
+		for (const auto &range : get_chip_ranges(name))
+			print_regs(fd, &get_reg, range.min, range.max, stride);
+	}
+list_done:
+
+	if (options[OptSnapshot] || options[OptDiff]) {
+		std::vector<snapshot_reg> old_regs, new_regs;
+		struct snapshot_header hdr = {};
+		int stride = 1;
+
+		get_reg.match = match;
+		if (forcedstride)
+			stride = forcedstride;
+		else if (get_reg.match.type == V4L2_CHIP_MATCH_BRIDGE)
+			stride = 4;
+
+		if (options[OptDiff]) {
+			std::vector<reg_range> ranges;
+
+			/* Read the registers of the snapshot, from the same chip */
+			read_snapshot(diff_old.c_str(), hdr, old_regs);
+			get_reg.match.type = hdr.match_type;
+			get_reg.match.addr = hdr.match_addr;
+			for (const auto &r : old_regs)
+				ranges.push_back({ r.reg, r.reg });
+			read_regs(fd, &get_reg, ranges, stride, new_regs);
+			if (!curr_bd)
+				curr_bd = find_board(hdr.chip);
 		} else {
-			/* unknown chip, dump 0-0xff by default */
-			print_regs(fd, &get_reg, 0, 0xff, stride);
+			chip_info.match = match;
+			if (doioctl(fd, VIDIOC_DBG_G_CHIP_INFO, &chip_info, "VIDIOC_DBG_G_CHIP_INFO") != 0)
+				chip_info.name[0] = '\0';
+			read_regs(fd, &get_reg,
+				  list_ranges(curr_bd, chip_info.name, reg_min_arg, reg_max_arg),
+				  stride, new_regs);
+		}
+
+		if (options[OptSnapshot])
+			write_snapshot(snapshot_file.c_str(), get_reg.match,
+				       options[OptDiff] ? hdr.chip : chip_info.name,
+				       new_regs);
+		if (options[OptDiff] && diff_regs(curr_bd, old_regs, new_regs)) {
+			close(fd);
+			std::exit(2);
 		}
 	}
-list_done:
 
 	if (options[OptLogStatus]) {
 		static char buf[40960];
@@ -10,54 +10,142 @@
 
 #include "trace.h"
 #include <config.h> /* For PROMOTED_MODE_T */
+#include <climits>
 #include <dlfcn.h>
+#include <regex.h>
 #include <stdarg.h>
+#include <unordered_set>
 
 extern struct trace_context ctx_trace;
 
-const std::list<unsigned long> ioctls = {
-	VIDIOC_QUERYCAP,
-	VIDIOC_STREAMON,
-	VIDIOC_STREAMOFF,
-	VIDIOC_ENUM_FMT,
-	VIDIOC_G_FMT,
-	VIDIOC_S_FMT,
-	VIDIOC_REQBUFS,
-	VIDIOC_QUERYBUF,
-	VIDIOC_QBUF,
-	VIDIOC_EXPBUF,
-	VIDIOC_DQBUF,
-	VIDIOC_G_PARM,
-	VIDIOC_S_PARM,
-	VIDIOC_ENUMINPUT,
-	VIDIOC_G_CTRL,
-	VIDIOC_S_CTRL,
-	VIDIOC_QUERYCTRL,
-	VIDIOC_G_INPUT,
-	VIDIOC_S_INPUT,
-	VIDIOC_G_OUTPUT,
-	VIDIOC_S_OUTPUT,
-	VIDIOC_ENUMOUTPUT,
-	VIDIOC_G_CROP,
-	VIDIOC_S_CROP,
-	VIDIOC_TRY_FMT,
-	VIDIOC_G_EXT_CTRLS,
-	VIDIOC_S_EXT_CTRLS,
-	VIDIOC_TRY_EXT_CTRLS,
-	VIDIOC_ENCODER_CMD,
-	VIDIOC_TRY_ENCODER_CMD,
-	VIDIOC_CREATE_BUFS,
-	VIDIOC_PREPARE_BUF,
-	VIDIOC_G_SELECTION,
-	VIDIOC_S_SELECTION,
-	VIDIOC_DECODER_CMD,
-	VIDIOC_TRY_DECODER_CMD,
-	VIDIOC_QUERY_EXT_CTRL,
-	MEDIA_IOC_REQUEST_ALLOC,
-	MEDIA_REQUEST_IOC_QUEUE,
-	MEDIA_REQUEST_IOC_REINIT,
+/* The number of buffers queued and dequeued so far on a device, by buffer type */
+struct frame_count {
+	unsigned long queued[V4L2_BUF_TYPE_META_OUTPUT + 1];
+	unsigned long dequeued[V4L2_BUF_TYPE_META_OUTPUT + 1];
 };
 
+/*
+ * Which calls to trace, set up once from the V4L2_TRACER_OPTION_IOCTLS,
+ * _DEVICE_PATH, _FRAMES and _SAMPLE environment variables so that checking
+ * a call costs a hash lookup at most. Calls that are filtered out are
+ * passed to the driver without being traced.
+ */
+struct trace_filter {
+	std::unordered_set<unsigned long> ioctls;
+	bool match_device_path;
+	regex_t device_path;
+	unsigned long first_frame;
+	unsigned long last_frame;
+	unsigned long sample;
+	std::unordered_map<int, struct frame_count> frames; /* key: fd */
+};
+
+static bool trace_filter_init(struct trace_filter *filter)
+{
+	const char *env = getenv("V4L2_TRACER_OPTION_IOCTLS");
+
+	if (env == nullptr) {
+		filter->ioctls.insert(ioctls.begin(), ioctls.end());
+	} else {
+		std::string_view names = env;
+
+		while (!names.empty()) {
+			size_t idx = names.find(',');
+			const val_def *def = lookup_name(ioctl_val_def, names.substr(0, idx));
+
+			if (def != nullptr && find(ioctls.begin(), ioctls.end(), def->val) != ioctls.end())
+				filter->ioctls.insert(def->val);
+			if (idx == std::string_view::npos)
+				break;
+			names.remove_prefix(idx + 1);
+		}
+	}
+
+	env = getenv("V4L2_TRACER_OPTION_DEVICE_PATH");
+	if (env != nullptr) {
+		filter->match_device_path = true;
+		if (regcomp(&filter->device_path, env, REG_EXTENDED | REG_NOSUB) != 0) {
+			fprintf(stderr, "%s:%s:%d: ", __FILE__, __func__, __LINE__);
+			fprintf(stderr, "ignoring invalid device path \'%s\'\n", env);
+			filter->match_device_path = false;
+		}
+	}
+
+	filter->last_frame = ULONG_MAX;
+	env = getenv("V4L2_TRACER_OPTION_FRAMES");
+	if (env != nullptr)
+		s2frame_range(env, &filter->first_frame, &filter->last_frame);
+
+	filter->sample = 1;
+	env = getenv("V4L2_TRACER_OPTION_SAMPLE");
+	if (env != nullptr && s2number(env) > 0)
+		filter->sample = s2number(env);
+
+	return true;
+}
+
+static struct trace_filter &get_trace_filter(void)
+{
+	static struct trace_filter filter;
+	static bool initialized = trace_filter_init(&filter);
+
+	(void) initialized;
+	return filter;
+}
+
+static bool trace_filter_device(const char *path)
+{
+	struct trace_filter &filter = get_trace_filter();
+
+	if (!is_video_or_media_device(path))
+		return false;
+
+	return !filter.match_device_path || regexec(&filter.device_path, path, 0, nullptr, 0) == 0;
+}
+
+/* Return the count of the buffer queued or dequeued by this call, if it is one. */
+static unsigned long *get_frame_count(int fd, unsigned long cmd, void *arg)
+{
+	if ((cmd != VIDIOC_QBUF && cmd != VIDIOC_DQBUF) || arg == nullptr)
+		return nullptr;
+
+	__u32 type = static_cast<struct v4l2_buffer*>(arg)->type;
+	if (type > V4L2_BUF_TYPE_META_OUTPUT)
+		return nullptr;
+
+	struct frame_count &count = get_trace_filter().frames[fd];
+	return (cmd == VIDIOC_QBUF) ? &count.queued[type] : &count.dequeued[type];
+}
+
+static bool trace_filter_ioctl(int fd, unsigned long cmd, void *arg)
+{
+	struct trace_filter &filter = get_trace_filter();
+
+	if (filter.ioctls.find(cmd) == filter.ioctls.end())
+		return false;
+
+	if (filter.match_device_path && ctx_trace.devices.find(fd) == ctx_trace.devices.end())
+		return false;
+
+	const unsigned long *frame = get_frame_count(fd, cmd, arg);
+	if (frame == nullptr)
+		return true;
+
+	return (*frame >= filter.first_frame) && (*frame <= filter.last_frame) &&
+	       ((*frame - filter.first_frame) % filter.sample == 0);
+}
+
+/* Count the buffers that were queued or dequeued, traced or not. */
+static void trace_filter_ioctl_done(int fd, unsigned long cmd, void *arg, int ret)
+{
+	if (ret != 0)
+		return;
+
+	unsigned long *frame = get_frame_count(fd, cmd, arg);
+	if (frame != nullptr)
+		(*frame)++;
+}
+
 int open(const char *path, int oflag, ...)
 {
 	errno = 0;
@@ -82,7 +170,7 @@ int open(const char *path, int oflag, ...)
 	if (getenv("V4L2_TRACER_PAUSE_TRACE") != nullptr)
 		return fd;
 
-	if (is_video_or_media_device(path)) {
+	if (trace_filter_device(path)) {
 		trace_open(fd, path, oflag, mode, false);
 		add_device(fd, path);
 	}
@@ -118,7 +206,7 @@ int open64(const char *path, int oflag, ...)
 	if (getenv("V4L2_TRACER_PAUSE_TRACE") != nullptr)
 		return fd;
 
-	if (is_video_or_media_device(path)) {
+	if (trace_filter_device(path)) {
 		add_device(fd, path);
 		trace_open(fd, path, oflag, mode, true);
 	}
@@ -140,6 +228,8 @@ int close(int fd)
 	if (getenv("V4L2_TRACER_PAUSE_TRACE") != nullptr)
 		return (*original_close)(fd);
 
+	get_trace_filter().frames.erase(fd);
+
 	std::string path = get_device(fd);
 	if (is_debug()) {
 		fprintf(stderr, "%s:%s:%d: ", __FILE__, __func__, __LINE__);
@@ -239,23 +329,35 @@ int ioctl(int fd, unsigned long cmd, ...)
 	if (getenv("V4L2_TRACER_PAUSE_TRACE") != nullptr)
 		return (*original_ioctl)(fd, cmd, arg);
 
-	/* Don't trace ioctls that are not in the specified ioctls list. */
+	/* Don't trace ioctls that are not in the supported ioctls list. */
 	if (find(ioctls.begin(), ioctls.end(), cmd) == ioctls.end())
 		return (*original_ioctl)(fd, cmd, arg);
 
-	json_object *ioctl_obj = json_object_new_object();
-	json_object_object_add(ioctl_obj, "fd", json_object_new_int(fd));
-	json_object_object_add(ioctl_obj, "ioctl",
-	                       json_object_new_string(val2s(cmd, ioctl_val_def).c_str()));
+	/*
+	 * Ioctls that are filtered out are not written to the trace file, but the
+	 * setup and cleanup below still need to see them to keep track of the buffers.
+	 */
+	ioctl_filtered = !trace_filter_ioctl(fd, cmd, arg);
+
+	json_object *ioctl_obj = nullptr;
+	if (!ioctl_filtered) {
+		ioctl_obj = json_object_new_object();
+		json_object_object_add(ioctl_obj, "fd", json_object_new_int(fd));
+		json_object_object_add(ioctl_obj, "ioctl",
+		                       json_object_new_string(val2s(cmd, ioctl_val_def).c_str()));
+	}
 
 	/* Don't attempt to trace a nullptr. */
 	if (arg == nullptr) {
 		int ret = (*original_ioctl)(fd, cmd, arg);
-		if (errno)
-			json_object_object_add(ioctl_obj, "errno",
-			                       json_object_new_string(STRERR(errno)));
-		write_json_object_to_json_file(ioctl_obj);
-		json_object_put(ioctl_obj);
+		if (ioctl_obj != nullptr) {
+			if (errno)
+				json_object_object_add(ioctl_obj, "errno",
+				                       json_object_new_string(STRERR(errno)));
+			write_json_object_to_json_file(ioctl_obj);
+			json_object_put(ioctl_obj);
+		}
+		ioctl_filtered = false;
 		return ret;
 	}
 
@@ -268,7 +370,7 @@ int ioctl(int fd, unsigned long cmd, ...)
 		streamoff_cleanup(*(static_cast<v4l2_buf_type*>(arg)));
 
 	/* Trace userspace arguments if driver will be reading them i.e. _IOW or _IOWR ioctls */
-	if ((cmd & IOC_IN) != 0U) {
+	if (ioctl_obj != nullptr && (cmd & IOC_IN) != 0U) {
 		json_object *ioctl_args_userspace = trace_ioctl_args(cmd, arg);
 		/* Some ioctls won't have arguments to trace e.g. MEDIA_REQUEST_IOC_QUEUE. */
 		if (json_object_object_length(ioctl_args_userspace))
@@ -280,22 +382,24 @@ int ioctl(int fd, unsigned long cmd, ...)
 	/* Make the original ioctl call. */
 	int ret = (*original_ioctl)(fd, cmd, arg);
 
-	if (errno)
-		json_object_object_add(ioctl_obj, "errno", json_object_new_string(STRERR(errno)));
+	if (ioctl_obj != nullptr) {
+		if (errno)
+			json_object_object_add(ioctl_obj, "errno", json_object_new_string(STRERR(errno)));
+
+		/* Trace driver arguments if userspace will be reading them i.e. _IOR or _IOWR ioctls */
+		if ((cmd & IOC_OUT) != 0U) {
+			json_object *ioctl_args_driver = trace_ioctl_args(cmd, arg);
+			/* Some ioctls won't have arguments to trace e.g. MEDIA_REQUEST_IOC_QUEUE. */
+			if (json_object_object_length(ioctl_args_driver))
+				json_object_object_add(ioctl_obj, "from_driver", ioctl_args_driver);
+			else
+				json_object_put(ioctl_args_driver);
+		}
 
-	/* Trace driver arguments if userspace will be reading them i.e. _IOR or _IOWR ioctls */
-	if ((cmd & IOC_OUT) != 0U) {
-		json_object *ioctl_args_driver = trace_ioctl_args(cmd, arg);
-		/* Some ioctls won't have arguments to trace e.g. MEDIA_REQUEST_IOC_QUEUE. */
-		if (json_object_object_length(ioctl_args_driver))
-			json_object_object_add(ioctl_obj, "from_driver", ioctl_args_driver);
-		else
-			json_object_put(ioctl_args_driver);
+		write_json_object_to_json_file(ioctl_obj);
+		json_object_put(ioctl_obj);
 	}
 
-	write_json_object_to_json_file(ioctl_obj);
-	json_object_put(ioctl_obj);
-
 	/* Get additional info from driver for writing the decoded video data to a yuv file. */
 	if (cmd == VIDIOC_G_FMT)
 		g_fmt_setup_trace(static_cast<struct v4l2_format*>(arg));
@@ -310,5 +414,8 @@ int ioctl(int fd, unsigned long cmd, ...)
 	if (cmd == VIDIOC_QUERY_EXT_CTRL)
 		query_ext_ctrl_setup(fd, static_cast<struct v4l2_query_ext_ctrl*>(arg));
 
+	trace_filter_ioctl_done(fd, cmd, arg, ret);
+	ioctl_filtered = false;
+
 	return ret;
 }
@@ -724,7 +724,7 @@ void retrace_vidioc_s_crop(int fd_retrace, json_object *ioctl_args)
 	free(ptr);
 }
 
-int retrace_v4l2_ext_control_value(json_object *ctrl_obj, const val_def *def)
+int retrace_v4l2_ext_control_value(json_object *ctrl_obj, const val_table &def)
 {
 	__s32 value = -1;
 
@@ -7,6 +7,7 @@
 #include <math.h>
 
 struct trace_context ctx_trace = {};
+thread_local bool ioctl_filtered;
 
 bool is_video_or_media_device(const char *path)
 {
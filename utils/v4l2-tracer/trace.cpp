@@ -128,6 +128,9 @@ json_object *trace_buffer(unsigned char *buffer_pointer, __u32 bytesused)
 
 void trace_mem(int fd, __u32 offset, __u32 type, int index, __u32 bytesused, unsigned long start)
 {
+	if (ioctl_filtered)
+		return;
+
 	json_object *mem_obj = json_object_new_object();
 	json_object_object_add(mem_obj, "mem_dump",
 	                       json_object_new_string(val2s(type, v4l2_buf_type_val_def).c_str()));
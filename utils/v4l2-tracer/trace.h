@@ -42,6 +42,9 @@ struct trace_context {
 	std::unordered_map<int, std::string> devices; /* key:fd, value: path of the device */
 };
 
+/* The ioctl this thread is in is filtered out, don't dump memory for it */
+extern thread_local bool ioctl_filtered;
+
 void trace_open(int fd, const char *path, int oflag, mode_t mode, bool is_open64);
 void trace_mmap(void *addr, size_t len, int prot, int flags, int fildes, off_t off, unsigned long buf_address, bool is_mmap64);
 void trace_mem(int fd, __u32 offset, __u32 type, int index, __u32 bytesused, unsigned long start);
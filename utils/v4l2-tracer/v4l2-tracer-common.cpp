@@ -4,10 +4,55 @@
  */
 
 #include "v4l2-tracer-common.h"
+#include <climits>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 
+/* The ioctls that can be traced and retraced */
+const std::list<unsigned long> ioctls = {
+	VIDIOC_QUERYCAP,
+	VIDIOC_STREAMON,
+	VIDIOC_STREAMOFF,
+	VIDIOC_ENUM_FMT,
+	VIDIOC_G_FMT,
+	VIDIOC_S_FMT,
+	VIDIOC_REQBUFS,
+	VIDIOC_QUERYBUF,
+	VIDIOC_QBUF,
+	VIDIOC_EXPBUF,
+	VIDIOC_DQBUF,
+	VIDIOC_G_PARM,
+	VIDIOC_S_PARM,
+	VIDIOC_ENUMINPUT,
+	VIDIOC_G_CTRL,
+	VIDIOC_S_CTRL,
+	VIDIOC_QUERYCTRL,
+	VIDIOC_G_INPUT,
+	VIDIOC_S_INPUT,
+	VIDIOC_G_OUTPUT,
+	VIDIOC_S_OUTPUT,
+	VIDIOC_ENUMOUTPUT,
+	VIDIOC_G_CROP,
+	VIDIOC_S_CROP,
+	VIDIOC_TRY_FMT,
+	VIDIOC_G_EXT_CTRLS,
+	VIDIOC_S_EXT_CTRLS,
+	VIDIOC_TRY_EXT_CTRLS,
+	VIDIOC_ENCODER_CMD,
+	VIDIOC_TRY_ENCODER_CMD,
+	VIDIOC_CREATE_BUFS,
+	VIDIOC_PREPARE_BUF,
+	VIDIOC_G_SELECTION,
+	VIDIOC_S_SELECTION,
+	VIDIOC_DECODER_CMD,
+	VIDIOC_TRY_DECODER_CMD,
+	VIDIOC_QUERY_EXT_CTRL,
+	MEDIA_IOC_REQUEST_ALLOC,
+	MEDIA_REQUEST_IOC_QUEUE,
+	MEDIA_REQUEST_IOC_REINIT,
+};
+
 bool is_debug(void)
 {
 	return (getenv("V4L2_TRACER_OPTION_DEBUG") != nullptr);
@@ -40,6 +85,16 @@ void print_usage(void)
 	        "\t\t-v, --verbose     Turn on verbose reporting.\n"
 	        "\t\t-y, --yuv         Write decoded video frame data to yuv file.\n\n"
 
+	        "\tTrace options:\n"
+	        "\t\t-f, --frames <first>[-<last>]\n"
+	        "\t\t                           Only trace VIDIOC_QBUF and VIDIOC_DQBUF for these\n"
+	        "\t\t                           buffers of each queue, counting from 0.\n\n"
+	        "\t\t-i, --ioctls <ioctl>[,<ioctl>...]\n"
+	        "\t\t                           Only trace these ioctls e.g. VIDIOC_QBUF.\n\n"
+	        "\t\t-n, --sample <n>           Only trace one in <n> VIDIOC_QBUF and VIDIOC_DQBUF\n"
+	        "\t\t                           of each queue.\n\n"
+	        "\t\t-p, --device_path <regex>  Only trace devices with a path matching <regex>.\n\n"
+
 	        "\tRetrace options:\n"
 	        "\t\t-d, --video_device <dev>   Retrace with a specific video device.\n"
 	        "\t\t                           <dev> must be a digit corresponding to\n"
@@ -92,34 +147,33 @@ std::string number2s(long num)
 	return "0x" + stream.str();
 }
 
-std::string val2s(long val, const val_def *def)
+std::string val2s(long val, const val_table &def)
 {
-	if (def == nullptr)
-		return number2s(val);
+	const val_def *entry = lookup_val(def, val);
 
-	while ((def->val != -1) && (def->val != val))
-		def++;
+	if (entry != nullptr)
+		return entry->str;
 
-	if (def->val == val)
-		return def->str;
+	return number2s(val);
+}
 
+std::string val2s(long val, std::nullptr_t)
+{
 	return number2s(val);
 }
 
-std::string fl2s(unsigned val, const flag_def *def)
+std::string fl2s(unsigned val, const flag_table &def)
 {
 	std::string str;
 
-	if (def == nullptr)
-		return number2s(val);
+	for (unsigned i = 0; i < def.size && val != 0U; i++) {
+		const flag_def *entry = &def.def[i];
 
-	while ((def->flag) != 0U) {
-		if ((val & def->flag) != 0U) {
+		if ((val & entry->flag) != 0U) {
 			add_separator(str);
-			str += def->str;
-			val &= ~def->flag;
+			str += entry->str;
+			val &= ~entry->flag;
 		}
-		def++;
 	}
 	if (val != 0U) {
 		add_separator(str);
@@ -129,6 +183,11 @@ std::string fl2s(unsigned val, const flag_def *def)
 	return str;
 }
 
+std::string fl2s(unsigned val, std::nullptr_t)
+{
+	return number2s(val);
+}
+
 std::string fl2s_buffer(__u32 flags)
 {
 	std::string str;
@@ -220,64 +279,79 @@ long s2number(const char *char_str)
 	return num;
 }
 
-long s2val(const char *char_str, const val_def *def)
+/* Parse a range of frames "<first>[-<last>]", the last frame is not limited if it is left out. */
+bool s2frame_range(const char *char_str, unsigned long *first, unsigned long *last)
 {
-	if (char_str == nullptr)
-		return 0;
-	std::string str = char_str;
+	char *end = nullptr;
 
-	if (str.empty())
-		return 0;
+	if (char_str == nullptr || !isdigit(*char_str))
+		return false;
+
+	unsigned long first_frame = strtoul(char_str, &end, 0);
+	unsigned long last_frame = ULONG_MAX;
+
+	if (*end == '-') {
+		if (!isdigit(end[1]))
+			return false;
+		last_frame = strtoul(end + 1, &end, 0);
+	}
+	if (*end != '\0' || last_frame < first_frame)
+		return false;
+
+	*first = first_frame;
+	*last = last_frame;
+	return true;
+}
 
-	if (def == nullptr)
-		return s2number(char_str);
+long s2val(const char *char_str, const val_table &def)
+{
+	if (char_str == nullptr || *char_str == '\0')
+		return 0;
 
-	while ((def->val != -1) && (def->str != str))
-		def++;
+	const val_def *entry = lookup_name(def, char_str);
+	if (entry != nullptr)
+		return entry->val;
 
-	if (def->str == str)
-		return def->val;
+	return s2number(char_str);
+}
 
+long s2val(const char *char_str, std::nullptr_t)
+{
 	return s2number(char_str);
 }
 
-unsigned long s2flags(const char *char_str, const flag_def *def)
+unsigned long s2flags(const char *char_str, const flag_table &def)
 {
 	if (char_str == nullptr)
 		return 0;
-	std::string str = char_str;
 
-	size_t idx = 0;
+	std::string_view str = char_str;
 	unsigned long flags = 0;
 
-	if (def == nullptr)
-		return s2number(char_str);
+	/* Look up each name between the separators, anything unknown is a number */
+	while (!str.empty()) {
+		size_t idx = str.find('|');
+		std::string_view name = str.substr(0, idx);
 
-	while ((def->flag) != 0U) {
-		idx = str.find(def->str);
-		if (idx == std::string::npos) {
-			def++;
-			continue;
-		}
-		/* Stop false substring matches e.g. in V4L2_BUF_CAP_SUPPORTS_MMAP_CACHE_HINTS */
-		std::string check = def->str;
-		if (check.length() != str.length()) {
-			idx = str.find(check + '|');
-			if (idx == std::string::npos) {
-				def++;
-				continue;
-			}
-		}
-		flags += def->flag;
-		clean_string(idx, def->str, str);
-		def++;
+		const flag_def *entry = lookup_name(def, name);
+		if (entry != nullptr)
+			flags += entry->flag;
+		else if (!name.empty())
+			flags += s2number(std::string(name).c_str());
+
+		if (idx == std::string_view::npos)
+			break;
+		str.remove_prefix(idx + 1);
 	}
-	if (!str.empty())
-		flags += s2number(str.c_str());
 
 	return flags;
 }
 
+unsigned long s2flags(const char *char_str, std::nullptr_t)
+{
+	return s2number(char_str);
+}
+
 unsigned long s2flags_buffer(const char *char_str)
 {
 	if (char_str == nullptr)
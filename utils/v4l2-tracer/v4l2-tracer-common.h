@@ -24,6 +24,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <string_view>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/types.h>
@@ -45,6 +46,112 @@ struct val_def {
 	const char *str;
 };
 
+/*
+ * The val_def and flag_def arrays are wrapped in tables which also hold the
+ * order of their entries by name and, for values, by value, so that looking
+ * up either is a binary search instead of a walk over the array. The order
+ * by name is written out by v4l2-tracer-gen.pl next to each array and only
+ * checked here, the order by value is computed at compile time since the
+ * values are only known to the compiler. The sort is stable: if several
+ * names share a value, the first one declared is still the one found.
+ *
+ * The arrays keep their terminating entry, which is last in both orders but
+ * not part of the table, so that they are never empty.
+ */
+struct val_table {
+	const val_def *def;
+	const unsigned short *by_val;
+	const unsigned short *by_str;
+	unsigned size;
+};
+
+struct flag_table {
+	const flag_def *def;
+	const unsigned short *by_str;
+	unsigned size;
+};
+
+template <size_t N>
+struct val_order {
+	unsigned short by_val[N];
+};
+
+template <size_t N>
+constexpr val_order<N> sort_vals(const val_def (&def)[N])
+{
+	val_order<N> order = {};
+
+	/* insertion sort, since std::sort is not constexpr before C++20 */
+	for (size_t i = 0; i < N - 1; i++) {
+		size_t j = i;
+
+		for (; j > 0 && def[order.by_val[j - 1]].val > def[i].val; j--)
+			order.by_val[j] = order.by_val[j - 1];
+		order.by_val[j] = i;
+	}
+	order.by_val[N - 1] = N - 1;
+	return order;
+}
+
+template <typename T, size_t N>
+constexpr bool names_sorted(const T (&def)[N], const unsigned short (&by_str)[N])
+{
+	for (size_t i = 1; i < N - 1; i++)
+		if (std::string_view(def[by_str[i - 1]].str) > def[by_str[i]].str)
+			return false;
+	return by_str[N - 1] == N - 1;
+}
+
+/* Define the table 'name' for the arrays 'name##_list' and 'name##_by_str' */
+#define VAL_TABLE(name) \
+	static_assert(names_sorted(name##_list, name##_by_str), #name " is not sorted"); \
+	constexpr auto name##_by_val = sort_vals(name##_list); \
+	constexpr val_table name = { name##_list, name##_by_val.by_val, name##_by_str, \
+				     sizeof(name##_list) / sizeof(name##_list[0]) - 1 }
+
+#define FLAG_TABLE(name) \
+	static_assert(names_sorted(name##_list, name##_by_str), #name " is not sorted"); \
+	constexpr flag_table name = { name##_list, name##_by_str, \
+				      sizeof(name##_list) / sizeof(name##_list[0]) - 1 }
+
+/* Return the first entry with this value, or nullptr */
+constexpr const val_def *lookup_val(const val_table &table, __s64 val)
+{
+	unsigned lo = 0, hi = table.size;
+
+	while (lo < hi) {
+		unsigned mid = lo + (hi - lo) / 2;
+
+		if (table.def[table.by_val[mid]].val < val)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < table.size && table.def[table.by_val[lo]].val == val)
+		return &table.def[table.by_val[lo]];
+	return nullptr;
+}
+
+template <typename Table>
+constexpr auto lookup_name(const Table &table, std::string_view name) -> decltype(table.def)
+{
+	unsigned lo = 0, hi = table.size;
+
+	while (lo < hi) {
+		unsigned mid = lo + (hi - lo) / 2;
+
+		if (std::string_view(table.def[table.by_str[mid]].str) < name)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < table.size && table.def[table.by_str[lo]].str == name)
+		return &table.def[table.by_str[lo]];
+	return nullptr;
+}
+
+extern const std::list<unsigned long> ioctls;
+
 bool is_debug(void);
 bool is_verbose(void);
 void print_v4l2_tracer_info(void);
@@ -52,13 +159,18 @@ void print_usage(void);
 std::string ver2s(unsigned int version);
 std::string number2s_oct(long num);
 std::string number2s(long num);
-std::string val2s(long val, const val_def *def);
-std::string fl2s(unsigned val, const flag_def *def);
+std::string val2s(long val, const val_table &def);
+std::string val2s(long val, std::nullptr_t);
+std::string fl2s(unsigned val, const flag_table &def);
+std::string fl2s(unsigned val, std::nullptr_t);
 std::string fl2s_buffer(__u32 flags);
 std::string fl2s_fwht(__u32 flags);
 long s2number(const char *char_str);
-long s2val(const char *char_str, const val_def *def);
-unsigned long s2flags(const char *char_str, const flag_def *def);
+bool s2frame_range(const char *char_str, unsigned long *first, unsigned long *last);
+long s2val(const char *char_str, const val_table &def);
+long s2val(const char *char_str, std::nullptr_t);
+unsigned long s2flags(const char *char_str, const flag_table &def);
+unsigned long s2flags(const char *char_str, std::nullptr_t);
 unsigned long s2flags_buffer(const char *char_str);
 unsigned long s2flags_fwht(const char *char_str);
 std::string which2s(unsigned long which);
@@ -66,19 +178,23 @@ std::string get_path_media(std::string driver);
 std::string get_path_video(int media_fd, std::list<std::string> linked_entities);
 std::list<std::string> get_linked_entities(int media_fd, std::string path_video);
 
-constexpr val_def which_val_def[] = {
+constexpr val_def which_val_def_list[] = {
 	{ V4L2_CTRL_WHICH_CUR_VAL,	"V4L2_CTRL_WHICH_CUR_VAL" },
 	{ V4L2_CTRL_WHICH_DEF_VAL,	"V4L2_CTRL_WHICH_DEF_VAL" },
 	{ V4L2_CTRL_WHICH_REQUEST_VAL,	"V4L2_CTRL_WHICH_REQUEST_VAL" },
 	{ -1, "" }
 };
+constexpr unsigned short which_val_def_by_str[] = { 0, 1, 2, 3 };
+VAL_TABLE(which_val_def);
 
-constexpr val_def open_val_def[] = {
+constexpr val_def open_val_def_list[] = {
 	{ O_RDONLY,	"O_RDONLY" },
 	{ O_WRONLY,	"O_WRONLY" },
 	{ O_RDWR,	"O_RDWR" },
 	{ -1, "" }
 };
+constexpr unsigned short open_val_def_by_str[] = { 0, 2, 1, 3 };
+VAL_TABLE(open_val_def);
 
 #include "v4l2-tracer-info-gen.h"
 
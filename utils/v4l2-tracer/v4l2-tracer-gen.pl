@@ -77,10 +77,10 @@ sub flag_gen {
 		$flag_func_name = lc $flag_func_name;
 	}
 
-	printf $fh_common_info_h "constexpr flag_def %sflag_def[] = {\n", $flag_func_name;
+	def_table_start("flag_def", "${flag_func_name}flag_def");
 
 	($flag) = ($_) =~ /#define\s+(\w+)\s+.+/;
-	printf $fh_common_info_h "\t{ $flag, \"$flag\" },\n"; # get the first flag
+	def_entry($flag); # get the first flag
 
 	while (<>) {
 		next if ($_ =~ /^\/?\s?\*.*/); # skip comments between flags if any
@@ -94,47 +94,70 @@ sub flag_gen {
 		next if ($flag =~ /.*MEDIA_LNK_FL_LINK_TYPE.*/);
 		next if ($flag =~ /.*MEDIA_ENT_ID_FLAG_NEXT.*/);
 
-		printf $fh_common_info_h "\t{ $flag, \"$flag\" },\n";
+		def_entry($flag);
 	}
-	printf $fh_common_info_h "\t{ 0, \"\" }\n};\n\n";
+	def_table_end();
 }
 
 sub enum_gen {
 	($enum_name) = ($_) =~ /enum (\w+) {/;
-	printf $fh_common_info_h "constexpr val_def %s_val_def[] = {\n", $enum_name;
+	def_table_start("val_def", "${enum_name}_val_def");
 	while (<>) {
 		last if $_ =~ /};/;
 		($name) = ($_) =~ /\s+(\w+)\s?.*/;
 		next if ($name ne uc $name); # skip comments that don't start with *
 		next if ($_ =~ /^\s*\/?\s?\*.*/); # skip comments
 		next if $name =~ /^\s*$/;  # skip blank lines
-		printf $fh_common_info_h "\t{ %s,\t\"%s\" },\n", $name, $name;
+		def_entry($name);
 	}
-	printf $fh_common_info_h "\t{ -1, \"\" }\n};\n\n";
+	def_table_end();
+}
+
+# Start a val_def or flag_def array, which def_table_end() wraps in a table of
+# the same name, with the order of its entries by name (see VAL_TABLE)
+sub def_table_start {
+	my $def_type = shift;
+	$def_table_name = shift;
+
+	$def_table_type = ($def_type eq "val_def") ? "VAL_TABLE" : "FLAG_TABLE";
+	@def_table_names = ();
+	printf $fh_common_info_h "constexpr %s %s_list[] = {\n", $def_type, $def_table_name;
+}
+
+sub def_entry {
+	my $name = shift;
+	push (@def_table_names, $name);
+	printf $fh_common_info_h "\t{ %s,\t\"%s\" },\n", $name, $name;
+}
+
+sub def_table_end {
+	my $sentinel = ($def_table_type eq "VAL_TABLE") ? "-1" : "0";
+	my @by_str = sort { $def_table_names[$a] cmp $def_table_names[$b] or $a <=> $b } (0 .. $#def_table_names);
+
+	push (@by_str, scalar @def_table_names); # the terminating entry is last
+	printf $fh_common_info_h "\t{ $sentinel, \"\" }\n};\n";
+	printf $fh_common_info_h "constexpr unsigned short %s_by_str[] = {", $def_table_name;
+	for (my $i = 0; $i <= $#by_str; $i++) {
+		printf $fh_common_info_h "%s%s", ($i % 16) ? " " : "\n\t", $by_str[$i];
+		printf $fh_common_info_h "," if ($i < $#by_str);
+	}
+	printf $fh_common_info_h "\n};\n";
+	printf $fh_common_info_h "%s(%s);\n\n", $def_table_type, $def_table_name;
 }
 
 sub val_def_gen {
 	my $last_val = shift;
-	my $sentinel = shift;
-	if (length $sentinel == 0) {
-		$sentinel = "-1"; # _flag_def arrays end with 0, _val_def arrays end in -1
-	}
 	($val) = ($_) =~ /^#define\s*(\w+)\s*/;
-	printf $fh_common_info_h "\t{ %s,\t\"%s\" },\n", $val, $val;
+	def_entry($val);
 	while (<>) {
 		next if ($_ =~ /^\s*\/?\s?\*.*/); # skip comments
 		next if ($_ =~ /^\s*$/);  # skip blank lines
 		($val) = ($_) =~ /^#define\s*(\w+)\s*/;
 		next if ($val eq ""); # skip lines that don't start with define e.g. V4L2_STD_ATSC_16_VSB
-		printf $fh_common_info_h "\t{ %s,\t\"%s\" },\n", $val, $val;
+		def_entry($val);
 		last if ($val eq $last_val);
 	}
-	printf $fh_common_info_h "\t{ $sentinel, \"\" }\n};\n\n";
-}
-
-sub flag_def_gen {
-	my $last_flag = shift;
-	val_def_gen($last_flag, 0);
+	def_table_end();
 }
 
 sub clean_up_line {
@@ -858,67 +881,67 @@ while (<>) {
 	}
 
 	if (grep {/^#define V4L2_CTRL_CLASS_USER\s+/} $_) {
-		printf $fh_common_info_h "constexpr val_def ctrlclass_val_def[] = {\n";
+		def_table_start("val_def", "ctrlclass_val_def");
 		val_def_gen("V4L2_CTRL_CLASS_COLORIMETRY");
 		next;
 	}
 	if (grep {/^#define V4L2_CAP_VIDEO_CAPTURE/} $_) {
-		printf $fh_common_info_h "constexpr flag_def v4l2_cap_flag_def[] = {\n";
-		flag_def_gen("V4L2_CAP_DEVICE_CAPS");
+		def_table_start("flag_def", "v4l2_cap_flag_def");
+		val_def_gen("V4L2_CAP_DEVICE_CAPS");
 		next;
 	}
 	if (grep {/^#define V4L2_PIX_FMT_RGB332\s+/} $_) {
-		printf $fh_common_info_h "constexpr val_def v4l2_pix_fmt_val_def[] = {\n";
+		def_table_start("val_def", "v4l2_pix_fmt_val_def");
 		val_def_gen("V4L2_PIX_FMT_IPU3_SRGGB10");
 		next;
 	}
 	if (grep {/^#define V4L2_BUF_CAP_SUPPORTS_MMAP\s+/} $_) {
-		printf $fh_common_info_h "constexpr flag_def v4l2_buf_cap_flag_def[] = {\n";
-		flag_def_gen("V4L2_BUF_CAP_SUPPORTS_MMAP_CACHE_HINTS");
+		def_table_start("flag_def", "v4l2_buf_cap_flag_def");
+		val_def_gen("V4L2_BUF_CAP_SUPPORTS_MMAP_CACHE_HINTS");
 		next;
 	}
 	if (grep {/^#define V4L2_STD_PAL_B\s+/} $_) {
-		printf $fh_common_info_h "constexpr flag_def std_flag_def[] = {\n";
-		flag_def_gen("V4L2_STD_ALL");
+		def_table_start("flag_def", "std_flag_def");
+		val_def_gen("V4L2_STD_ALL");
 		next
 	}
 	if (grep {/^#define V4L2_MODE_HIGHQUALITY\s+/} $_) {
-		printf $fh_common_info_h "constexpr val_def streamparm_val_def[] = {\n";
+		def_table_start("val_def", "streamparm_val_def");
 		val_def_gen("V4L2_CAP_TIMEPERFRAME");
 		next;
 	}
 	if (grep {/^#define V4L2_INPUT_TYPE_TUNER\s+/} $_) {
-		printf $fh_common_info_h "constexpr val_def input_type_val_def[] = {\n";
+		def_table_start("val_def", "input_type_val_def");
 		val_def_gen("V4L2_INPUT_TYPE_TOUCH");
 		next
 	}
 	if (grep {/^#define V4L2_IN_ST_NO_POWER\s+/} $_) {
-		printf $fh_common_info_h "constexpr val_def input_field_val_def[] = {\n";
+		def_table_start("val_def", "input_field_val_def");
 		val_def_gen("V4L2_IN_ST_VTR");
 		next
 	}
 	if (grep {/^#define V4L2_IN_CAP_DV_TIMINGS\s+/} $_) {
-		printf $fh_common_info_h "constexpr flag_def input_cap_flag_def[] = {\n";
-		flag_def_gen("V4L2_IN_CAP_NATIVE_SIZE");
+		def_table_start("flag_def", "input_cap_flag_def");
+		val_def_gen("V4L2_IN_CAP_NATIVE_SIZE");
 		next
 	}
 	if (grep {/^#define V4L2_OUTPUT_TYPE_MODULATOR\s+/} $_) {
-		printf $fh_common_info_h "constexpr val_def output_type_val_def[] = {\n";
+		def_table_start("val_def", "output_type_val_def");
 		val_def_gen("V4L2_OUTPUT_TYPE_ANALOGVGAOVERLAY");
 		next
 	}
 	if (grep {/^#define V4L2_OUT_CAP_DV_TIMINGS\s+/} $_) {
-		printf $fh_common_info_h "constexpr flag_def output_cap_flag_def[] = {\n";
-		flag_def_gen("V4L2_OUT_CAP_NATIVE_SIZE");
+		def_table_start("flag_def", "output_cap_flag_def");
+		val_def_gen("V4L2_OUT_CAP_NATIVE_SIZE");
 		next
 	}
 	if (grep {/^#define V4L2_ENC_CMD_START\s+/} $_) {
-		printf $fh_common_info_h "constexpr val_def encoder_cmd_val_def[] = {\n";
+		def_table_start("val_def", "encoder_cmd_val_def");
 		val_def_gen("V4L2_ENC_CMD_RESUME");
 		next;
 	}
 	if (grep {/^#define V4L2_DEC_CMD_START\s+/} $_) {
-		printf $fh_common_info_h "constexpr val_def decoder_cmd_val_def[] = {\n";
+		def_table_start("val_def", "decoder_cmd_val_def");
 		val_def_gen("V4L2_DEC_CMD_FLUSH");
 		next;
 	}
@@ -936,20 +959,20 @@ while (<>) {
 	}
 }
 
-printf $fh_common_info_h "constexpr val_def control_val_def[] = {\n";
+def_table_start("val_def", "control_val_def");
 foreach (@controls) {
 	($control) = ($_) =~ /^#define\s*(\w+)\s*/;
 	next if ($control =~ /BASE$/);
-	printf $fh_common_info_h "\t{ %s,\t\"%s\" },\n", $control, $control;
+	def_entry($control);
 }
-printf $fh_common_info_h "\t{ -1, \"\" }\n};\n";
+def_table_end();
 
-printf $fh_common_info_h "constexpr val_def ioctl_val_def[] = {\n";
+def_table_start("val_def", "ioctl_val_def");
 foreach (@ioctls) {
 	($ioctl) = ($_) =~ /^#define\s*(\w+)\s*/;
-	printf $fh_common_info_h "\t{ %s,\t\"%s\" },\n", $ioctl, $ioctl;
+	def_entry($ioctl);
 }
-printf $fh_common_info_h "\t{ -1, \"\" }\n};\n";
+def_table_end();
 
 
 printf $fh_trace_h "\n#endif\n";
@@ -5,6 +5,7 @@
 
 #include "retrace.h"
 #include <climits>
+#include <regex.h>
 #include <sys/wait.h>
 #include <time.h>
 
@@ -23,9 +24,13 @@ void v4l2_tracer_sig_handler(int signum)
 enum Options {
 	V4l2TracerOptCompactPrint = 'c',
 	V4l2TracerOptSetVideoDevice = 'd',
+	V4l2TracerOptTraceFrames = 'f',
 	V4l2TracerOptDebug = 'g',
 	V4l2TracerOptHelp = 'h',
+	V4l2TracerOptTraceIoctls = 'i',
 	V4l2TracerOptSetMediaDevice = 'm',
+	V4l2TracerOptTraceSample = 'n',
+	V4l2TracerOptTraceDevicePath = 'p',
 	V4l2TracerOptWriteDecodedToJson = 'r',
 	V4l2TracerOptVerbose = 'v',
 	V4l2TracerOptWriteDecodedToYUVFile = 'y',
@@ -34,9 +39,13 @@ enum Options {
 const static struct option long_options[] = {
 	{ "compact", no_argument, nullptr, V4l2TracerOptCompactPrint },
 	{ "video_device", required_argument, nullptr, V4l2TracerOptSetVideoDevice },
+	{ "frames", required_argument, nullptr, V4l2TracerOptTraceFrames },
 	{ "debug", no_argument, nullptr, V4l2TracerOptDebug },
 	{ "help", no_argument, nullptr, V4l2TracerOptHelp },
+	{ "ioctls", required_argument, nullptr, V4l2TracerOptTraceIoctls },
 	{ "media_device", required_argument, nullptr, V4l2TracerOptSetMediaDevice },
+	{ "sample", required_argument, nullptr, V4l2TracerOptTraceSample },
+	{ "device_path", required_argument, nullptr, V4l2TracerOptTraceDevicePath },
 	{ "raw", no_argument, nullptr, V4l2TracerOptWriteDecodedToJson },
 	{ "verbose", no_argument, nullptr, V4l2TracerOptVerbose },
 	{ "yuv", no_argument, nullptr, V4l2TracerOptWriteDecodedToYUVFile },
@@ -46,9 +55,13 @@ const static struct option long_options[] = {
 const char short_options[] = {
 	V4l2TracerOptCompactPrint,
 	V4l2TracerOptSetVideoDevice, ':',
+	V4l2TracerOptTraceFrames, ':',
 	V4l2TracerOptDebug,
 	V4l2TracerOptHelp,
+	V4l2TracerOptTraceIoctls, ':',
 	V4l2TracerOptSetMediaDevice, ':',
+	V4l2TracerOptTraceSample, ':',
+	V4l2TracerOptTraceDevicePath, ':',
 	V4l2TracerOptWriteDecodedToJson,
 	V4l2TracerOptVerbose,
 	V4l2TracerOptWriteDecodedToYUVFile
@@ -95,6 +108,16 @@ int get_options(int argc, char *argv[])
 			}
 			break;
 		}
+		case V4l2TracerOptTraceFrames: {
+			unsigned long first, last;
+			if (!s2frame_range(optarg, &first, &last)) {
+				fprintf(stderr, "%s:%s:%d: ", __FILE__, __func__, __LINE__);
+				fprintf(stderr, "invalid range of frames \'%s\'\n", optarg);
+				return -1;
+			}
+			setenv("V4L2_TRACER_OPTION_FRAMES", optarg, 0);
+			break;
+		}
 		case V4l2TracerOptDebug:
 			setenv("V4L2_TRACER_OPTION_VERBOSE", "true", 0);
 			setenv("V4L2_TRACER_OPTION_DEBUG", "true", 0);
@@ -102,6 +125,29 @@ int get_options(int argc, char *argv[])
 		case V4l2TracerOptHelp:
 			print_usage();
 			return -1;
+		case V4l2TracerOptTraceIoctls: {
+			std::string_view names = optarg;
+			while (true) {
+				size_t idx = names.find(',');
+				std::string name(names.substr(0, idx));
+				const val_def *def = lookup_name(ioctl_val_def, name);
+				if (def == nullptr) {
+					fprintf(stderr, "%s:%s:%d: ", __FILE__, __func__, __LINE__);
+					fprintf(stderr, "unknown ioctl \'%s\'\n", name.c_str());
+					return -1;
+				}
+				if (find(ioctls.begin(), ioctls.end(), def->val) == ioctls.end()) {
+					fprintf(stderr, "%s:%s:%d: ", __FILE__, __func__, __LINE__);
+					fprintf(stderr, "ioctl \'%s\' cannot be traced\n", name.c_str());
+					return -1;
+				}
+				if (idx == std::string_view::npos)
+					break;
+				names.remove_prefix(idx + 1);
+			}
+			setenv("V4L2_TRACER_OPTION_IOCTLS", optarg, 0);
+			break;
+		}
 		case V4l2TracerOptSetMediaDevice: {
 			std::string device_num = optarg;
 			try {
@@ -122,6 +168,25 @@ int get_options(int argc, char *argv[])
 			}
 			break;
 		}
+		case V4l2TracerOptTraceSample:
+			if (s2number(optarg) <= 0) {
+				fprintf(stderr, "%s:%s:%d: ", __FILE__, __func__, __LINE__);
+				fprintf(stderr, "invalid sample rate \'%s\'\n", optarg);
+				return -1;
+			}
+			setenv("V4L2_TRACER_OPTION_SAMPLE", optarg, 0);
+			break;
+		case V4l2TracerOptTraceDevicePath: {
+			regex_t device_path;
+			if (regcomp(&device_path, optarg, REG_EXTENDED | REG_NOSUB) != 0) {
+				fprintf(stderr, "%s:%s:%d: ", __FILE__, __func__, __LINE__);
+				fprintf(stderr, "invalid regular expression \'%s\'\n", optarg);
+				return -1;
+			}
+			regfree(&device_path);
+			setenv("V4L2_TRACER_OPTION_DEVICE_PATH", optarg, 0);
+			break;
+		}
 		case V4l2TracerOptWriteDecodedToJson:
 			setenv("V4L2_TRACER_OPTION_WRITE_DECODED_TO_JSON_FILE", "true", 0);
 			break;